@@ -143,7 +143,9 @@ GCONCAT( _gblender_blit_bgra_, GDST_TYPE )( GBlenderBlit   blit,
 }
 
 
-static const GBlenderBlitFunc
+/* not constant, see `gblender_blit_setup' in `gblblit.c'
+ */
+static GBlenderBlitFunc
 GCONCAT( blit_funcs_, GDST_TYPE )[GBLENDER_SOURCE_MAX] =
 {
   GCONCAT( _gblender_blit_gray8_, GDST_TYPE ),
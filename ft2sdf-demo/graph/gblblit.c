@@ -203,6 +203,10 @@
 
 #include "gblany.h"
 
+/* SIMD kernels for gray glyphs
+ */
+#include "gblsimd.h"
+
 /* */
 
 static const GBlenderBlitFunc*
@@ -216,6 +220,35 @@ blit_funcs[GBLENDER_TARGET_MAX] =
 };
 
 
+/* pick the fastest gray glyph kernels the processor supports
+ */
+static void
+gblender_blit_setup( void )
+{
+  static int  done = 0;
+
+
+  if ( done )
+    return;
+  done = 1;
+
+#ifdef GBLENDER_SIMD
+  __builtin_cpu_init();
+
+  if ( __builtin_cpu_supports( "avx2" ) )
+  {
+    blit_funcs_rgb32[GBLENDER_SOURCE_GRAY8] = _gblender_blit_gray8_rgb32_avx2;
+    blit_funcs_rgb24[GBLENDER_SOURCE_GRAY8] = _gblender_blit_gray8_rgb24_avx2;
+  }
+  else if ( __builtin_cpu_supports( "sse2" ) )
+  {
+    blit_funcs_rgb32[GBLENDER_SOURCE_GRAY8] = _gblender_blit_gray8_rgb32_sse2;
+    blit_funcs_rgb24[GBLENDER_SOURCE_GRAY8] = _gblender_blit_gray8_rgb24_sse2;
+  }
+#endif
+}
+
+
 static void
 _gblender_blit_dummy( GBlenderBlit   blit,
                       GBlenderPixel  color )
@@ -275,6 +308,8 @@ gblender_blit_init( GBlenderBlit           blit,
     return -2;
   }
 
+  gblender_blit_setup();
+
   blit->blender   = surface->gblender;
   blit->blit_func = blit_funcs[dst_format][src_format];
 
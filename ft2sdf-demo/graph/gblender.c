@@ -1,5 +1,6 @@
 #include "gblender.h"
 #include <stdlib.h>
+#include <stdio.h>
 
 #if 0  /* using slow power functions */
 
@@ -127,7 +128,7 @@ gblender_clear( GBlender  blender )
   {
     GBlenderChanKey  chan_keys = (GBlenderChanKey) blender->keys;
 
-    for ( nn = 0; nn < GBLENDER_KEY_COUNT; nn++ )
+    for ( nn = 0; nn < blender->key_count; nn++ )
       chan_keys[nn].index = -1;
 
     blender->cache_r_back  = ~0U;
@@ -144,13 +145,34 @@ gblender_clear( GBlender  blender )
   }
   else
   {
-    for ( nn = 0; nn < GBLENDER_KEY_COUNT; nn++ )
+    for ( nn = 0; nn < blender->key_count; nn++ )
       keys[nn].cells = NULL;
 
     blender->cache_back  = ~0U;
     blender->cache_fore  = ~0U;
     blender->cache_cells = NULL;
   }
+
+  blender->key_used = 0;
+}
+
+
+/* double the key table once it is three quarters full; return 1 if
+ * it was cleared for this
+ */
+static int
+gblender_grow( GBlender  blender )
+{
+  if ( !blender->key_grow                                  ||
+       blender->key_count >= GBLENDER_KEY_COUNT_MAX        ||
+       blender->key_used  <  blender->key_count / 4 * 3    )
+    return 0;
+
+  blender->key_count *= 2;
+  blender->stat_grows++;
+
+  gblender_clear( blender );
+  return 1;
 }
 
 GBLENDER_APIDEF( void )
@@ -184,20 +206,17 @@ gblender_reset( GBlender  blender )
                                             blender->cache_back,
                                             blender->cache_fore );
   }
-
-#ifdef GBLENDER_STATS
-  blender->stat_hits    = 0;
-  blender->stat_lookups = 0;
-  blender->stat_keys    = 0;
-  blender->stat_clears  = 0;
-#endif
 }
 
 GBLENDER_APIDEF( void )
 gblender_init( GBlender   blender,
                double     gamma_value )
 {
-  blender->channels = 0;
+  blender->channels  = 0;
+  blender->key_count = GBLENDER_KEY_COUNT;
+  blender->key_grow  = 1;
+
+  gblender_reset_stats( blender );
 
   gblender_set_gamma_table ( gamma_value,
                              blender->gamma_ramp,
@@ -221,6 +240,31 @@ gblender_use_channels( GBlender  blender,
 }
 
 
+GBLENDER_APIDEF( void )
+gblender_set_key_count( GBlender  blender,
+                        int       count )
+{
+  int  size = 1;
+
+
+  if ( count <= 0 )
+  {
+    blender->key_count = GBLENDER_KEY_COUNT;
+    blender->key_grow  = 1;
+  }
+  else
+  {
+    while ( size < count && size < GBLENDER_KEY_COUNT_MAX )
+      size <<= 1;
+
+    blender->key_count = size;
+    blender->key_grow  = 0;
+  }
+
+  gblender_reset( blender );
+}
+
+
 
 /* recompute the grade levels of a given key
  */
@@ -304,8 +348,8 @@ gblender_lookup( GBlender       blender,
 
 #ifdef GBLENDER_STATS
   blender->stat_hits--;
-  blender->stat_lookups++;
 #endif
+  blender->stat_lookups++;
 
 #if 0
   if ( blender->channels )
@@ -316,7 +360,7 @@ gblender_lookup( GBlender       blender,
   }
 #endif
 
-  idx0 = ( background + foreground*63 ) & (GBLENDER_KEY_COUNT-1);
+  idx0 = ( background + foreground*63 ) & (blender->key_count-1);
   idx  = idx0;
   do
   {
@@ -329,18 +373,25 @@ gblender_lookup( GBlender       blender,
          key->foreground == foreground )
       goto Exit;
 
-    idx = (idx+1) & (GBLENDER_KEY_COUNT-1);
+    idx = (idx+1) & (blender->key_count-1);
   }
   while ( idx != idx0 );
 
  /* the cache is full, clear it completely
   */
-#ifdef GBLENDER_STATS
   blender->stat_clears++;
-#endif
   gblender_clear( blender );
 
+  key = blender->keys + idx;
+
 NewNode:
+  if ( gblender_grow( blender ) )
+  {
+    idx = ( background + foreground*63 ) & (blender->key_count-1);
+    key = blender->keys + idx;
+  }
+
+  blender->key_used++;
   key->background = background;
   key->foreground = foreground;
   key->cells      = blender->cells +
@@ -348,9 +399,7 @@ NewNode:
 
   gblender_reset_key( blender, key );
 
-#ifdef GBLENDER_STATS
   blender->stat_keys++;
-#endif
 
 Exit:
   return  key->cells;
@@ -407,8 +456,8 @@ gblender_lookup_channel( GBlender      blender,
 
 #ifdef GBLENDER_STATS
   blender->stat_hits--;
-  blender->stat_lookups++;
 #endif
+  blender->stat_lookups++;
 
 #if 0
   if ( !blender->channels )
@@ -419,7 +468,7 @@ gblender_lookup_channel( GBlender      blender,
   }
 #endif
 
-  idx0 = ( background + foreground*17 ) & (GBLENDER_KEY_COUNT-1);
+  idx0 = ( background + foreground*17 ) & (blender->key_count-1);
   idx  = idx0;
   do
   {
@@ -431,26 +480,31 @@ gblender_lookup_channel( GBlender      blender,
     if ( key->backfore == backfore )
       goto Exit;
 
-    idx = (idx+1) & (GBLENDER_KEY_COUNT-1);
+    idx = (idx+1) & (blender->key_count-1);
   }
   while ( idx != idx0 );
 
  /* the cache is full, clear it completely
   */
-#ifdef GBLENDER_STATS
   blender->stat_clears++;
-#endif
   gblender_clear( blender );
 
+  key = (GBlenderChanKey)blender->keys + idx;
+
 NewNode:
+  if ( gblender_grow( blender ) )
+  {
+    idx = ( background + foreground*17 ) & (blender->key_count-1);
+    key = (GBlenderChanKey)blender->keys + idx;
+  }
+
+  blender->key_used++;
   key->backfore   = backfore;
   key->index      = (signed short)( idx * GBLENDER_SHADE_COUNT );
 
   gblender_reset_channel_key( blender, key );
 
-#ifdef GBLENDER_STATS
   blender->stat_keys++;
-#endif
 
 Exit:
   return  (unsigned char*)blender->cells + key->index;
@@ -458,17 +512,49 @@ Exit:
 
 
 
-#ifdef GBLENDER_STATS
-#include <stdio.h>
+GBLENDER_APIDEF( void )
+gblender_get_stats( GBlender       blender,
+                    GBlenderStats  stats )
+{
+  stats->hits      = blender->stat_hits;
+  stats->lookups   = blender->stat_lookups;
+  stats->keys      = blender->stat_keys;
+  stats->clears    = blender->stat_clears;
+  stats->grows     = blender->stat_grows;
+  stats->key_count = blender->key_count;
+  stats->key_used  = blender->key_used;
+}
+
+
+GBLENDER_APIDEF( void )
+gblender_reset_stats( GBlender  blender )
+{
+  blender->stat_hits    = 0;
+  blender->stat_lookups = 0;
+  blender->stat_keys    = 0;
+  blender->stat_clears  = 0;
+  blender->stat_grows   = 0;
+}
+
+
 GBLENDER_APIDEF( void )
 gblender_dump_stats( GBlender  blender )
 {
-  printf( "hits = %ld, miss1 = %ld, miss2 = %ld, rate1=%.2f%%, rate2=%.2f%%\n",
-           blender->stat_hits,
+  printf( "lookups = %ld, keys = %ld, clears = %ld, grows = %ld, "
+          "table = %d/%d, rate2=%.2f%%\n",
            blender->stat_lookups,
            blender->stat_keys,
-           (100.0*blender->stat_hits) / (double)(blender->stat_hits + blender->stat_lookups),
-           (100.0*blender->stat_lookups) / (double)( blender->stat_lookups + blender->stat_keys)
-           );
-}
+           blender->stat_clears,
+           blender->stat_grows,
+           blender->key_used,
+           blender->key_count,
+           blender->stat_lookups
+             ? (100.0*( blender->stat_lookups - blender->stat_keys )) /
+                 (double)blender->stat_lookups
+             : 0.0 );
+#ifdef GBLENDER_STATS
+  printf( "hits = %ld, rate1=%.2f%%\n",
+           blender->stat_hits,
+           (100.0*blender->stat_hits) / (double)(blender->stat_hits + blender->stat_lookups) );
 #endif
+}
@@ -21,7 +21,8 @@
 #define  GBLENDER_SHADE_BITS      4   /* must be <= 7 !! */
 #define  GBLENDER_SHADE_COUNT     ( 1 << GBLENDER_SHADE_BITS )
 #define  GBLENDER_SHADE_INDEX(n)  (((n) * (GBLENDER_SHADE_COUNT-1) + 128) >> 8)
-#define  GBLENDER_KEY_COUNT       256  /* must be a power of 2 */
+#define  GBLENDER_KEY_COUNT       256  /* initial size, a power of 2    */
+#define  GBLENDER_KEY_COUNT_MAX   1024 /* a power of 2, at most 2048    */
 #define  GBLENDER_GAMMA_SHIFT     2
 
 #define  xGBLENDER_STORE_BYTES  /* define this to store (R,G,B) values on 3
@@ -31,8 +32,10 @@
                                 * Go figure what's really happening though :-)
                                 */
 
-#define  xGBLENDER_STATS        /* define this to collect statistics in the
-                                * blender
+#define  xGBLENDER_STATS        /* define this to also count the direct
+                                * hits of the blender, which costs a
+                                * little in the inner loops; the other
+                                * statistics are always collected
                                 */
 
   typedef unsigned int    GBlenderPixel;  /* needs 32-bits here !! */
@@ -65,8 +68,14 @@
 
   typedef struct GBlenderRec_
   {
-    GBlenderKeyRec        keys [ GBLENDER_KEY_COUNT ];
-    GBlenderCell          cells[ GBLENDER_KEY_COUNT*GBLENDER_SHADE_COUNT*GBLENDER_CELL_SIZE ];
+    GBlenderKeyRec        keys [ GBLENDER_KEY_COUNT_MAX ];
+    GBlenderCell          cells[ GBLENDER_KEY_COUNT_MAX*GBLENDER_SHADE_COUNT*GBLENDER_CELL_SIZE ];
+
+   /* the part of the key table in use, and whether it grows
+    */
+    int                   key_count;
+    int                   key_used;
+    int                   key_grow;
 
    /* a small cache for normal modes
     */
@@ -97,27 +106,50 @@
     unsigned short        gamma_ramp[256];                              /* voltage to linear */
     unsigned char         gamma_ramp_inv[256 << GBLENDER_GAMMA_SHIFT];  /* linear to voltage */
 
-#ifdef GBLENDER_STATS
     long                  stat_hits;    /* number of direct hits             */
     long                  stat_lookups; /* number of table lookups           */
     long                  stat_keys;    /* number of table key recomputation */
     long                  stat_clears;  /* number of table clears            */
-#endif
+    long                  stat_grows;   /* number of table size doublings    */
 
   } GBlenderRec, *GBlender;
 
 
- /* initialize with a given gamma */
+  typedef struct
+  {
+    long  hits;       /* direct hits, only counted with GBLENDER_STATS */
+    long  lookups;    /* table lookups, i.e., misses of the last pair  */
+    long  keys;       /* cell ranges computed, i.e., table misses      */
+    long  clears;     /* table clears because it was full              */
+    long  grows;      /* table size doublings                          */
+    int   key_count;  /* current table size                            */
+    int   key_used;   /* keys in the table                             */
+
+  } GBlenderStatsRec, *GBlenderStats;
+
+
+ /* initialize with a given gamma; this also resets the statistics */
+ /* and lets the key table grow from its initial size              */
   GBLENDER_API( void )
   gblender_init( GBlender  blender,
                  double    gamma );
 
 
- /* clear blender, and reset stats */
+ /* clear blender */
   GBLENDER_API( void )
   gblender_reset( GBlender  blender );
 
 
+ /* Set the size of the key table, rounded up to a power of 2 and   */
+ /* capped to GBLENDER_KEY_COUNT_MAX.  With a size of 0, the table   */
+ /* starts at GBLENDER_KEY_COUNT keys and doubles whenever it gets   */
+ /* three quarters full, so that many different (background,         */
+ /* foreground) pairs don't keep clearing it; this is the default.  */
+  GBLENDER_API( void )
+  gblender_set_key_count( GBlender  blender,
+                          int       count );
+
+
   GBLENDER_API( void )
   gblender_use_channels( GBlender  blender,
                          int       channels );
@@ -134,12 +166,16 @@
                            unsigned int  background,
                            unsigned int  foreground );
 
-#ifdef GBLENDER_STATS
+ /* read and reset the statistics */
+  GBLENDER_API( void )
+  gblender_get_stats( GBlender       blender,
+                      GBlenderStats  stats );
+
+  GBLENDER_API( void )
+  gblender_reset_stats( GBlender  blender );
+
   GBLENDER_API( void )
   gblender_dump_stats( GBlender  blender );
-#else
-# define gblender_dump_stats(b)  do { } while (0);
-#endif
 
 #ifdef GBLENDER_STATS
 #define GBLENDER_STAT_HIT(gb)   (gb)->stat_hits++
@@ -0,0 +1,602 @@
+/****************************************************************************/
+/*                                                                          */
+/*  The FreeType project -- a free and portable quality TrueType renderer.  */
+/*                                                                          */
+/*  Copyright (C) 2020 by                                                   */
+/*  D. Turner, R.Wilhelm, and W. Lemberg                                    */
+/*                                                                          */
+/*  gblsimd.h: SSE2 and AVX2 kernels blitting gray glyphs onto RGB32 and    */
+/*             RGB24 surfaces, included by gblblit.c.                       */
+/*                                                                          */
+/****************************************************************************/
+
+/* The kernels classify 16 coverage values at a time.  Blocks without
+ * coverage are skipped and fully covered blocks are filled with the
+ * color.  In mixed blocks, the partially covered pixels still blend in
+ * linear light through the blender's cells; as long as they all lie on
+ * the current background, a 16-entry copy of its cells (with the color
+ * in the last entry) resolves the whole block in registers.  Any other
+ * block goes through the per-pixel path of `gblcolor.h', so the output
+ * is exactly that of the generic routines.
+ */
+
+#if ( defined __GNUC__ || defined __clang__ )    && \
+    ( defined __x86_64__ || defined __i386__ )   && \
+    !defined GBLENDER_STORE_BYTES
+
+#define GBLENDER_SIMD
+
+#include <immintrin.h>
+
+
+/* shade indices of 16 coverage values, see GBLENDER_SHADE_INDEX
+ */
+#define  GSIMD_SHADES(s,a)                                              \
+  {                                                                     \
+    __m128i  _z   = _mm_setzero_si128();                                \
+    __m128i  _max = _mm_set1_epi16( GBLENDER_SHADE_COUNT - 1 );         \
+    __m128i  _rnd = _mm_set1_epi16( 128 );                              \
+    __m128i  _lo  = _mm_unpacklo_epi8( (s), _z );                       \
+    __m128i  _hi  = _mm_unpackhi_epi8( (s), _z );                       \
+                                                                        \
+    _lo = _mm_add_epi16( _mm_mullo_epi16( _lo, _max ), _rnd );          \
+    _hi = _mm_add_epi16( _mm_mullo_epi16( _hi, _max ), _rnd );          \
+    (a) = _mm_packus_epi16( _mm_srli_epi16( _lo, 8 ),                   \
+                            _mm_srli_epi16( _hi, 8 ) );                 \
+  }
+
+#ifdef GBLENDER_STATS
+#define  GSIMD_STAT_HITS(gb,mask)  (gb)->stat_hits += __builtin_popcount( mask )
+#else
+#define  GSIMD_STAT_HITS(gb,mask)  /* nothing */
+#endif
+
+/* refresh the copy of the cells if the background changed
+ */
+#define  GSIMD_CELLS_SET(cells,cells_back)                  \
+  if ( (cells_back) != _gback )                             \
+  {                                                         \
+    int  _k;                                                \
+                                                            \
+    for ( _k = 1; _k < GBLENDER_SHADE_COUNT-1; _k++ )       \
+      (cells)[_k] = _gcells[_k];                            \
+    (cells_back) = _gback;                                  \
+  }
+
+/* the per-pixel path, as in `gblcolor.h'
+ */
+#define  GSIMD_PIXEL_RGB32(d,a)                                    \
+  if ( (a) == GBLENDER_SHADE_COUNT-1 )                             \
+    *(GBlenderPixel*)(d) = color;                                  \
+  else if ( (a) != 0 )                                             \
+  {                                                                \
+    GBlenderPixel  _back = *(GBlenderPixel*)(d) & 0xFFFFFF;        \
+                                                                   \
+    GBLENDER_LOOKUP( blender, _back );                             \
+    *(GBlenderPixel*)(d) = _gcells[(a)];                           \
+  }
+
+#define  GSIMD_PIXEL_RGB24(d,a)                                    \
+  if ( (a) == GBLENDER_SHADE_COUNT-1 )                             \
+  {                                                                \
+    GDST_STORE3(d,r,g,b);                                          \
+  }                                                                \
+  else if ( (a) != 0 )                                             \
+  {                                                                \
+    GBlenderPixel  _back = GRGB_PACK((d)[0],(d)[1],(d)[2]);        \
+    GBlenderPixel  _pix;                                           \
+                                                                   \
+    GBLENDER_LOOKUP( blender, _back );                             \
+    _pix = _gcells[(a)];                                           \
+    GDST_STORE3(d,_pix >> 16,_pix >> 8,_pix);                      \
+  }
+
+/* lane masks of 4 bytes each from the bytes of `m'
+ */
+#define  GSIMD_EXPAND4(m,m0,m1,m2,m3)                        \
+  {                                                          \
+    __m128i  _l = _mm_unpacklo_epi8( (m), (m) );             \
+    __m128i  _h = _mm_unpackhi_epi8( (m), (m) );             \
+                                                             \
+    (m0) = _mm_unpacklo_epi16( _l, _l );                     \
+    (m1) = _mm_unpackhi_epi16( _l, _l );                     \
+    (m2) = _mm_unpacklo_epi16( _h, _h );                     \
+    (m3) = _mm_unpackhi_epi16( _h, _h );                     \
+  }
+
+
+__attribute__(( target( "sse2" ) ))
+static void
+_gblender_blit_gray8_rgb32_sse2( GBlenderBlit   blit,
+                                 GBlenderPixel  color )
+{
+  GBlender  blender = blit->blender;
+
+  GBLENDER_VARS;
+
+  int                   h        = blit->height;
+  const unsigned char*  src_line = blit->src_line;
+  unsigned char*        dst_line = blit->dst_line;
+
+  GBlenderPixel  cells[GBLENDER_SHADE_COUNT];
+  GBlenderPixel  cells_back = ~0U;
+  __m128i        fill       = _mm_set1_epi32( (int)color );
+  __m128i        rgb        = _mm_set1_epi32( 0xFFFFFF );
+
+
+  gblender_use_channels( blender, 0 );
+
+  GBLENDER_VARS_SET(blender,color);
+
+  cells[0]                      = 0;
+  cells[GBLENDER_SHADE_COUNT-1] = color;
+
+  do
+  {
+    const unsigned char*  src = src_line + (blit->src_x);
+    unsigned char*        dst = dst_line + blit->dst_x*4;
+    int                   w   = blit->width;
+
+
+    for ( ; w >= 16; w -= 16, src += 16, dst += 64 )
+    {
+      __m128i        s, a, zero, back;
+      __m128i        d0, d1, d2, d3, m0, m1, m2, m3;
+      GBlenderPixel  tmp[16];
+      unsigned char  as[16];
+      int            none, full, part, same, n;
+
+
+      s = _mm_loadu_si128( (const __m128i*)src );
+      GSIMD_SHADES( s, a );
+
+      zero = _mm_cmpeq_epi8( a, _mm_setzero_si128() );
+      none = _mm_movemask_epi8( zero );
+      if ( none == 0xFFFF )
+        continue;
+
+      full = _mm_movemask_epi8(
+               _mm_cmpeq_epi8( a, _mm_set1_epi8( GBLENDER_SHADE_COUNT-1 ) ) );
+      if ( full == 0xFFFF )
+      {
+        _mm_storeu_si128( (__m128i*)( dst      ), fill );
+        _mm_storeu_si128( (__m128i*)( dst + 16 ), fill );
+        _mm_storeu_si128( (__m128i*)( dst + 32 ), fill );
+        _mm_storeu_si128( (__m128i*)( dst + 48 ), fill );
+        continue;
+      }
+
+      _mm_storeu_si128( (__m128i*)as, a );
+
+      d0 = _mm_loadu_si128( (const __m128i*)( dst      ) );
+      d1 = _mm_loadu_si128( (const __m128i*)( dst + 16 ) );
+      d2 = _mm_loadu_si128( (const __m128i*)( dst + 32 ) );
+      d3 = _mm_loadu_si128( (const __m128i*)( dst + 48 ) );
+
+      part = ~( none | full ) & 0xFFFF;
+      if ( part )
+      {
+        back = _mm_set1_epi32( (int)_gback );
+        same =   _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32(
+                   _mm_and_si128( d0, rgb ), back ) ) )         |
+               ( _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32(
+                   _mm_and_si128( d1, rgb ), back ) ) ) << 4 )  |
+               ( _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32(
+                   _mm_and_si128( d2, rgb ), back ) ) ) << 8 )  |
+               ( _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32(
+                   _mm_and_si128( d3, rgb ), back ) ) ) << 12 );
+
+        if ( part & ~same )
+        {
+          for ( n = 0; n < 16; n++ )
+          {
+            GSIMD_PIXEL_RGB32( dst + n*4, as[n] );
+          }
+          continue;
+        }
+
+        GSIMD_CELLS_SET( cells, cells_back );
+        GSIMD_STAT_HITS( blender, part );
+      }
+
+      for ( n = 0; n < 16; n++ )
+        tmp[n] = cells[as[n]];
+
+      GSIMD_EXPAND4( zero, m0, m1, m2, m3 );
+
+#define  GSIMD_SELECT(d,m,t)                                       \
+      _mm_or_si128( _mm_and_si128( (m), (d) ),                     \
+                    _mm_andnot_si128( (m),                         \
+                      _mm_loadu_si128( (const __m128i*)(t) ) ) )
+
+      _mm_storeu_si128( (__m128i*)( dst      ), GSIMD_SELECT( d0, m0, tmp      ) );
+      _mm_storeu_si128( (__m128i*)( dst + 16 ), GSIMD_SELECT( d1, m1, tmp + 4  ) );
+      _mm_storeu_si128( (__m128i*)( dst + 32 ), GSIMD_SELECT( d2, m2, tmp + 8  ) );
+      _mm_storeu_si128( (__m128i*)( dst + 48 ), GSIMD_SELECT( d3, m3, tmp + 12 ) );
+
+#undef GSIMD_SELECT
+    }
+
+    for ( ; w > 0; w--, src++, dst += 4 )
+    {
+      int  a = GBLENDER_SHADE_INDEX(src[0]);
+
+
+      GSIMD_PIXEL_RGB32( dst, a );
+    }
+
+    src_line += blit->src_pitch;
+    dst_line += blit->dst_pitch;
+  }
+  while (--h > 0);
+
+  GBLENDER_CLOSE(blender);
+}
+
+
+__attribute__(( target( "avx2" ) ))
+static void
+_gblender_blit_gray8_rgb32_avx2( GBlenderBlit   blit,
+                                 GBlenderPixel  color )
+{
+  GBlender  blender = blit->blender;
+
+  GBLENDER_VARS;
+
+  int                   h        = blit->height;
+  const unsigned char*  src_line = blit->src_line;
+  unsigned char*        dst_line = blit->dst_line;
+
+  GBlenderPixel  cells[GBLENDER_SHADE_COUNT];
+  GBlenderPixel  cells_back = ~0U;
+  __m256i        fill       = _mm256_set1_epi32( (int)color );
+  __m256i        rgb        = _mm256_set1_epi32( 0xFFFFFF );
+
+
+  gblender_use_channels( blender, 0 );
+
+  GBLENDER_VARS_SET(blender,color);
+
+  cells[0]                      = 0;
+  cells[GBLENDER_SHADE_COUNT-1] = color;
+
+  do
+  {
+    const unsigned char*  src = src_line + (blit->src_x);
+    unsigned char*        dst = dst_line + blit->dst_x*4;
+    int                   w   = blit->width;
+
+
+    for ( ; w >= 16; w -= 16, src += 16, dst += 64 )
+    {
+      __m128i        s, a;
+      __m256i        a0, a1, d0, d1, back;
+      unsigned char  as[16];
+      int            none, full, part, same, n;
+
+
+      s = _mm_loadu_si128( (const __m128i*)src );
+      GSIMD_SHADES( s, a );
+
+      none = _mm_movemask_epi8( _mm_cmpeq_epi8( a, _mm_setzero_si128() ) );
+      if ( none == 0xFFFF )
+        continue;
+
+      full = _mm_movemask_epi8(
+               _mm_cmpeq_epi8( a, _mm_set1_epi8( GBLENDER_SHADE_COUNT-1 ) ) );
+      if ( full == 0xFFFF )
+      {
+        _mm256_storeu_si256( (__m256i*)( dst      ), fill );
+        _mm256_storeu_si256( (__m256i*)( dst + 32 ), fill );
+        continue;
+      }
+
+      d0 = _mm256_loadu_si256( (const __m256i*)( dst      ) );
+      d1 = _mm256_loadu_si256( (const __m256i*)( dst + 32 ) );
+
+      part = ~( none | full ) & 0xFFFF;
+      if ( part )
+      {
+        back = _mm256_set1_epi32( (int)_gback );
+        same =   _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpeq_epi32(
+                   _mm256_and_si256( d0, rgb ), back ) ) )        |
+               ( _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpeq_epi32(
+                   _mm256_and_si256( d1, rgb ), back ) ) ) << 8 );
+
+        if ( part & ~same )
+        {
+          _mm_storeu_si128( (__m128i*)as, a );
+          for ( n = 0; n < 16; n++ )
+          {
+            GSIMD_PIXEL_RGB32( dst + n*4, as[n] );
+          }
+          continue;
+        }
+
+        GSIMD_CELLS_SET( cells, cells_back );
+        GSIMD_STAT_HITS( blender, part );
+      }
+
+      a0 = _mm256_cvtepu8_epi32( a );
+      a1 = _mm256_cvtepu8_epi32( _mm_srli_si128( a, 8 ) );
+
+      d0 = _mm256_blendv_epi8(
+             _mm256_i32gather_epi32( (const int*)cells, a0, 4 ), d0,
+             _mm256_cmpeq_epi32( a0, _mm256_setzero_si256() ) );
+      d1 = _mm256_blendv_epi8(
+             _mm256_i32gather_epi32( (const int*)cells, a1, 4 ), d1,
+             _mm256_cmpeq_epi32( a1, _mm256_setzero_si256() ) );
+
+      _mm256_storeu_si256( (__m256i*)( dst      ), d0 );
+      _mm256_storeu_si256( (__m256i*)( dst + 32 ), d1 );
+    }
+
+    for ( ; w > 0; w--, src++, dst += 4 )
+    {
+      int  a = GBLENDER_SHADE_INDEX(src[0]);
+
+
+      GSIMD_PIXEL_RGB32( dst, a );
+    }
+
+    src_line += blit->src_pitch;
+    dst_line += blit->dst_pitch;
+  }
+  while (--h > 0);
+
+  GBLENDER_CLOSE(blender);
+}
+
+
+/* Without byte shuffles, SSE2 only classifies and fills RGB24 blocks;
+ * mixed blocks take the per-pixel path with their shades at hand.
+ */
+__attribute__(( target( "sse2" ) ))
+static void
+_gblender_blit_gray8_rgb24_sse2( GBlenderBlit   blit,
+                                 GBlenderPixel  color )
+{
+  GBlender      blender = blit->blender;
+  unsigned int  r       = (color >> 16) & 255;
+  unsigned int  g       = (color >> 8)  & 255;
+  unsigned int  b       = (color)       & 255;
+
+  GBLENDER_VARS;
+
+  int                   h        = blit->height;
+  const unsigned char*  src_line = blit->src_line;
+  unsigned char*        dst_line = blit->dst_line;
+
+  unsigned char  pattern[48];
+  __m128i        fill0, fill1, fill2;
+  int            n;
+
+
+  gblender_use_channels( blender, 0 );
+
+  GBLENDER_VARS_SET(blender,color);
+
+  for ( n = 0; n < 48; n += 3 )
+  {
+    GDST_STORE3( pattern + n, r, g, b );
+  }
+  fill0 = _mm_loadu_si128( (const __m128i*)( pattern      ) );
+  fill1 = _mm_loadu_si128( (const __m128i*)( pattern + 16 ) );
+  fill2 = _mm_loadu_si128( (const __m128i*)( pattern + 32 ) );
+
+  do
+  {
+    const unsigned char*  src = src_line + (blit->src_x);
+    unsigned char*        dst = dst_line + blit->dst_x*3;
+    int                   w   = blit->width;
+
+
+    for ( ; w >= 16; w -= 16, src += 16, dst += 48 )
+    {
+      __m128i        s, a;
+      unsigned char  as[16];
+      int            none, full;
+
+
+      s = _mm_loadu_si128( (const __m128i*)src );
+      GSIMD_SHADES( s, a );
+
+      none = _mm_movemask_epi8( _mm_cmpeq_epi8( a, _mm_setzero_si128() ) );
+      if ( none == 0xFFFF )
+        continue;
+
+      full = _mm_movemask_epi8(
+               _mm_cmpeq_epi8( a, _mm_set1_epi8( GBLENDER_SHADE_COUNT-1 ) ) );
+      if ( full == 0xFFFF )
+      {
+        _mm_storeu_si128( (__m128i*)( dst      ), fill0 );
+        _mm_storeu_si128( (__m128i*)( dst + 16 ), fill1 );
+        _mm_storeu_si128( (__m128i*)( dst + 32 ), fill2 );
+        continue;
+      }
+
+      _mm_storeu_si128( (__m128i*)as, a );
+      for ( n = 0; n < 16; n++ )
+      {
+        GSIMD_PIXEL_RGB24( dst + n*3, as[n] );
+      }
+    }
+
+    for ( ; w > 0; w--, src++, dst += 3 )
+    {
+      int  a = GBLENDER_SHADE_INDEX(src[0]);
+
+
+      GSIMD_PIXEL_RGB24( dst, a );
+    }
+
+    src_line += blit->src_pitch;
+    dst_line += blit->dst_pitch;
+  }
+  while (--h > 0);
+
+  GBLENDER_CLOSE(blender);
+}
+
+
+/* AVX2 unpacks RGB24 blocks into 32-bit lanes with byte shuffles and
+ * then proceeds like the RGB32 kernel.
+ */
+__attribute__(( target( "avx2" ) ))
+static void
+_gblender_blit_gray8_rgb24_avx2( GBlenderBlit   blit,
+                                 GBlenderPixel  color )
+{
+  GBlender      blender = blit->blender;
+  unsigned int  r       = (color >> 16) & 255;
+  unsigned int  g       = (color >> 8)  & 255;
+  unsigned int  b       = (color)       & 255;
+
+  GBLENDER_VARS;
+
+  int                   h        = blit->height;
+  const unsigned char*  src_line = blit->src_line;
+  unsigned char*        dst_line = blit->dst_line;
+
+  GBlenderPixel  cells[GBLENDER_SHADE_COUNT];
+  GBlenderPixel  cells_back = ~0U;
+  unsigned char  pattern[48];
+  __m128i        fill0, fill1, fill2;
+  int            n;
+
+  /* bytes (r,g,b) of 4 pixels to 32-bit lanes and back */
+  const __m128i  unpack  = _mm_setr_epi8( 2, 1, 0, -1,  5,  4,  3, -1,
+                                          8, 7, 6, -1, 11, 10,  9, -1 );
+  const __m128i  unpack4 = _mm_setr_epi8( 6, 5, 4, -1,  9,  8,  7, -1,
+                                         12, 11, 10, -1, 15, 14, 13, -1 );
+  const __m128i  pack    = _mm_setr_epi8( 2, 1, 0,  6,  5,  4, 10,  9,
+                                          8, 14, 13, 12, -1, -1, -1, -1 );
+
+
+  gblender_use_channels( blender, 0 );
+
+  GBLENDER_VARS_SET(blender,color);
+
+  cells[0]                      = 0;
+  cells[GBLENDER_SHADE_COUNT-1] = color;
+
+  for ( n = 0; n < 48; n += 3 )
+  {
+    GDST_STORE3( pattern + n, r, g, b );
+  }
+  fill0 = _mm_loadu_si128( (const __m128i*)( pattern      ) );
+  fill1 = _mm_loadu_si128( (const __m128i*)( pattern + 16 ) );
+  fill2 = _mm_loadu_si128( (const __m128i*)( pattern + 32 ) );
+
+  do
+  {
+    const unsigned char*  src = src_line + (blit->src_x);
+    unsigned char*        dst = dst_line + blit->dst_x*3;
+    int                   w   = blit->width;
+
+
+    for ( ; w >= 16; w -= 16, src += 16, dst += 48 )
+    {
+      __m128i        s, a, p0, p1, p2, p3;
+      __m256i        a0, a1, d0, d1, back;
+      unsigned char  as[16];
+      int            none, full, part, same;
+
+
+      s = _mm_loadu_si128( (const __m128i*)src );
+      GSIMD_SHADES( s, a );
+
+      none = _mm_movemask_epi8( _mm_cmpeq_epi8( a, _mm_setzero_si128() ) );
+      if ( none == 0xFFFF )
+        continue;
+
+      full = _mm_movemask_epi8(
+               _mm_cmpeq_epi8( a, _mm_set1_epi8( GBLENDER_SHADE_COUNT-1 ) ) );
+      if ( full == 0xFFFF )
+      {
+        _mm_storeu_si128( (__m128i*)( dst      ), fill0 );
+        _mm_storeu_si128( (__m128i*)( dst + 16 ), fill1 );
+        _mm_storeu_si128( (__m128i*)( dst + 32 ), fill2 );
+        continue;
+      }
+
+      /* the last load ends with the block */
+      p0 = _mm_loadu_si128( (const __m128i*)( dst      ) );
+      p1 = _mm_loadu_si128( (const __m128i*)( dst + 12 ) );
+      p2 = _mm_loadu_si128( (const __m128i*)( dst + 24 ) );
+      p3 = _mm_loadu_si128( (const __m128i*)( dst + 32 ) );
+
+      d0 = _mm256_inserti128_si256(
+             _mm256_castsi128_si256( _mm_shuffle_epi8( p0, unpack ) ),
+             _mm_shuffle_epi8( p1, unpack ), 1 );
+      d1 = _mm256_inserti128_si256(
+             _mm256_castsi128_si256( _mm_shuffle_epi8( p2, unpack ) ),
+             _mm_shuffle_epi8( p3, unpack4 ), 1 );
+
+      part = ~( none | full ) & 0xFFFF;
+      if ( part )
+      {
+        back = _mm256_set1_epi32( (int)_gback );
+        same =   _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpeq_epi32(
+                   d0, back ) ) )        |
+               ( _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpeq_epi32(
+                   d1, back ) ) ) << 8 );
+
+        if ( part & ~same )
+        {
+          _mm_storeu_si128( (__m128i*)as, a );
+          for ( n = 0; n < 16; n++ )
+          {
+            GSIMD_PIXEL_RGB24( dst + n*3, as[n] );
+          }
+          continue;
+        }
+
+        GSIMD_CELLS_SET( cells, cells_back );
+        GSIMD_STAT_HITS( blender, part );
+      }
+
+      a0 = _mm256_cvtepu8_epi32( a );
+      a1 = _mm256_cvtepu8_epi32( _mm_srli_si128( a, 8 ) );
+
+      d0 = _mm256_blendv_epi8(
+             _mm256_i32gather_epi32( (const int*)cells, a0, 4 ), d0,
+             _mm256_cmpeq_epi32( a0, _mm256_setzero_si256() ) );
+      d1 = _mm256_blendv_epi8(
+             _mm256_i32gather_epi32( (const int*)cells, a1, 4 ), d1,
+             _mm256_cmpeq_epi32( a1, _mm256_setzero_si256() ) );
+
+      p0 = _mm_shuffle_epi8( _mm256_castsi256_si128( d0 ), pack );
+      p1 = _mm_shuffle_epi8( _mm256_extracti128_si256( d0, 1 ), pack );
+      p2 = _mm_shuffle_epi8( _mm256_castsi256_si128( d1 ), pack );
+      p3 = _mm_shuffle_epi8( _mm256_extracti128_si256( d1, 1 ), pack );
+
+      _mm_storeu_si128( (__m128i*)( dst ),
+                        _mm_or_si128( p0, _mm_slli_si128( p1, 12 ) ) );
+      _mm_storeu_si128( (__m128i*)( dst + 16 ),
+                        _mm_or_si128( _mm_srli_si128( p1, 4 ),
+                                      _mm_slli_si128( p2, 8 ) ) );
+      _mm_storeu_si128( (__m128i*)( dst + 32 ),
+                        _mm_or_si128( _mm_srli_si128( p2, 8 ),
+                                      _mm_slli_si128( p3, 4 ) ) );
+    }
+
+    for ( ; w > 0; w--, src++, dst += 3 )
+    {
+      int  a = GBLENDER_SHADE_INDEX(src[0]);
+
+
+      GSIMD_PIXEL_RGB24( dst, a );
+    }
+
+    src_line += blit->src_pitch;
+    dst_line += blit->dst_pitch;
+  }
+  while (--h > 0);
+
+  GBLENDER_CLOSE(blender);
+}
+
+#endif /* SIMD */
+
+/* EOF */
@@ -650,6 +650,10 @@
   * <Note>
   *    XXX : For now, only keypresses are supported.
   *
+  *    With `gr_event_poll', the X11 and Windows drivers return an
+  *    event of type `gr_event_none' instead of waiting if there is
+  *    no pending event.
+  *
   **********************************************************************/
 
   extern
@@ -5,6 +5,7 @@
  *  this filtering code is explicitly placed in the public domain !!
  */
 #include <stdlib.h>
+#include <string.h>
 #include <memory.h>
 
 #include "grswizzle.h"
@@ -416,9 +417,12 @@ postprocess_line_rgb565( unsigned char** lines,
 
   unsigned int     l_mask, r_mask, c_mask;
 
-  l_mask = masks[offset];
-  c_mask = masks[offset+1];
-  r_mask = masks[offset+2];
+  /* like the RGB24 version: keep the pixel's own channel, take the */
+  /* next one from the right and below, the last one from the left  */
+  /* and above                                                      */
+  l_mask = masks[offset+2];
+  c_mask = masks[offset];
+  r_mask = masks[offset+1];
 
   for ( nn = 0; nn < width; nn += 1 )
   {
@@ -507,9 +511,12 @@ postprocess_line_xrgb32( unsigned char** lines,
 
   unsigned int     l_mask, r_mask, c_mask;
 
-  l_mask = masks[offset];
-  c_mask = masks[offset+1];
-  r_mask = masks[offset+2];
+  /* like the RGB24 version: keep the pixel's own channel, take the */
+  /* next one from the right and below, the last one from the left  */
+  /* and above                                                      */
+  l_mask = masks[offset+2];
+  c_mask = masks[offset];
+  r_mask = masks[offset+1];
 
   for ( nn = 0; nn < width; nn += 1 )
   {
@@ -532,6 +539,357 @@ postprocess_line_xrgb32( unsigned char** lines,
 
 
 
+/************************************************************************/
+/************************************************************************/
+/*****                                                              *****/
+/*****               S I M D   S U P P O R T                        *****/
+/*****                                                              *****/
+/************************************************************************/
+/************************************************************************/
+
+enum
+{
+  SWIZZLE_RGB24 = 0,
+  SWIZZLE_RGB565,
+  SWIZZLE_XRGB32,
+
+  SWIZZLE_MAX
+};
+
+
+/* the line functions of each format, swizzling and post-processing
+ */
+static const filter_func_t  swizzle_funcs_generic[SWIZZLE_MAX][2] =
+{
+  { swizzle_line_rgb24,  postprocess_line_rgb24  },
+  { swizzle_line_rgb565, postprocess_line_rgb565 },
+  { swizzle_line_xrgb32, postprocess_line_xrgb32 }
+};
+
+/* the ones in use, see gr_swizzle_select */
+static const filter_func_t  (*swizzle_funcs)[2] = swizzle_funcs_generic;
+static const char*           swizzle_kernel     = NULL;
+
+
+#if ( defined __GNUC__ || defined __clang__ )    && \
+    ( defined __x86_64__ || defined __i386__ )   && \
+    defined ANTIALIAS
+
+#define  SWIZZLE_SIMD
+
+#include <immintrin.h>
+
+
+/* the kernels below work on whole lines at once, with the channel
+ * selection of each byte read from repeating masks: both the channel
+ * that a pixel keeps and the channels that the post-processing takes
+ * from its neighbours only depend on the pixel's column modulo 3.
+ * all results are exactly those of the generic line functions.
+ */
+typedef struct  swizzle_masks_t_
+{
+  int            period;       /* three pixels, in bytes                */
+  unsigned char  keep  [48];   /* the channel kept by swizzling         */
+  unsigned char  left  [48];   /* the channels post-processing takes    */
+  unsigned char  right [48];   /* from the left and above, right and    */
+  unsigned char  center[48];   /* below, and the pixel itself           */
+
+} swizzle_masks_t;
+
+static swizzle_masks_t  swizzle_masks[SWIZZLE_MAX][3];
+
+
+/* `chans' holds the pixel masks of the three channels, in the order in
+ * which they are kept; post-processing takes channel `shift' from the
+ * left, for the first pixel of a line starting at `offset'
+ */
+static void
+swizzle_masks_init( swizzle_masks_t*     masks,
+                    const unsigned int*  chans,
+                    int                  pix_bytes,
+                    int                  shift,
+                    int                  offset )
+{
+  int  nn;
+
+  masks->period = 3 * pix_bytes;
+
+  for ( nn = 0; nn < 48; nn++ )
+  {
+    int  phase = ( nn / pix_bytes + offset ) % 3;
+    int  bits  = 8 * ( nn % pix_bytes );
+
+    masks->keep[nn]   = (unsigned char)( chans[phase] >> bits );
+    masks->left[nn]   = (unsigned char)( chans[( phase + shift     ) % 3] >> bits );
+    masks->center[nn] = (unsigned char)( chans[( phase + shift + 1 ) % 3] >> bits );
+    masks->right[nn]  = (unsigned char)( chans[( phase + shift + 2 ) % 3] >> bits );
+  }
+}
+
+
+/* the remaining bytes of a line, starting at byte `nn' and `phase'
+ */
+static void
+swizzle_bytes_tail( unsigned char**         lines,
+                    unsigned char*          write,
+                    int                     nn,
+                    int                     count,
+                    int                     pix_bytes,
+                    const swizzle_masks_t*  masks,
+                    int                     phase )
+{
+  unsigned char*  above   = lines[0] + pix_bytes;
+  unsigned char*  current = lines[1] + pix_bytes;
+  unsigned char*  below   = lines[2] + pix_bytes;
+
+  for ( ; nn < count; nn++ )
+  {
+    unsigned int  sum;
+
+    sum  = (unsigned int)current[nn] << 2;
+
+    sum += current[nn-pix_bytes] +
+           current[nn+pix_bytes] +
+           above  [nn]           +
+           below  [nn]           ;
+
+    write[nn] = (unsigned char)( (sum >> 3) & masks->keep[phase] );
+
+    if ( ++phase == masks->period )
+      phase = 0;
+  }
+}
+
+
+static void
+postprocess_bytes_tail( unsigned char**         lines,
+                        unsigned char*          write,
+                        int                     nn,
+                        int                     count,
+                        int                     pix_bytes,
+                        const swizzle_masks_t*  masks,
+                        int                     phase )
+{
+  unsigned char*  above   = lines[0] + pix_bytes;
+  unsigned char*  current = lines[1] + pix_bytes;
+  unsigned char*  below   = lines[2] + pix_bytes;
+
+  for ( ; nn < count; nn++ )
+  {
+    unsigned int  left, right;
+
+    left  = (unsigned int)( current[nn-pix_bytes] + above[nn] ) >> 1;
+    right = (unsigned int)( current[nn+pix_bytes] + below[nn] ) >> 1;
+
+    write[nn] = (unsigned char)( ( left        & masks->left[phase]   ) |
+                                 ( right       & masks->right[phase]  ) |
+                                 ( current[nn] & masks->center[phase] ) );
+
+    if ( ++phase == masks->period )
+      phase = 0;
+  }
+}
+
+
+static void
+swizzle_rgb565_tail( unsigned char**         lines,
+                     unsigned char*          write,
+                     int                     nn,
+                     int                     count,
+                     int                     pix_bytes,
+                     const swizzle_masks_t*  masks,
+                     int                     phase )
+{
+  for ( ; nn < count; nn += 2 )
+  {
+    unsigned int  mask = masks->keep[phase] | ( masks->keep[phase+1] << 8 );
+    unsigned int  sum;
+
+#define  PIX( line, delta )                                   \
+    ( ( lines[line][nn + pix_bytes + (delta)]        |        \
+        lines[line][nn + pix_bytes + (delta) + 1] << 8 ) & mask )
+
+    sum  = PIX( 1, 0 ) << 2;
+    sum += PIX( 1, -2 ) + PIX( 1, 2 ) + PIX( 0, 0 ) + PIX( 2, 0 );
+
+#undef PIX
+
+    sum = (sum >> 3) & mask;
+
+    write[nn]   = (unsigned char)sum;
+    write[nn+1] = (unsigned char)(sum >> 8);
+
+    if ( ( phase += 2 ) == masks->period )
+      phase = 0;
+  }
+}
+
+
+static void
+postprocess_rgb565_tail( unsigned char**         lines,
+                         unsigned char*          write,
+                         int                     nn,
+                         int                     count,
+                         int                     pix_bytes,
+                         const swizzle_masks_t*  masks,
+                         int                     phase )
+{
+  for ( ; nn < count; nn += 2 )
+  {
+    unsigned int  l_mask = masks->left[phase]   | ( masks->left[phase+1]   << 8 );
+    unsigned int  r_mask = masks->right[phase]  | ( masks->right[phase+1]  << 8 );
+    unsigned int  c_mask = masks->center[phase] | ( masks->center[phase+1] << 8 );
+    unsigned int  left, right, center;
+
+#define  PIX( line, delta )                                   \
+    ( lines[line][nn + pix_bytes + (delta)]        |          \
+      lines[line][nn + pix_bytes + (delta) + 1] << 8 )
+
+    center = PIX( 1, 0 );
+    left   = ( ( PIX( 1, -2 ) & l_mask ) + ( PIX( 0, 0 ) & l_mask ) ) >> 1;
+    right  = ( ( PIX( 1, 2 )  & r_mask ) + ( PIX( 2, 0 ) & r_mask ) ) >> 1;
+
+#undef PIX
+
+    center = (left & l_mask) | (right & r_mask) | (center & c_mask);
+
+    write[nn]   = (unsigned char)center;
+    write[nn+1] = (unsigned char)(center >> 8);
+
+    if ( ( phase += 2 ) == masks->period )
+      phase = 0;
+  }
+}
+
+
+/* the kernels for 128-bit vectors
+ */
+#define  GSWZ_SUFFIX           sse2
+#define  GSWZ_TARGET           "sse2"
+#define  GSWZ_VEC              __m128i
+#define  GSWZ_SIZE             16
+#define  GSWZ_LOAD(p)          _mm_loadu_si128( (const __m128i*)(p) )
+#define  GSWZ_STORE(p,v)       _mm_storeu_si128( (__m128i*)(p), (v) )
+#define  GSWZ_ZERO()           _mm_setzero_si128()
+#define  GSWZ_SET1_8(x)        _mm_set1_epi8( (char)(x) )
+#define  GSWZ_SET1_16(x)       _mm_set1_epi16( (short)(x) )
+#define  GSWZ_AND(a,b)         _mm_and_si128( (a), (b) )
+#define  GSWZ_OR(a,b)          _mm_or_si128( (a), (b) )
+#define  GSWZ_XOR(a,b)         _mm_xor_si128( (a), (b) )
+#define  GSWZ_ADD16(a,b)       _mm_add_epi16( (a), (b) )
+#define  GSWZ_SUB8(a,b)        _mm_sub_epi8( (a), (b) )
+#define  GSWZ_SLLI16(a,n)      _mm_slli_epi16( (a), (n) )
+#define  GSWZ_SRLI16(a,n)      _mm_srli_epi16( (a), (n) )
+#define  GSWZ_UNPACKLO8(a,b)   _mm_unpacklo_epi8( (a), (b) )
+#define  GSWZ_UNPACKHI8(a,b)   _mm_unpackhi_epi8( (a), (b) )
+#define  GSWZ_PACKUS16(a,b)    _mm_packus_epi16( (a), (b) )
+#define  GSWZ_AVG8(a,b)        _mm_avg_epu8( (a), (b) )
+
+#include "grswzany.h"
+
+/* the kernels for 256-bit vectors; all operations stay within the
+ * 128-bit halves, where unpacking and packing cancel each other
+ */
+#define  GSWZ_SUFFIX           avx2
+#define  GSWZ_TARGET           "avx2"
+#define  GSWZ_VEC              __m256i
+#define  GSWZ_SIZE             32
+#define  GSWZ_LOAD(p)          _mm256_loadu_si256( (const __m256i*)(p) )
+#define  GSWZ_STORE(p,v)       _mm256_storeu_si256( (__m256i*)(p), (v) )
+#define  GSWZ_ZERO()           _mm256_setzero_si256()
+#define  GSWZ_SET1_8(x)        _mm256_set1_epi8( (char)(x) )
+#define  GSWZ_SET1_16(x)       _mm256_set1_epi16( (short)(x) )
+#define  GSWZ_AND(a,b)         _mm256_and_si256( (a), (b) )
+#define  GSWZ_OR(a,b)          _mm256_or_si256( (a), (b) )
+#define  GSWZ_XOR(a,b)         _mm256_xor_si256( (a), (b) )
+#define  GSWZ_ADD16(a,b)       _mm256_add_epi16( (a), (b) )
+#define  GSWZ_SUB8(a,b)        _mm256_sub_epi8( (a), (b) )
+#define  GSWZ_SLLI16(a,n)      _mm256_slli_epi16( (a), (n) )
+#define  GSWZ_SRLI16(a,n)      _mm256_srli_epi16( (a), (n) )
+#define  GSWZ_UNPACKLO8(a,b)   _mm256_unpacklo_epi8( (a), (b) )
+#define  GSWZ_UNPACKHI8(a,b)   _mm256_unpackhi_epi8( (a), (b) )
+#define  GSWZ_PACKUS16(a,b)    _mm256_packus_epi16( (a), (b) )
+#define  GSWZ_AVG8(a,b)        _mm256_avg_epu8( (a), (b) )
+
+#include "grswzany.h"
+
+
+static void
+swizzle_masks_setup( void )
+{
+  static const unsigned int  rgb24[3]  = { 0x0000FF, 0x00FF00, 0xFF0000 };
+  static const unsigned int  rgb565[3] = { 0xF800, 0x07E0, 0x001F };
+  static const unsigned int  xrgb32[3] = { 0xFF0000, 0x00FF00, 0x0000FF };
+  int                        offset;
+
+  for ( offset = 0; offset < 3; offset++ )
+  {
+    swizzle_masks_init( &swizzle_masks[SWIZZLE_RGB24][offset],
+                        rgb24, 3, 2, offset );
+    swizzle_masks_init( &swizzle_masks[SWIZZLE_RGB565][offset],
+                        rgb565, 2, 2, offset );
+    swizzle_masks_init( &swizzle_masks[SWIZZLE_XRGB32][offset],
+                        xrgb32, 4, 2, offset );
+  }
+}
+
+#endif /* SWIZZLE_SIMD */
+
+
+extern int
+gr_swizzle_select( const char*  kernel )
+{
+#ifdef SWIZZLE_SIMD
+  int  avx2, sse2;
+
+  __builtin_cpu_init();
+  avx2 = __builtin_cpu_supports( "avx2" );
+  sse2 = __builtin_cpu_supports( "sse2" );
+
+  swizzle_masks_setup();
+
+  if ( kernel == NULL )
+    kernel = avx2 ? "AVX2" : sse2 ? "SSE2" : "generic";
+
+  if ( !strcmp( kernel, "AVX2" ) && avx2 )
+  {
+    swizzle_funcs  = swizzle_funcs_avx2;
+    swizzle_kernel = "AVX2";
+    return 1;
+  }
+
+  if ( !strcmp( kernel, "SSE2" ) && sse2 )
+  {
+    swizzle_funcs  = swizzle_funcs_sse2;
+    swizzle_kernel = "SSE2";
+    return 1;
+  }
+#else
+  if ( kernel == NULL )
+    kernel = "generic";
+#endif
+
+  if ( !strcmp( kernel, "generic" ) )
+  {
+    swizzle_funcs  = swizzle_funcs_generic;
+    swizzle_kernel = "generic";
+    return 1;
+  }
+
+  return 0;
+}
+
+
+extern const char*
+gr_swizzle_kernel( void )
+{
+  if ( !swizzle_kernel )
+    gr_swizzle_select( NULL );
+
+  return swizzle_kernel;
+}
+
+
 static void
 gr_swizzle_generic( unsigned char*    read_buff,
                    int                read_pitch,
@@ -610,14 +968,17 @@ gr_swizzle_rect_rgb24( unsigned char*    read_buff,
                        int               width,
                        int               height )
 {
+  if ( !swizzle_kernel )
+    gr_swizzle_select( NULL );
+
   gr_swizzle_generic( read_buff, read_pitch,
                       write_buff, write_pitch,
                       buff_width,
                       buff_height,
                       x, y, width, height,
                       3,
-                      swizzle_line_rgb24,
-                      postprocess_line_rgb24 );
+                      swizzle_funcs[SWIZZLE_RGB24][0],
+                      swizzle_funcs[SWIZZLE_RGB24][1] );
 }
 
 
@@ -634,14 +995,17 @@ gr_swizzle_rect_rgb565( unsigned char*    read_buff,
                         int               width,
                         int               height )
 {
+  if ( !swizzle_kernel )
+    gr_swizzle_select( NULL );
+
   gr_swizzle_generic( read_buff, read_pitch,
                       write_buff, write_pitch,
                       buff_width,
                       buff_height,
                       x, y, width, height,
                       2,
-                      swizzle_line_rgb565,
-                      postprocess_line_rgb565 );
+                      swizzle_funcs[SWIZZLE_RGB565][0],
+                      swizzle_funcs[SWIZZLE_RGB565][1] );
 }
 
 
@@ -658,14 +1022,17 @@ gr_swizzle_rect_xrgb32( unsigned char*    read_buff,
                         int               width,
                         int               height )
 {
+  if ( !swizzle_kernel )
+    gr_swizzle_select( NULL );
+
   gr_swizzle_generic( read_buff, read_pitch,
                       write_buff, write_pitch,
                       buff_width,
                       buff_height,
                       x, y, width, height,
                       4,
-                      swizzle_line_xrgb32,
-                      postprocess_line_xrgb32 );
+                      swizzle_funcs[SWIZZLE_XRGB32][0],
+                      swizzle_funcs[SWIZZLE_XRGB32][1] );
 }
 
 
@@ -37,4 +37,14 @@ gr_swizzle_rect_xrgb32( unsigned char*    read_buff,
                         int               width,
                         int               height );
 
+/* select the line kernels, "generic", "SSE2" or "AVX2"; NULL picks */
+/* the fastest one the processor supports.  Return 0 if `kernel' is  */
+/* not available, leaving the selection unchanged                     */
+int
+gr_swizzle_select( const char*  kernel );
+
+/* the name of the line kernels in use */
+const char*
+gr_swizzle_kernel( void );
+
 #endif /* GRSWIZZLE_H_ */
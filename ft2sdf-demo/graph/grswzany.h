@@ -0,0 +1,271 @@
+/* vectorized line functions of grswizzle.c, instantiated once for each
+ * vector size; `count' is in bytes.  Check that all macros are set.
+ */
+#ifndef GSWZ_SUFFIX
+#error "GSWZ_SUFFIX not defined"
+#endif
+
+#ifndef GSWZ_TARGET
+#error "GSWZ_TARGET not defined"
+#endif
+
+#ifndef GSWZ_VEC
+#error "GSWZ_VEC not defined"
+#endif
+
+#ifndef GSWZ_SIZE
+#error "GSWZ_SIZE not defined"
+#endif
+
+#undef  GCONCAT
+#undef  GCONCATX
+#define GCONCAT(x,y)  GCONCATX(x,y)
+#define GCONCATX(x,y)  x ## y
+
+
+/* (a + b) >> 1 of each byte */
+#define  GSWZ_FLOOR_AVG8(a,b)                                      \
+  GSWZ_SUB8( GSWZ_AVG8( (a), (b) ),                                \
+             GSWZ_AND( GSWZ_XOR( (a), (b) ), GSWZ_SET1_8( 1 ) ) )
+
+/* (a + b) >> 1 of each channel of RGB565 pixels */
+#define  GSWZ_FLOOR_AVG565(a,b)                                    \
+  GSWZ_ADD16( GSWZ_AND( (a), (b) ),                                \
+              GSWZ_AND( GSWZ_SRLI16( GSWZ_XOR( (a), (b) ), 1 ),    \
+                        GSWZ_SET1_16( 0x7BEF ) ) )
+
+
+__attribute__(( target( GSWZ_TARGET ) ))
+static void
+GCONCAT( swizzle_bytes_, GSWZ_SUFFIX )( unsigned char**         lines,
+                                        unsigned char*          write,
+                                        int                     count,
+                                        int                     pix_bytes,
+                                        const swizzle_masks_t*  masks )
+{
+  unsigned char*  above   = lines[0] + pix_bytes;
+  unsigned char*  current = lines[1] + pix_bytes;
+  unsigned char*  below   = lines[2] + pix_bytes;
+  GSWZ_VEC        zero    = GSWZ_ZERO();
+  int             nn, phase = 0;
+
+  for ( nn = 0; nn + GSWZ_SIZE <= count; nn += GSWZ_SIZE )
+  {
+    GSWZ_VEC  c = GSWZ_LOAD( current + nn );
+    GSWZ_VEC  l = GSWZ_LOAD( current + nn - pix_bytes );
+    GSWZ_VEC  r = GSWZ_LOAD( current + nn + pix_bytes );
+    GSWZ_VEC  a = GSWZ_LOAD( above + nn );
+    GSWZ_VEC  b = GSWZ_LOAD( below + nn );
+    GSWZ_VEC  lo, hi;
+
+    lo = GSWZ_SLLI16( GSWZ_UNPACKLO8( c, zero ), 2 );
+    lo = GSWZ_ADD16( lo, GSWZ_ADD16( GSWZ_UNPACKLO8( l, zero ),
+                                     GSWZ_UNPACKLO8( r, zero ) ) );
+    lo = GSWZ_ADD16( lo, GSWZ_ADD16( GSWZ_UNPACKLO8( a, zero ),
+                                     GSWZ_UNPACKLO8( b, zero ) ) );
+
+    hi = GSWZ_SLLI16( GSWZ_UNPACKHI8( c, zero ), 2 );
+    hi = GSWZ_ADD16( hi, GSWZ_ADD16( GSWZ_UNPACKHI8( l, zero ),
+                                     GSWZ_UNPACKHI8( r, zero ) ) );
+    hi = GSWZ_ADD16( hi, GSWZ_ADD16( GSWZ_UNPACKHI8( a, zero ),
+                                     GSWZ_UNPACKHI8( b, zero ) ) );
+
+    c = GSWZ_PACKUS16( GSWZ_SRLI16( lo, 3 ), GSWZ_SRLI16( hi, 3 ) );
+
+    GSWZ_STORE( write + nn,
+                GSWZ_AND( c, GSWZ_LOAD( masks->keep + phase ) ) );
+
+    phase = ( phase + GSWZ_SIZE ) % masks->period;
+  }
+
+  swizzle_bytes_tail( lines, write, nn, count, pix_bytes, masks, phase );
+}
+
+
+__attribute__(( target( GSWZ_TARGET ) ))
+static void
+GCONCAT( postprocess_bytes_, GSWZ_SUFFIX )( unsigned char**         lines,
+                                            unsigned char*          write,
+                                            int                     count,
+                                            int                     pix_bytes,
+                                            const swizzle_masks_t*  masks )
+{
+  unsigned char*  above   = lines[0] + pix_bytes;
+  unsigned char*  current = lines[1] + pix_bytes;
+  unsigned char*  below   = lines[2] + pix_bytes;
+  int             nn, phase = 0;
+
+  for ( nn = 0; nn + GSWZ_SIZE <= count; nn += GSWZ_SIZE )
+  {
+    GSWZ_VEC  c = GSWZ_LOAD( current + nn );
+    GSWZ_VEC  l = GSWZ_LOAD( current + nn - pix_bytes );
+    GSWZ_VEC  r = GSWZ_LOAD( current + nn + pix_bytes );
+    GSWZ_VEC  a = GSWZ_LOAD( above + nn );
+    GSWZ_VEC  b = GSWZ_LOAD( below + nn );
+
+    l = GSWZ_AND( GSWZ_FLOOR_AVG8( l, a ), GSWZ_LOAD( masks->left + phase ) );
+    r = GSWZ_AND( GSWZ_FLOOR_AVG8( r, b ), GSWZ_LOAD( masks->right + phase ) );
+    c = GSWZ_AND( c, GSWZ_LOAD( masks->center + phase ) );
+
+    GSWZ_STORE( write + nn, GSWZ_OR( GSWZ_OR( l, r ), c ) );
+
+    phase = ( phase + GSWZ_SIZE ) % masks->period;
+  }
+
+  postprocess_bytes_tail( lines, write, nn, count, pix_bytes, masks, phase );
+}
+
+
+/* the channels of RGB565 pixels are filtered one after the other
+ */
+__attribute__(( target( GSWZ_TARGET ) ))
+static void
+GCONCAT( swizzle_rgb565_, GSWZ_SUFFIX )( unsigned char**         lines,
+                                         unsigned char*          write,
+                                         int                     count,
+                                         int                     pix_bytes,
+                                         const swizzle_masks_t*  masks )
+{
+  unsigned char*  above   = lines[0] + pix_bytes;
+  unsigned char*  current = lines[1] + pix_bytes;
+  unsigned char*  below   = lines[2] + pix_bytes;
+  GSWZ_VEC        g_mask  = GSWZ_SET1_16( 0x3F );
+  GSWZ_VEC        b_mask  = GSWZ_SET1_16( 0x1F );
+  int             nn, phase = 0;
+
+#define  GSWZ_FIELD(v,shift,mask)                                      \
+  GSWZ_AND( GSWZ_SRLI16( (v), (shift) ), (mask) )
+
+#define  GSWZ_FILTER(shift,mask)                                       \
+  GSWZ_ADD16(                                                          \
+    GSWZ_ADD16( GSWZ_SLLI16( GSWZ_FIELD( c, shift, mask ), 2 ),        \
+                GSWZ_ADD16( GSWZ_FIELD( l, shift, mask ),              \
+                            GSWZ_FIELD( r, shift, mask ) ) ),          \
+    GSWZ_ADD16( GSWZ_FIELD( a, shift, mask ),                          \
+                GSWZ_FIELD( b, shift, mask ) ) )
+
+  for ( nn = 0; nn + GSWZ_SIZE <= count; nn += GSWZ_SIZE )
+  {
+    GSWZ_VEC  c = GSWZ_LOAD( current + nn );
+    GSWZ_VEC  l = GSWZ_LOAD( current + nn - pix_bytes );
+    GSWZ_VEC  r = GSWZ_LOAD( current + nn + pix_bytes );
+    GSWZ_VEC  a = GSWZ_LOAD( above + nn );
+    GSWZ_VEC  b = GSWZ_LOAD( below + nn );
+    GSWZ_VEC  sr, sg, sb;
+
+    sr = GSWZ_SLLI16( GSWZ_SRLI16( GSWZ_FILTER( 11, b_mask ), 3 ), 11 );
+    sg = GSWZ_SLLI16( GSWZ_SRLI16( GSWZ_FILTER( 5, g_mask ), 3 ), 5 );
+    sb = GSWZ_SRLI16( GSWZ_FILTER( 0, b_mask ), 3 );
+
+    GSWZ_STORE( write + nn,
+                GSWZ_AND( GSWZ_OR( GSWZ_OR( sr, sg ), sb ),
+                          GSWZ_LOAD( masks->keep + phase ) ) );
+
+    phase = ( phase + GSWZ_SIZE ) % masks->period;
+  }
+
+#undef GSWZ_FILTER
+#undef GSWZ_FIELD
+
+  swizzle_rgb565_tail( lines, write, nn, count, pix_bytes, masks, phase );
+}
+
+
+__attribute__(( target( GSWZ_TARGET ) ))
+static void
+GCONCAT( postprocess_rgb565_, GSWZ_SUFFIX )( unsigned char**         lines,
+                                             unsigned char*          write,
+                                             int                     count,
+                                             int                     pix_bytes,
+                                             const swizzle_masks_t*  masks )
+{
+  unsigned char*  above   = lines[0] + pix_bytes;
+  unsigned char*  current = lines[1] + pix_bytes;
+  unsigned char*  below   = lines[2] + pix_bytes;
+  int             nn, phase = 0;
+
+  for ( nn = 0; nn + GSWZ_SIZE <= count; nn += GSWZ_SIZE )
+  {
+    GSWZ_VEC  c = GSWZ_LOAD( current + nn );
+    GSWZ_VEC  l = GSWZ_LOAD( current + nn - pix_bytes );
+    GSWZ_VEC  r = GSWZ_LOAD( current + nn + pix_bytes );
+    GSWZ_VEC  a = GSWZ_LOAD( above + nn );
+    GSWZ_VEC  b = GSWZ_LOAD( below + nn );
+
+    l = GSWZ_AND( GSWZ_FLOOR_AVG565( l, a ), GSWZ_LOAD( masks->left + phase ) );
+    r = GSWZ_AND( GSWZ_FLOOR_AVG565( r, b ), GSWZ_LOAD( masks->right + phase ) );
+    c = GSWZ_AND( c, GSWZ_LOAD( masks->center + phase ) );
+
+    GSWZ_STORE( write + nn, GSWZ_OR( GSWZ_OR( l, r ), c ) );
+
+    phase = ( phase + GSWZ_SIZE ) % masks->period;
+  }
+
+  postprocess_rgb565_tail( lines, write, nn, count, pix_bytes, masks, phase );
+}
+
+
+/* the line functions, by format
+ */
+#define  GSWZ_LINE( name, kernel, format, pix_bytes )                  \
+  static void                                                          \
+  GCONCAT( name, GSWZ_SUFFIX )( unsigned char**  lines,                \
+                                unsigned char*   write,                \
+                                int              width,                \
+                                int              offset )              \
+  {                                                                    \
+    GCONCAT( kernel, GSWZ_SUFFIX )( lines, write,                      \
+                                    width * (pix_bytes), (pix_bytes),  \
+                                    &swizzle_masks[format][offset] );  \
+  }
+
+GSWZ_LINE( swizzle_line_rgb24_,      swizzle_bytes_,      SWIZZLE_RGB24,  3 )
+GSWZ_LINE( postprocess_line_rgb24_,  postprocess_bytes_,  SWIZZLE_RGB24,  3 )
+GSWZ_LINE( swizzle_line_rgb565_,     swizzle_rgb565_,     SWIZZLE_RGB565, 2 )
+GSWZ_LINE( postprocess_line_rgb565_, postprocess_rgb565_, SWIZZLE_RGB565, 2 )
+GSWZ_LINE( swizzle_line_xrgb32_,     swizzle_bytes_,      SWIZZLE_XRGB32, 4 )
+GSWZ_LINE( postprocess_line_xrgb32_, postprocess_bytes_,  SWIZZLE_XRGB32, 4 )
+
+
+static const filter_func_t
+GCONCAT( swizzle_funcs_, GSWZ_SUFFIX )[SWIZZLE_MAX][2] =
+{
+  { GCONCAT( swizzle_line_rgb24_,  GSWZ_SUFFIX ),
+    GCONCAT( postprocess_line_rgb24_,  GSWZ_SUFFIX ) },
+  { GCONCAT( swizzle_line_rgb565_, GSWZ_SUFFIX ),
+    GCONCAT( postprocess_line_rgb565_, GSWZ_SUFFIX ) },
+  { GCONCAT( swizzle_line_xrgb32_, GSWZ_SUFFIX ),
+    GCONCAT( postprocess_line_xrgb32_, GSWZ_SUFFIX ) }
+};
+
+
+/* unset the macros, to prevent accidental re-use
+ */
+
+#undef GSWZ_LINE
+#undef GSWZ_FLOOR_AVG565
+#undef GSWZ_FLOOR_AVG8
+#undef GCONCATX
+#undef GCONCAT
+#undef GSWZ_SUFFIX
+#undef GSWZ_TARGET
+#undef GSWZ_VEC
+#undef GSWZ_SIZE
+#undef GSWZ_LOAD
+#undef GSWZ_STORE
+#undef GSWZ_ZERO
+#undef GSWZ_SET1_8
+#undef GSWZ_SET1_16
+#undef GSWZ_AND
+#undef GSWZ_OR
+#undef GSWZ_XOR
+#undef GSWZ_ADD16
+#undef GSWZ_SUB8
+#undef GSWZ_SLLI16
+#undef GSWZ_SRLI16
+#undef GSWZ_UNPACKLO8
+#undef GSWZ_UNPACKHI8
+#undef GSWZ_PACKUS16
+#undef GSWZ_AVG8
+
+/* EOF */
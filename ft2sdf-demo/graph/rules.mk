@@ -26,6 +26,7 @@ GRAPH_H := $(GRAPH)/gblany.h    \
            $(GRAPH)/gblvbgr.h   \
            $(GRAPH)/gblvrgb.h   \
            $(GRAPH)/gblender.h  \
+           $(GRAPH)/gblsimd.h   \
            $(GRAPH)/graph.h     \
            $(GRAPH)/grblit.h    \
            $(GRAPH)/grconfig.h  \
@@ -34,6 +35,7 @@ GRAPH_H := $(GRAPH)/gblany.h    \
            $(GRAPH)/grfont.h    \
            $(GRAPH)/grobjs.h    \
            $(GRAPH)/grswizzle.h \
+           $(GRAPH)/grswzany.h  \
            $(GRAPH)/grtypes.h
 
 
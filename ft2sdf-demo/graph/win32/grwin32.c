@@ -316,10 +316,20 @@ gr_win32_surface_listen_event( grWin32Surface*  surface,
   MSG     msg;
   HANDLE  window = surface->window;
 
-  event_mask=event_mask;  /* unused parameter */
-
-  while (GetMessage( &msg, NULL, 0, 0 ) > 0)
+  for (;;)
   {
+    /* the caller is still busy; don't block */
+    if ( event_mask == gr_event_poll                  &&
+         !PeekMessage( &msg, NULL, 0, 0, PM_NOREMOVE ) )
+    {
+      grevent->type = gr_event_none;
+      grevent->key  = grKeyNone;
+      return;
+    }
+
+    if ( GetMessage( &msg, NULL, 0, 0 ) <= 0 )
+      break;
+
     switch ( msg.message )
     {
     case WM_RESIZE:
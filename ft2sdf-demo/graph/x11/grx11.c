@@ -50,6 +50,15 @@
 #include <X11/cursorfont.h>
 #include <X11/keysym.h>
 
+  /* define GR_X11_NO_SHM (`make X11_NO_SHM=1') to build without */
+  /* shared-memory images                                        */
+#ifndef GR_X11_NO_SHM
+#define GR_X11_SHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#endif
+
 #include "grx11.h"
 
 
@@ -229,6 +238,16 @@ typedef  unsigned long   uint32;
 
   typedef void  (*grX11ConvertFunc)( grX11Blitter*  blit );
 
+
+  static int
+  gr_x11_host_byte_order( void )
+  {
+    static const uint32  one = 1;
+
+
+    return *(const unsigned char*)&one ? LSBFirst : MSBFirst;
+  }
+
   typedef struct grX11FormatRec_
   {
     int             x_depth;
@@ -868,6 +887,9 @@ typedef  unsigned long   uint32;
   };
 
 
+#include "grx11simd.h"
+
+
   /************************************************************************/
   /************************************************************************/
   /*****                                                              *****/
@@ -899,6 +921,8 @@ typedef  unsigned long   uint32;
     const grX11Format*  format;
     int                 scanline_pad;
     Visual*             visual;
+    int                 shm;             /* MIT-SHM is available */
+    int                 shm_completion;  /* its completion event */
 
   } grX11Device;
 
@@ -938,6 +962,19 @@ typedef  unsigned long   uint32;
     x11dev.busy = XCreateFontCursor( x11dev.display, XC_watch );
     x11dev.scanline_pad = BitmapPad( x11dev.display );
 
+#ifdef GR_X11_SHM
+    /* whether the server can really attach our segments (not over */
+    /* a remote connection) only shows when the first image does   */
+    if ( XShmQueryExtension( x11dev.display ) )
+    {
+      x11dev.shm            = 1;
+      x11dev.shm_completion = XShmGetEventBase( x11dev.display ) +
+                              ShmCompletion;
+    }
+
+    LOG(( "MIT-SHM: %s\n", x11dev.shm ? "yes" : "no" ));
+#endif
+
     LOG(( "Display: BitmapUnit = %d, BitmapPad = %d, ByteOrder = %s\n",
           BitmapUnit( x11dev.display ), BitmapPad( x11dev.display ),
           ImageByteOrder( x11dev.display ) == LSBFirst ? "LSBFirst"
@@ -1029,6 +1066,13 @@ typedef  unsigned long   uint32;
 
     XImage*             ximage;
     grX11ConvertFunc    convert;
+    int                 direct;   /* the image shares the bitmap buffer */
+
+#ifdef GR_X11_SHM
+    int                 shm;          /* the image is in shared memory */
+    int                 shm_pending;  /* puts not yet completed        */
+    XShmSegmentInfo     shm_info;
+#endif
 
     char                key_buffer[10];
     int                 key_cursor;
@@ -1037,6 +1081,132 @@ typedef  unsigned long   uint32;
   } grX11Surface;
 
 
+#ifdef GR_X11_SHM
+
+  static int  gr_x11_shm_error;
+
+
+  static int
+  gr_x11_shm_error_handler( Display*      display,
+                            XErrorEvent*  event )
+  {
+    (void)display;
+    (void)event;
+
+    gr_x11_shm_error = 1;
+
+    return 0;
+  }
+
+
+  /* create an image in a new shared-memory segment; */
+  /* returns NULL if the server cannot attach it      */
+  static XImage*
+  gr_x11_shm_image_new( Display*          display,
+                        Visual*           visual,
+                        XShmSegmentInfo*  info,
+                        int               width,
+                        int               height )
+  {
+    XImage*        image;
+    XErrorHandler  handler;
+
+
+    image = XShmCreateImage( display,
+                             visual,
+                             (unsigned int)x11dev.format->x_depth,
+                             ZPixmap,
+                             NULL,
+                             info,
+                             (unsigned int)width,
+                             (unsigned int)height );
+    if ( !image )
+      return NULL;
+
+    info->shmid = shmget( IPC_PRIVATE,
+                          (size_t)image->bytes_per_line *
+                            (size_t)( height > 0 ? height : 1 ),
+                          IPC_CREAT | 0600 );
+    if ( info->shmid < 0 )
+      goto Fail_Image;
+
+    info->shmaddr = (char*)shmat( info->shmid, NULL, 0 );
+    if ( info->shmaddr == (char*)-1 )
+    {
+      shmctl( info->shmid, IPC_RMID, NULL );
+      goto Fail_Image;
+    }
+
+    image->data    = info->shmaddr;
+    info->readOnly = False;
+
+    /* a remote server fails here, asynchronously */
+    gr_x11_shm_error = 0;
+    handler          = XSetErrorHandler( gr_x11_shm_error_handler );
+
+    XShmAttach( display, info );
+    XSync( display, False );
+
+    XSetErrorHandler( handler );
+
+    /* the segment goes away with its last attachment */
+    shmctl( info->shmid, IPC_RMID, NULL );
+
+    if ( gr_x11_shm_error )
+    {
+      LOG(( "MIT-SHM: cannot attach, using plain images\n" ));
+
+      x11dev.shm = 0;
+      shmdt( info->shmaddr );
+      goto Fail_Image;
+    }
+
+    return image;
+
+  Fail_Image:
+    image->data = NULL;
+    XDestroyImage( image );
+    return NULL;
+  }
+
+
+  static void
+  gr_x11_shm_image_done( Display*          display,
+                         XImage*           image,
+                         XShmSegmentInfo*  info )
+  {
+    XShmDetach( display, info );
+    XDestroyImage( image );
+    shmdt( info->shmaddr );
+  }
+
+
+  static Bool
+  gr_x11_shm_completed( Display*  display,
+                        XEvent*   event,
+                        XPointer  arg )
+  {
+    (void)display;
+    (void)arg;
+
+    return event->type == x11dev.shm_completion;
+  }
+
+
+  /* wait until the server has read the image */
+  static void
+  gr_x11_surface_shm_wait( grX11Surface*  surface )
+  {
+    XEvent  x_event;
+
+
+    for ( ; surface->shm_pending > 0; surface->shm_pending-- )
+      XIfEvent( surface->display, &x_event, gr_x11_shm_completed, NULL );
+  }
+
+#endif /* GR_X11_SHM */
+
+
   /* close a given window */
   static void
   gr_x11_surface_done( grX11Surface*  surface )
@@ -1050,7 +1220,16 @@ typedef  unsigned long   uint32;
 
       if ( surface->ximage )
       {
-        XDestroyImage( surface->ximage );
+#ifdef GR_X11_SHM
+        if ( surface->shm )
+        {
+          gr_x11_surface_shm_wait( surface );
+          gr_x11_shm_image_done( display, surface->ximage,
+                                 &surface->shm_info );
+        }
+        else
+#endif
+          XDestroyImage( surface->ximage );
         surface->ximage = 0;
       }
 
@@ -1063,6 +1242,14 @@ typedef  unsigned long   uint32;
   }
 
 
+  /* nothing to convert when the image shares the bitmap buffer */
+  static void
+  gr_x11_convert_none( grX11Blitter*  blit )
+  {
+    (void)blit;
+  }
+
+
   static void
   gr_x11_surface_refresh_rect( grX11Surface*  surface,
                                int            x,
@@ -1076,6 +1263,11 @@ typedef  unsigned long   uint32;
     if ( !gr_x11_blitter_reset( &blit, &surface->root.bitmap, surface->ximage,
                                 x, y, w, h ) )
     {
+#ifdef GR_X11_SHM
+      /* don't overwrite the image while the server reads it */
+      gr_x11_surface_shm_wait( surface );
+#endif
+
       surface->convert( &blit );
 
       /* without background defined, this only generates Expose event */
@@ -1137,6 +1329,58 @@ typedef  unsigned long   uint32;
                       bitmap ) )
       return 0;
 
+    if ( surface->direct )
+    {
+      ximage->data           = (char*)bitmap->buffer;
+      ximage->bytes_per_line = bitmap->pitch;
+      ximage->width          = width;
+      ximage->height         = height;
+
+      return 1;
+    }
+
+#ifdef GR_X11_SHM
+    if ( surface->shm )
+    {
+      XShmSegmentInfo  info;
+      XImage*          image;
+
+
+      image = gr_x11_shm_image_new( surface->display, surface->visual,
+                                    &info, width, height );
+      if ( !image )
+      {
+        /* fall back to a plain image, allocated below */
+        image = XCreateImage( surface->display,
+                              surface->visual,
+                              (unsigned int)x11dev.format->x_depth,
+                              ZPixmap,
+                              0,
+                              NULL,
+                              (unsigned int)width,
+                              (unsigned int)height,
+                              x11dev.scanline_pad,
+                              0 );
+        if ( !image )
+          return 0;
+      }
+
+      gr_x11_surface_shm_wait( surface );
+      gr_x11_shm_image_done( surface->display, ximage,
+                             &surface->shm_info );
+
+      surface->ximage = ximage = image;
+
+      if ( ximage->data )
+      {
+        surface->shm_info = info;
+        return 1;
+      }
+
+      surface->shm = 0;
+    }
+#endif
+
     /* reallocate surface image */
     pitch  = width * ximage->bits_per_pixel >> 3;
 
@@ -1175,9 +1419,8 @@ typedef  unsigned long   uint32;
     int           num;
     grKey         grkey;
 
-    /* XXX: for now, ignore the event mask, and only exit when */
-    /*      a key is pressed                                   */
-    (void)event_mask;
+    /* XXX: for now, the event mask is only checked for polling; */
+    /*      otherwise, only exit when a key is pressed            */
 
     /* reset exposed area */
     exposed.x = exposed.y = exposed.width = exposed.height = 0;
@@ -1186,8 +1429,28 @@ typedef  unsigned long   uint32;
 
     while ( surface->key_cursor >= surface->key_number )
     {
+      /* the caller is still busy; don't block */
+      if ( event_mask == gr_event_poll && !XPending( display ) )
+      {
+        XDefineCursor( display, surface->win, x11dev.busy );
+
+        grevent->type = gr_event_none;
+        grevent->key  = grKeyNone;
+
+        return 0;
+      }
+
       XNextEvent( display, &x_event );
 
+#ifdef GR_X11_SHM
+      if ( x_event.type == x11dev.shm_completion &&
+           surface->shm_pending > 0              )
+      {
+        surface->shm_pending--;
+        continue;
+      }
+#endif
+
       switch ( x_event.type )
       {
       case ClientMessage:
@@ -1261,16 +1524,35 @@ typedef  unsigned long   uint32;
              x_event.xexpose.y + x_event.xexpose.height
                    > exposed.y +         exposed.height )
         {
-          XPutImage( surface->display,
-                     surface->win,
-                     surface->gc,
-                     surface->ximage,
-                     x_event.xexpose.x,
-                     x_event.xexpose.y,
-                     x_event.xexpose.x,
-                     x_event.xexpose.y,
-                     (unsigned int)x_event.xexpose.width,
-                     (unsigned int)x_event.xexpose.height );
+#ifdef GR_X11_SHM
+          if ( surface->shm )
+          {
+            /* the server reads the image in place and reports back */
+            XShmPutImage( surface->display,
+                          surface->win,
+                          surface->gc,
+                          surface->ximage,
+                          x_event.xexpose.x,
+                          x_event.xexpose.y,
+                          x_event.xexpose.x,
+                          x_event.xexpose.y,
+                          (unsigned int)x_event.xexpose.width,
+                          (unsigned int)x_event.xexpose.height,
+                          True );
+            surface->shm_pending++;
+          }
+          else
+#endif
+            XPutImage( surface->display,
+                       surface->win,
+                       surface->gc,
+                       surface->ximage,
+                       x_event.xexpose.x,
+                       x_event.xexpose.y,
+                       x_event.xexpose.x,
+                       x_event.xexpose.y,
+                       (unsigned int)x_event.xexpose.width,
+                       (unsigned int)x_event.xexpose.height );
 
           exposed = x_event.xexpose;
           LOG(( "painted\n" ));
@@ -1311,18 +1593,33 @@ typedef  unsigned long   uint32;
     surface->key_cursor = 0;
     surface->display    = display = x11dev.display;
     surface->visual     = x11dev.visual;
+    surface->direct     = 0;
 
     switch ( bitmap->mode )
     {
     case gr_pixel_mode_rgb24:
-      surface->convert = x11dev.format->rgb_convert;
+      surface->convert = gr_x11_convert_select(
+                           x11dev.format->rgb_convert );
       break;
 
+    case gr_pixel_mode_rgb32:
+      /* only if this is the server's own pixel layout, so that the */
+      /* image can use the bitmap buffer as is (Xlib swaps the bytes */
+      /* if needed)                                                  */
+      if ( x11dev.format == &gr_x11_format_rgb0888 )
+      {
+        surface->convert = gr_x11_convert_none;
+        surface->direct  = 1;
+        break;
+      }
+      return 0;
+
     case gr_pixel_mode_gray:
       /* we only support 256-gray level 8-bit pixmaps */
       if ( bitmap->grays == 256 )
       {
-        surface->convert = x11dev.format->gray_convert;
+        surface->convert = gr_x11_convert_select(
+                             x11dev.format->gray_convert );
         break;
       }
       /* fall through */
@@ -1342,25 +1639,54 @@ typedef  unsigned long   uint32;
 
     surface->root.bitmap = *bitmap;
 
-    /* Now create the surface X11 image */
-    surface->ximage = XCreateImage( display,
-                                    surface->visual,
-                                    (unsigned int)x11dev.format->x_depth,
-                                    ZPixmap,
-                                    0,
-                                    NULL,
-                                    (unsigned int)bitmap->width,
-                                    (unsigned int)bitmap->rows,
-                                    x11dev.scanline_pad,
-                                    0 );
-    if ( !surface->ximage )
-      return 0;
+    /* Now create the surface X11 image, in shared memory if possible; */
+    /* a direct image must keep the bitmap buffer                      */
+#ifdef GR_X11_SHM
+    surface->shm         = 0;
+    surface->shm_pending = 0;
 
-    /* allocate surface image data */
-    surface->ximage->data = (char*)grAlloc( (size_t)bitmap->rows *
-                         (size_t)surface->ximage->bytes_per_line );
-    if ( !surface->ximage->data )
-      return 0;
+    if ( x11dev.shm && !surface->direct )
+    {
+      surface->ximage = gr_x11_shm_image_new( display,
+                                              surface->visual,
+                                              &surface->shm_info,
+                                              bitmap->width,
+                                              bitmap->rows );
+      if ( surface->ximage )
+        surface->shm = 1;
+    }
+
+    if ( !surface->shm )
+#endif
+    {
+      surface->ximage = XCreateImage( display,
+                                      surface->visual,
+                                      (unsigned int)x11dev.format->x_depth,
+                                      ZPixmap,
+                                      0,
+                                      NULL,
+                                      (unsigned int)bitmap->width,
+                                      (unsigned int)bitmap->rows,
+                                      x11dev.scanline_pad,
+                                      surface->direct ? bitmap->pitch : 0 );
+      if ( !surface->ximage )
+        return 0;
+
+      if ( surface->direct )
+      {
+        /* the bitmap holds 0xAARRGGBB words in host byte order */
+        surface->ximage->data       = (char*)bitmap->buffer;
+        surface->ximage->byte_order = gr_x11_host_byte_order();
+      }
+      else
+      {
+        /* allocate surface image data */
+        surface->ximage->data = (char*)grAlloc( (size_t)bitmap->rows *
+                             (size_t)surface->ximage->bytes_per_line );
+        if ( !surface->ximage->data )
+          return 0;
+      }
+    }
 
     {
       int                   screen = DefaultScreen( display );
@@ -0,0 +1,754 @@
+/*******************************************************************
+ *
+ *  grx11simd.h  SSSE3 and AVX2 pixel converters for the X11 driver.
+ *
+ *  This file is included by grx11.c after the generic converters,
+ *  which it replaces at runtime when the processor supports it.
+ *
+ *  Copyright (C) 2020 by
+ *  Antoine Leca, David Turner, Robert Wilhelm, and Werner Lemberg.
+ *
+ *  This file is part of the FreeType project, and may only be used
+ *  modified and distributed under the terms of the FreeType project
+ *  license, LICENSE.TXT. By continuing to use, modify or distribute
+ *  this file you indicate that you have read the license and
+ *  understand and accept it fully.
+ *
+ ******************************************************************/
+
+  /*
+   * All converters move bytes around with `pshufb': the source bytes of
+   * a few pixels are shuffled into the target layout, and the 16-bit
+   * formats are then packed with shifts and masks.  The output is that
+   * of the generic converters, byte for byte.  The remaining pixels of
+   * each line go through a scalar loop driven by the same parameters.
+   *
+   * The AVX2 kernels run the same shuffles in both 128-bit lanes.  The
+   * 24-bit formats, whose pixels straddle the lanes, keep the SSSE3
+   * kernels there.
+   *
+   * Set the environment variable `GR_X11_CONVERT' to `generic' or
+   * `SSSE3' to compare the output against a slower kernel.
+   */
+
+#if ( defined __GNUC__ || defined __clang__ )  && \
+    ( defined __x86_64__ || defined __i386__ )
+
+#define GR_X11_SIMD
+
+#include <immintrin.h>
+
+
+#define GR_X11_SSSE3  __attribute__(( target( "ssse3" ) ))
+#define GR_X11_AVX2   __attribute__(( target( "avx2" ) ))
+
+#define GR_X11_INLINE_SSSE3  \
+          static __inline__ __attribute__(( always_inline, target( "ssse3" ) ))
+#define GR_X11_INLINE_AVX2   \
+          static __inline__ __attribute__(( always_inline, target( "avx2" ) ))
+
+  /* load two unaligned 128-bit vectors into the lanes of one */
+#define GR_X11_LOAD2( lo, hi )                                          \
+          _mm256_inserti128_si256(                                      \
+            _mm256_castsi128_si256(                                     \
+              _mm_loadu_si128( (const __m128i*)(lo) ) ),                \
+            _mm_loadu_si128( (const __m128i*)(hi) ), 1 )
+
+#define GR_X11_JOIN2( lo, hi )                                          \
+          _mm256_inserti128_si256( _mm256_castsi128_si256( lo ), hi, 1 )
+
+
+  /************************************************************************/
+  /*                                                                      */
+  /*  32-bit targets: byte `k' of a target pixel is byte `c<k>' of its    */
+  /*  source pixel of `bpp' bytes, or zero if `c<k>' is negative.         */
+  /*                                                                      */
+  /************************************************************************/
+
+  /* shuffle control for 4 target pixels, the first one at `offset' */
+  GR_X11_INLINE_SSSE3 __m128i
+  gr_x11_simd_ctrl_32( int  bpp,
+                       int  offset,
+                       int  c0,
+                       int  c1,
+                       int  c2,
+                       int  c3 )
+  {
+    signed char  ctrl[16];
+    int          i;
+
+
+    for ( i = 0; i < 4; i++ )
+    {
+      int  o = offset + i * bpp;
+
+
+      ctrl[4 * i    ] = (signed char)( c0 < 0 ? -128 : o + c0 );
+      ctrl[4 * i + 1] = (signed char)( c1 < 0 ? -128 : o + c1 );
+      ctrl[4 * i + 2] = (signed char)( c2 < 0 ? -128 : o + c2 );
+      ctrl[4 * i + 3] = (signed char)( c3 < 0 ? -128 : o + c3 );
+    }
+
+    return _mm_loadu_si128( (const __m128i*)ctrl );
+  }
+
+
+  static __inline__ void
+  gr_x11_simd_tail_32( const unsigned char*  lread,
+                       unsigned char*        lwrite,
+                       int                   x,
+                       int                   bpp,
+                       int                   c0,
+                       int                   c1,
+                       int                   c2,
+                       int                   c3 )
+  {
+    for ( ; x > 0; x--, lread += bpp, lwrite += 4 )
+    {
+      lwrite[0] = c0 < 0 ? 0 : lread[c0];
+      lwrite[1] = c1 < 0 ? 0 : lread[c1];
+      lwrite[2] = c2 < 0 ? 0 : lread[c2];
+      lwrite[3] = c3 < 0 ? 0 : lread[c3];
+    }
+  }
+
+
+  GR_X11_INLINE_SSSE3 void
+  gr_x11_simd_to_32_ssse3( grX11Blitter*  blit,
+                           int            bpp,
+                           int            c0,
+                           int            c1,
+                           int            c2,
+                           int            c3 )
+  {
+    unsigned char*  line_read  = blit->src_line + blit->x * bpp;
+    unsigned char*  line_write = blit->dst_line + blit->x * 4;
+    int             h          = blit->height;
+
+    /* with 3 bytes per pixel, the second load of 8 pixels starts 4 */
+    /* bytes before its pixels, so that no load reads past the line */
+    __m128i  ctrl0 = gr_x11_simd_ctrl_32( bpp, 0, c0, c1, c2, c3 );
+    __m128i  ctrl1 = gr_x11_simd_ctrl_32( bpp, 4, c0, c1, c2, c3 );
+    __m128i  ctrl2 = gr_x11_simd_ctrl_32( bpp, 8, c0, c1, c2, c3 );
+    __m128i  ctrl3 = gr_x11_simd_ctrl_32( bpp, 12, c0, c1, c2, c3 );
+
+
+    for ( ; h > 0; h-- )
+    {
+      unsigned char*  lread  = line_read;
+      unsigned char*  lwrite = line_write;
+      int             x      = blit->width;
+
+
+      if ( bpp == 3 )
+      {
+        for ( ; x >= 8; x -= 8, lread += 24, lwrite += 32 )
+        {
+          __m128i  a = _mm_loadu_si128( (const __m128i*)lread );
+          __m128i  b = _mm_loadu_si128( (const __m128i*)( lread + 8 ) );
+
+
+          _mm_storeu_si128( (__m128i*)lwrite,
+                            _mm_shuffle_epi8( a, ctrl0 ) );
+          _mm_storeu_si128( (__m128i*)( lwrite + 16 ),
+                            _mm_shuffle_epi8( b, ctrl1 ) );
+        }
+      }
+      else
+      {
+        for ( ; x >= 16; x -= 16, lread += 16, lwrite += 64 )
+        {
+          __m128i  p = _mm_loadu_si128( (const __m128i*)lread );
+
+
+          _mm_storeu_si128( (__m128i*)lwrite,
+                            _mm_shuffle_epi8( p, ctrl0 ) );
+          _mm_storeu_si128( (__m128i*)( lwrite + 16 ),
+                            _mm_shuffle_epi8( p, ctrl1 ) );
+          _mm_storeu_si128( (__m128i*)( lwrite + 32 ),
+                            _mm_shuffle_epi8( p, ctrl2 ) );
+          _mm_storeu_si128( (__m128i*)( lwrite + 48 ),
+                            _mm_shuffle_epi8( p, ctrl3 ) );
+        }
+      }
+
+      gr_x11_simd_tail_32( lread, lwrite, x, bpp, c0, c1, c2, c3 );
+
+      line_read  += blit->src_pitch;
+      line_write += blit->dst_pitch;
+    }
+  }
+
+
+  GR_X11_INLINE_AVX2 void
+  gr_x11_simd_to_32_avx2( grX11Blitter*  blit,
+                          int            bpp,
+                          int            c0,
+                          int            c1,
+                          int            c2,
+                          int            c3 )
+  {
+    unsigned char*  line_read  = blit->src_line + blit->x * bpp;
+    unsigned char*  line_write = blit->dst_line + blit->x * 4;
+    int             h          = blit->height;
+
+    __m256i  ctrl0, ctrl1;
+
+
+    if ( bpp == 3 )
+    {
+      /* the same layout as the SSSE3 kernel, 8 pixels per vector */
+      ctrl0 = GR_X11_JOIN2( gr_x11_simd_ctrl_32( 3, 0, c0, c1, c2, c3 ),
+                            gr_x11_simd_ctrl_32( 3, 4, c0, c1, c2, c3 ) );
+      ctrl1 = ctrl0;
+    }
+    else
+    {
+      /* both lanes hold the same 16 source pixels */
+      ctrl0 = GR_X11_JOIN2( gr_x11_simd_ctrl_32( 1, 0, c0, c1, c2, c3 ),
+                            gr_x11_simd_ctrl_32( 1, 4, c0, c1, c2, c3 ) );
+      ctrl1 = GR_X11_JOIN2( gr_x11_simd_ctrl_32( 1, 8, c0, c1, c2, c3 ),
+                            gr_x11_simd_ctrl_32( 1, 12, c0, c1, c2, c3 ) );
+    }
+
+    for ( ; h > 0; h-- )
+    {
+      unsigned char*  lread  = line_read;
+      unsigned char*  lwrite = line_write;
+      int             x      = blit->width;
+
+
+      for ( ; x >= 16; x -= 16, lread += 16 * bpp, lwrite += 64 )
+      {
+        __m256i  a, b;
+
+
+        if ( bpp == 3 )
+        {
+          a = GR_X11_LOAD2( lread, lread + 8 );
+          b = GR_X11_LOAD2( lread + 24, lread + 32 );
+        }
+        else
+        {
+          a = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128( (const __m128i*)lread ) );
+          b = a;
+        }
+
+        _mm256_storeu_si256( (__m256i*)lwrite,
+                             _mm256_shuffle_epi8( a, ctrl0 ) );
+        _mm256_storeu_si256( (__m256i*)( lwrite + 32 ),
+                             _mm256_shuffle_epi8( b, ctrl1 ) );
+      }
+
+      gr_x11_simd_tail_32( lread, lwrite, x, bpp, c0, c1, c2, c3 );
+
+      line_read  += blit->src_pitch;
+      line_write += blit->dst_pitch;
+    }
+  }
+
+
+  /************************************************************************/
+  /*                                                                      */
+  /*  16-bit targets: the source bytes `cr', `cg', and `cb' give the      */
+  /*  high, middle, and low fields, which are masked with `rm' and `gm'   */
+  /*  after a left shift by `rs' and `gs'; the low field is `cb >> 3'.    */
+  /*                                                                      */
+  /************************************************************************/
+
+  /* shuffle control for 4 pixels of 3 bytes, the first one at */
+  /* `offset'; it zero-extends byte `lo' into the lower 64 bits */
+  /* and byte `hi' into the upper ones                          */
+  GR_X11_INLINE_SSSE3 __m128i
+  gr_x11_simd_ctrl_16( int  offset,
+                       int  lo,
+                       int  hi )
+  {
+    signed char  ctrl[16];
+    int          i;
+
+
+    for ( i = 0; i < 4; i++ )
+    {
+      int  o = offset + i * 3;
+
+
+      ctrl[2 * i    ] = (signed char)( o + lo );
+      ctrl[2 * i + 1] = -128;
+      ctrl[2 * i + 8] = (signed char)( hi < 0 ? -128 : o + hi );
+      ctrl[2 * i + 9] = -128;
+    }
+
+    return _mm_loadu_si128( (const __m128i*)ctrl );
+  }
+
+
+#define GR_X11_PACK16( pfx, sfx, r, g, b )                              \
+          pfx ## or_ ## sfx(                                            \
+            pfx ## or_ ## sfx(                                          \
+              pfx ## and_ ## sfx( pfx ## slli_epi16( r, rs ), rmask ),  \
+              pfx ## and_ ## sfx( pfx ## slli_epi16( g, gs ), gmask ) ),\
+            pfx ## srli_epi16( b, 3 ) )
+
+
+  static __inline__ void
+  gr_x11_simd_tail_16( const unsigned char*  lread,
+                       unsigned char*        lwrite,
+                       int                   x,
+                       int                   bpp,
+                       int                   cr,
+                       int                   cg,
+                       int                   cb,
+                       int                   rs,
+                       unsigned int          rm,
+                       int                   gs,
+                       unsigned int          gm )
+  {
+    unsigned short*  lw = (unsigned short*)lwrite;
+
+
+    for ( ; x > 0; x--, lread += bpp, lw++ )
+    {
+      unsigned int  r = lread[cr];
+      unsigned int  g = lread[cg];
+      unsigned int  b = lread[cb];
+
+
+      lw[0] = (unsigned short)( ( ( r << rs ) & rm ) |
+                                ( ( g << gs ) & gm ) |
+                                ( b >> 3 )           );
+    }
+  }
+
+
+  GR_X11_INLINE_SSSE3 void
+  gr_x11_simd_to_16_ssse3( grX11Blitter*  blit,
+                           int            bpp,
+                           int            cr,
+                           int            cg,
+                           int            cb,
+                           int            rs,
+                           unsigned int   rm,
+                           int            gs,
+                           unsigned int   gm )
+  {
+    unsigned char*  line_read  = blit->src_line + blit->x * bpp;
+    unsigned char*  line_write = blit->dst_line + blit->x * 2;
+    int             h          = blit->height;
+
+    __m128i  rmask = _mm_set1_epi16( (short)rm );
+    __m128i  gmask = _mm_set1_epi16( (short)gm );
+    __m128i  zero  = _mm_setzero_si128();
+
+    /* as above, the second load of 8 pixels starts 4 bytes early */
+    __m128i  rg0 = gr_x11_simd_ctrl_16( 0, cr, cg );
+    __m128i  rg1 = gr_x11_simd_ctrl_16( 4, cr, cg );
+    __m128i  b0  = gr_x11_simd_ctrl_16( 0, cb, -1 );
+    __m128i  b1  = gr_x11_simd_ctrl_16( 4, cb, -1 );
+
+
+    for ( ; h > 0; h-- )
+    {
+      unsigned char*  lread  = line_read;
+      unsigned char*  lwrite = line_write;
+      int             x      = blit->width;
+
+
+      if ( bpp == 3 )
+      {
+        for ( ; x >= 8; x -= 8, lread += 24, lwrite += 16 )
+        {
+          __m128i  s0 = _mm_loadu_si128( (const __m128i*)lread );
+          __m128i  s1 = _mm_loadu_si128( (const __m128i*)( lread + 8 ) );
+          __m128i  t0 = _mm_shuffle_epi8( s0, rg0 );
+          __m128i  t1 = _mm_shuffle_epi8( s1, rg1 );
+          __m128i  r  = _mm_unpacklo_epi64( t0, t1 );
+          __m128i  g  = _mm_unpackhi_epi64( t0, t1 );
+          __m128i  b  = _mm_unpacklo_epi64( _mm_shuffle_epi8( s0, b0 ),
+                                            _mm_shuffle_epi8( s1, b1 ) );
+
+
+          _mm_storeu_si128( (__m128i*)lwrite,
+                            GR_X11_PACK16( _mm_, si128, r, g, b ) );
+        }
+      }
+      else
+      {
+        for ( ; x >= 16; x -= 16, lread += 16, lwrite += 32 )
+        {
+          __m128i  p  = _mm_loadu_si128( (const __m128i*)lread );
+          __m128i  lo = _mm_unpacklo_epi8( p, zero );
+          __m128i  hi = _mm_unpackhi_epi8( p, zero );
+
+
+          _mm_storeu_si128( (__m128i*)lwrite,
+                            GR_X11_PACK16( _mm_, si128, lo, lo, lo ) );
+          _mm_storeu_si128( (__m128i*)( lwrite + 16 ),
+                            GR_X11_PACK16( _mm_, si128, hi, hi, hi ) );
+        }
+      }
+
+      gr_x11_simd_tail_16( lread, lwrite, x, bpp, cr, cg, cb,
+                           rs, rm, gs, gm );
+
+      line_read  += blit->src_pitch;
+      line_write += blit->dst_pitch;
+    }
+  }
+
+
+  GR_X11_INLINE_AVX2 void
+  gr_x11_simd_to_16_avx2( grX11Blitter*  blit,
+                          int            bpp,
+                          int            cr,
+                          int            cg,
+                          int            cb,
+                          int            rs,
+                          unsigned int   rm,
+                          int            gs,
+                          unsigned int   gm )
+  {
+    unsigned char*  line_read  = blit->src_line + blit->x * bpp;
+    unsigned char*  line_write = blit->dst_line + blit->x * 2;
+    int             h          = blit->height;
+
+    __m256i  rmask = _mm256_set1_epi16( (short)rm );
+    __m256i  gmask = _mm256_set1_epi16( (short)gm );
+
+    /* each lane converts 8 pixels as in the SSSE3 kernel */
+    __m256i  rg0 = _mm256_broadcastsi128_si256(
+                     gr_x11_simd_ctrl_16( 0, cr, cg ) );
+    __m256i  rg1 = _mm256_broadcastsi128_si256(
+                     gr_x11_simd_ctrl_16( 4, cr, cg ) );
+    __m256i  b0  = _mm256_broadcastsi128_si256(
+                     gr_x11_simd_ctrl_16( 0, cb, -1 ) );
+    __m256i  b1  = _mm256_broadcastsi128_si256(
+                     gr_x11_simd_ctrl_16( 4, cb, -1 ) );
+
+
+    for ( ; h > 0; h-- )
+    {
+      unsigned char*  lread  = line_read;
+      unsigned char*  lwrite = line_write;
+      int             x      = blit->width;
+
+
+      for ( ; x >= 16; x -= 16, lread += 16 * bpp, lwrite += 32 )
+      {
+        __m256i  r, g, b;
+
+
+        if ( bpp == 3 )
+        {
+          __m256i  s0 = GR_X11_LOAD2( lread, lread + 24 );
+          __m256i  s1 = GR_X11_LOAD2( lread + 8, lread + 32 );
+          __m256i  t0 = _mm256_shuffle_epi8( s0, rg0 );
+          __m256i  t1 = _mm256_shuffle_epi8( s1, rg1 );
+
+
+          r = _mm256_unpacklo_epi64( t0, t1 );
+          g = _mm256_unpackhi_epi64( t0, t1 );
+          b = _mm256_unpacklo_epi64( _mm256_shuffle_epi8( s0, b0 ),
+                                     _mm256_shuffle_epi8( s1, b1 ) );
+        }
+        else
+        {
+          r = _mm256_cvtepu8_epi16(
+                _mm_loadu_si128( (const __m128i*)lread ) );
+          g = r;
+          b = r;
+        }
+
+        _mm256_storeu_si256( (__m256i*)lwrite,
+                             GR_X11_PACK16( _mm256_, si256, r, g, b ) );
+      }
+
+      gr_x11_simd_tail_16( lread, lwrite, x, bpp, cr, cg, cb,
+                           rs, rm, gs, gm );
+
+      line_read  += blit->src_pitch;
+      line_write += blit->dst_pitch;
+    }
+  }
+
+
+  /************************************************************************/
+  /*                                                                      */
+  /*  24-bit targets                                                      */
+  /*                                                                      */
+  /************************************************************************/
+
+  static GR_X11_SSSE3 void
+  gr_x11_convert_rgb_to_bgr888_ssse3( grX11Blitter*  blit )
+  {
+    unsigned char*  line_read  = blit->src_line + blit->x * 3;
+    unsigned char*  line_write = blit->dst_line + blit->x * 3;
+    int             h          = blit->height;
+
+    __m128i  ctrl = _mm_setr_epi8( 2, 1, 0, 5, 4, 3, 8, 7,
+                                   6, 11, 10, 9, 14, 13, 12, 15 );
+
+
+    for ( ; h > 0; h-- )
+    {
+      unsigned char*  lread  = line_read;
+      unsigned char*  lwrite = line_write;
+      int             x      = blit->width;
+
+
+      /* swap 5 pixels per step; the last byte of each store gets */
+      /* overwritten by the next step, and there is always a next */
+      /* pixel to overwrite it                                    */
+      for ( ; x >= 6; x -= 5, lread += 15, lwrite += 15 )
+        _mm_storeu_si128( (__m128i*)lwrite,
+                          _mm_shuffle_epi8(
+                            _mm_loadu_si128( (const __m128i*)lread ),
+                            ctrl ) );
+
+      for ( ; x > 0; x--, lread += 3, lwrite += 3 )
+      {
+        lwrite[0] = lread[2];
+        lwrite[1] = lread[1];
+        lwrite[2] = lread[0];
+      }
+
+      line_read  += blit->src_pitch;
+      line_write += blit->dst_pitch;
+    }
+  }
+
+
+  static GR_X11_SSSE3 void
+  gr_x11_convert_gray_to_rgb888_ssse3( grX11Blitter*  blit )
+  {
+    unsigned char*  line_read  = blit->src_line + blit->x;
+    unsigned char*  line_write = blit->dst_line + blit->x * 3;
+    int             h          = blit->height;
+
+    /* 16 pixels fill 3 vectors, byte `j' of which is pixel `j / 3' */
+    __m128i  ctrl0 = _mm_setr_epi8(  0,  0,  0,  1,  1,  1,  2,  2,
+                                     2,  3,  3,  3,  4,  4,  4,  5 );
+    __m128i  ctrl1 = _mm_setr_epi8(  5,  5,  6,  6,  6,  7,  7,  7,
+                                     8,  8,  8,  9,  9,  9, 10, 10 );
+    __m128i  ctrl2 = _mm_setr_epi8( 10, 11, 11, 11, 12, 12, 12, 13,
+                                    13, 13, 14, 14, 14, 15, 15, 15 );
+
+
+    for ( ; h > 0; h-- )
+    {
+      unsigned char*  lread  = line_read;
+      unsigned char*  lwrite = line_write;
+      int             x      = blit->width;
+
+
+      for ( ; x >= 16; x -= 16, lread += 16, lwrite += 48 )
+      {
+        __m128i  p = _mm_loadu_si128( (const __m128i*)lread );
+
+
+        _mm_storeu_si128( (__m128i*)lwrite,
+                          _mm_shuffle_epi8( p, ctrl0 ) );
+        _mm_storeu_si128( (__m128i*)( lwrite + 16 ),
+                          _mm_shuffle_epi8( p, ctrl1 ) );
+        _mm_storeu_si128( (__m128i*)( lwrite + 32 ),
+                          _mm_shuffle_epi8( p, ctrl2 ) );
+      }
+
+      for ( ; x > 0; x--, lread++, lwrite += 3 )
+      {
+        unsigned char  p = lread[0];
+
+
+        lwrite[0] = p;
+        lwrite[1] = p;
+        lwrite[2] = p;
+      }
+
+      line_read  += blit->src_pitch;
+      line_write += blit->dst_pitch;
+    }
+  }
+
+
+  /************************************************************************/
+  /*                                                                      */
+  /*  the converters                                                      */
+  /*                                                                      */
+  /************************************************************************/
+
+#define GR_X11_SIMD_CONVERT( name, kernel, args )             \
+  static GR_X11_SSSE3 void                                    \
+  name ## _ssse3( grX11Blitter*  blit )                       \
+  {                                                           \
+    kernel ## _ssse3 args;                                    \
+  }                                                           \
+                                                              \
+  static GR_X11_AVX2 void                                     \
+  name ## _avx2( grX11Blitter*  blit )                        \
+  {                                                           \
+    kernel ## _avx2 args;                                     \
+  }
+
+  GR_X11_SIMD_CONVERT( gr_x11_convert_rgb_to_rgb565,
+                       gr_x11_simd_to_16,
+                       ( blit, 3, 0, 1, 2, 8, 0xF800U, 3, 0x07E0 ) )
+  GR_X11_SIMD_CONVERT( gr_x11_convert_gray_to_rgb565,
+                       gr_x11_simd_to_16,
+                       ( blit, 1, 0, 0, 0, 8, 0xF800U, 3, 0x07E0 ) )
+  GR_X11_SIMD_CONVERT( gr_x11_convert_rgb_to_bgr565,
+                       gr_x11_simd_to_16,
+                       ( blit, 3, 2, 1, 0, 8, 0xF800U, 3, 0x07E0 ) )
+  GR_X11_SIMD_CONVERT( gr_x11_convert_rgb_to_rgb555,
+                       gr_x11_simd_to_16,
+                       ( blit, 3, 0, 1, 2, 7, 0x7C00, 2, 0x03E0 ) )
+  GR_X11_SIMD_CONVERT( gr_x11_convert_gray_to_rgb555,
+                       gr_x11_simd_to_16,
+                       ( blit, 1, 0, 0, 0, 7, 0x7C00, 2, 0x03E0 ) )
+  GR_X11_SIMD_CONVERT( gr_x11_convert_rgb_to_bgr555,
+                       gr_x11_simd_to_16,
+                       ( blit, 3, 2, 1, 0, 7, 0x7C00, 2, 0x03E0 ) )
+
+  /* the byte order of the pixels is LSBFirst on x86 */
+  GR_X11_SIMD_CONVERT( gr_x11_convert_rgb_to_rgb8880,
+                       gr_x11_simd_to_32,
+                       ( blit, 3, -1, 2, 1, 0 ) )
+  GR_X11_SIMD_CONVERT( gr_x11_convert_gray_to_rgb8880,
+                       gr_x11_simd_to_32,
+                       ( blit, 1, -1, 0, 0, 0 ) )
+  GR_X11_SIMD_CONVERT( gr_x11_convert_rgb_to_rgb0888,
+                       gr_x11_simd_to_32,
+                       ( blit, 3, 2, 1, 0, -1 ) )
+  GR_X11_SIMD_CONVERT( gr_x11_convert_gray_to_rgb0888,
+                       gr_x11_simd_to_32,
+                       ( blit, 1, 0, 0, 0, -1 ) )
+  GR_X11_SIMD_CONVERT( gr_x11_convert_rgb_to_bgr8880,
+                       gr_x11_simd_to_32,
+                       ( blit, 3, -1, 0, 1, 2 ) )
+  GR_X11_SIMD_CONVERT( gr_x11_convert_rgb_to_bgr0888,
+                       gr_x11_simd_to_32,
+                       ( blit, 3, 0, 1, 2, -1 ) )
+
+
+  /* the generic, SSSE3, and AVX2 converters; `rgb_to_rgb888' */
+  /* is a plain `memcpy' already                              */
+  static const grX11ConvertFunc  gr_x11_simd_converters[][3] =
+  {
+    { gr_x11_convert_rgb_to_rgb565,
+      gr_x11_convert_rgb_to_rgb565_ssse3,
+      gr_x11_convert_rgb_to_rgb565_avx2 },
+    { gr_x11_convert_gray_to_rgb565,
+      gr_x11_convert_gray_to_rgb565_ssse3,
+      gr_x11_convert_gray_to_rgb565_avx2 },
+    { gr_x11_convert_rgb_to_bgr565,
+      gr_x11_convert_rgb_to_bgr565_ssse3,
+      gr_x11_convert_rgb_to_bgr565_avx2 },
+    { gr_x11_convert_rgb_to_rgb555,
+      gr_x11_convert_rgb_to_rgb555_ssse3,
+      gr_x11_convert_rgb_to_rgb555_avx2 },
+    { gr_x11_convert_gray_to_rgb555,
+      gr_x11_convert_gray_to_rgb555_ssse3,
+      gr_x11_convert_gray_to_rgb555_avx2 },
+    { gr_x11_convert_rgb_to_bgr555,
+      gr_x11_convert_rgb_to_bgr555_ssse3,
+      gr_x11_convert_rgb_to_bgr555_avx2 },
+    { gr_x11_convert_gray_to_rgb888,
+      gr_x11_convert_gray_to_rgb888_ssse3,
+      gr_x11_convert_gray_to_rgb888_ssse3 },
+    { gr_x11_convert_rgb_to_bgr888,
+      gr_x11_convert_rgb_to_bgr888_ssse3,
+      gr_x11_convert_rgb_to_bgr888_ssse3 },
+    { gr_x11_convert_rgb_to_rgb8880,
+      gr_x11_convert_rgb_to_rgb8880_ssse3,
+      gr_x11_convert_rgb_to_rgb8880_avx2 },
+    { gr_x11_convert_gray_to_rgb8880,
+      gr_x11_convert_gray_to_rgb8880_ssse3,
+      gr_x11_convert_gray_to_rgb8880_avx2 },
+    { gr_x11_convert_rgb_to_rgb0888,
+      gr_x11_convert_rgb_to_rgb0888_ssse3,
+      gr_x11_convert_rgb_to_rgb0888_avx2 },
+    { gr_x11_convert_gray_to_rgb0888,
+      gr_x11_convert_gray_to_rgb0888_ssse3,
+      gr_x11_convert_gray_to_rgb0888_avx2 },
+    { gr_x11_convert_rgb_to_bgr8880,
+      gr_x11_convert_rgb_to_bgr8880_ssse3,
+      gr_x11_convert_rgb_to_bgr8880_avx2 },
+    { gr_x11_convert_rgb_to_bgr0888,
+      gr_x11_convert_rgb_to_bgr0888_ssse3,
+      gr_x11_convert_rgb_to_bgr0888_avx2 },
+    { NULL, NULL, NULL }
+  };
+
+
+  /* 0 for the generic converters, 1 for SSSE3, 2 for AVX2 */
+  static int  gr_x11_simd_level = -1;
+
+
+  static void
+  gr_x11_simd_init( void )
+  {
+    const char*  name  = getenv( "GR_X11_CONVERT" );
+    int          level = 0;
+
+
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports( "avx2" ) )
+      level = 2;
+    else if ( __builtin_cpu_supports( "ssse3" ) )
+      level = 1;
+
+    if ( name )
+    {
+      if ( !strcmp( name, "generic" ) )
+        level = 0;
+      else if ( !strcmp( name, "SSSE3" ) && level > 1 )
+        level = 1;
+    }
+
+    LOG(( "X11 converters: %s\n", level == 2 ? "AVX2"
+                                : level == 1 ? "SSSE3"
+                                             : "generic" ));
+
+    gr_x11_simd_level = level;
+  }
+
+
+  /* return the fastest replacement of a generic converter */
+  static grX11ConvertFunc
+  gr_x11_convert_select( grX11ConvertFunc  convert )
+  {
+    const grX11ConvertFunc  (*funcs)[3];
+
+
+    if ( gr_x11_simd_level < 0 )
+      gr_x11_simd_init();
+
+    if ( gr_x11_simd_level == 0 )
+      return convert;
+
+    for ( funcs = gr_x11_simd_converters; (*funcs)[0]; funcs++ )
+      if ( (*funcs)[0] == convert )
+        return (*funcs)[gr_x11_simd_level];
+
+    return convert;
+  }
+
+
+#undef GR_X11_SIMD_CONVERT
+#undef GR_X11_PACK16
+#undef GR_X11_JOIN2
+#undef GR_X11_LOAD2
+#undef GR_X11_INLINE_AVX2
+#undef GR_X11_INLINE_SSSE3
+#undef GR_X11_AVX2
+#undef GR_X11_SSSE3
+
+#else /* !GR_X11_SIMD */
+
+#define gr_x11_convert_select( convert )  ( convert )
+
+#endif /* !GR_X11_SIMD */
+
+
+/* END */
@@ -92,7 +92,17 @@ ifneq ($(X11_PATH),)
   ifeq ($(PLATFORM),unix)
     GRAPH_LINK += $(X11_LIB:%=-R%)
   endif
-  GRAPH_LINK += $(X11_LIB:%=-L%) -lX11
+  # libXext provides the MIT-SHM extension for shared-memory images; say
+  # `make X11_NO_SHM=1' to build the driver without them and not link
+  # libXext at all.
+  #
+  ifdef X11_NO_SHM
+    X11_DEFINES := GR_X11_NO_SHM
+    GRAPH_LINK  += $(X11_LIB:%=-L%) -lX11
+  else
+    X11_DEFINES :=
+    GRAPH_LINK  += $(X11_LIB:%=-L%) -lXext -lX11
+  endif
 
   # Solaris needs a -lsocket in GRAPH_LINK.
   #
@@ -112,15 +122,17 @@ ifneq ($(X11_PATH),)
 
   # the rule used to compile the X11 driver
   #
-  $(OBJ_DIR_2)/grx11.$(O): $(GR_X11)/grx11.c $(GR_X11)/grx11.h $(GRAPH_H)
+  $(OBJ_DIR_2)/grx11.$(O): $(GR_X11)/grx11.c $(GR_X11)/grx11.h \
+                           $(GR_X11)/grx11simd.h $(GRAPH_H)
   ifneq ($(LIBTOOL),)
 	  $(LIBTOOL) --mode=compile $(CC) -static $(CFLAGS) \
+                     $(X11_DEFINES:%=$D%) \
                      $(GRAPH_INCLUDES:%=$I%) \
                      $I$(subst /,$(COMPILER_SEP),$(GR_X11)) \
                      $(X11_INCLUDE:%=$I%) \
                      $T$(subst /,$(COMPILER_SEP),$@ $<)
   else
-	  $(CC) $(CFLAGS) $(GRAPH_INCLUDES:%=$I%) \
+	  $(CC) $(CFLAGS) $(X11_DEFINES:%=$D%) $(GRAPH_INCLUDES:%=$I%) \
                 $I$(subst /,$(COMPILER_SEP),$(GR_X11)) \
                 $(X11_INCLUDE:%=$I%) \
                 $T$(subst /,$(COMPILER_SEP),$@ $<)
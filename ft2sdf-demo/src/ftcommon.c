@@ -36,8 +36,22 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdarg.h>
+#include <time.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #ifdef FT_CONFIG_OPTION_USE_PNG
 #include <png.h>
@@ -45,6 +59,7 @@
 
 
 #ifdef _WIN32
+#include <windows.h>
 #define strcasecmp  _stricmp
 #endif
 
@@ -468,6 +483,19 @@
     if ( error )
       PanicZ( "could not initialize charmap cache" );
 
+    handle->sdf_cache = (FTDemo_SDF_Cache)calloc( 1,
+                                                  sizeof ( *handle->sdf_cache ) );
+    if ( handle->sdf_cache )
+    {
+      handle->sdf_cache->num_buckets = 1024;
+      handle->sdf_cache->buckets     = (FTDemo_SDF_Node*)calloc(
+                                         handle->sdf_cache->num_buckets,
+                                         sizeof ( FTDemo_SDF_Node ) );
+      handle->sdf_cache->max_bytes   = MAX_SDF_BYTES;
+    }
+    if ( !handle->sdf_cache || !handle->sdf_cache->buckets )
+      PanicZ( "could not initialize distance field cache" );
+
     FT_Bitmap_Init( &handle->bitmap );
 
     FT_Stroker_New( handle->library, &handle->stroker );
@@ -521,6 +549,13 @@
         FT_Done_Glyph( glyph->image );
     }
 
+#ifdef UNIX
+    FTDemo_SDF_Cache_Close_File( handle );
+#endif
+    FTDemo_SDF_Cache_Set_Max_Bytes( handle, 0 );
+    free( handle->sdf_cache->buckets );
+    free( handle->sdf_cache );
+
     FT_Stroker_Done( handle->stroker );
     FT_Bitmap_Done( handle->library, &handle->bitmap );
     FTC_Manager_Done( handle->cache_manager );
@@ -1797,6 +1832,2267 @@
   }
 
 
+  /*************************************************************************/
+  /*                                                                       */
+  /* The SDF cache.  The FTC cache classes are private to FreeType, so     */
+  /* distance fields live in a separate LRU cache with its own byte        */
+  /* budget.  It is keyed on an `FTC_ScalerRec' plus the SDF parameters    */
+  /* and gets its faces and sizes from the cache manager, i.e., through    */
+  /* `my_face_requester', just like the image and sbit caches.             */
+  /*                                                                       */
+
+  typedef struct  FTDemo_SDF_NodeRec_
+  {
+    FTDemo_SDF_TypeRec   type;
+    FTDemo_SDF_GlyphRec  glyph;
+    FT_ULong             size;         /* bytes charged to the cache */
+    FT_Bool              mapped;       /* buffer is in the cache file */
+    FT_Bool              prefetched;   /* not looked up yet */
+    FT_UInt              locks;        /* pinned, never evicted */
+
+    FTDemo_SDF_Node      hash_next;
+    FTDemo_SDF_Node      prev;         /* LRU list */
+    FTDemo_SDF_Node      next;
+
+  } FTDemo_SDF_NodeRec;
+
+
+  static FT_ULong
+  sdf_type_hash( FTDemo_SDF_Type  type,
+                 FT_UInt          gindex )
+  {
+    FT_ULong  h = (FT_ULong)(size_t)type->scaler.face_id;
+
+
+    h = h * 31 + gindex;
+    h = h * 31 + type->scaler.width;
+    h = h * 31 + type->scaler.height;
+    h = h * 31 + (FT_ULong)type->load_flags;
+    h = h * 31 + (FT_ULong)type->spread;
+    h = h * 16 + (FT_ULong)( ( type->overlaps   != 0 )      |
+                             ( type->use_bitmap != 0 ) << 1 |
+                             ( type->flip_y     != 0 ) << 2 |
+                             ( type->quantized  != 0 ) << 3 );
+
+    return h ^ ( h >> 15 );
+  }
+
+
+  static FT_Bool
+  sdf_type_equal( FTDemo_SDF_Type  a,
+                  FTDemo_SDF_Type  b )
+  {
+    return a->scaler.face_id == b->scaler.face_id &&
+           a->scaler.width   == b->scaler.width   &&
+           a->scaler.height  == b->scaler.height  &&
+           a->scaler.pixel   == b->scaler.pixel   &&
+           a->scaler.x_res   == b->scaler.x_res   &&
+           a->scaler.y_res   == b->scaler.y_res   &&
+           a->load_flags     == b->load_flags     &&
+           a->spread         == b->spread         &&
+           !a->overlaps      == !b->overlaps      &&
+           !a->use_bitmap    == !b->use_bitmap    &&
+           !a->flip_y        == !b->flip_y        &&
+           !a->quantized     == !b->quantized;
+  }
+
+
+  static void
+  sdf_cache_unlink( FTDemo_SDF_Cache  cache,
+                    FTDemo_SDF_Node   node )
+  {
+    if ( node->prev )
+      node->prev->next = node->next;
+    else
+      cache->head = node->next;
+
+    if ( node->next )
+      node->next->prev = node->prev;
+    else
+      cache->tail = node->prev;
+
+    node->prev = node->next = NULL;
+  }
+
+
+  static void
+  sdf_cache_push_front( FTDemo_SDF_Cache  cache,
+                        FTDemo_SDF_Node   node )
+  {
+    node->prev = NULL;
+    node->next = cache->head;
+
+    if ( cache->head )
+      cache->head->prev = node;
+    else
+      cache->tail = node;
+
+    cache->head = node;
+  }
+
+
+#ifdef UNIX
+  /* drop a reference to the cache file mapping of `buffer' */
+  static void
+  sdf_file_release( FTDemo_SDF_Cache  cache,
+                    const void*       buffer );
+#endif
+
+
+  static void
+  sdf_cache_remove( FTDemo_SDF_Cache  cache,
+                    FTDemo_SDF_Node   node )
+  {
+    FTDemo_SDF_Node*  pnode;
+
+
+    pnode = cache->buckets + sdf_type_hash( &node->type,
+                                            node->glyph.glyph_index ) %
+                               cache->num_buckets;
+    while ( *pnode != node )
+      pnode = &(*pnode)->hash_next;
+    *pnode = node->hash_next;
+
+    sdf_cache_unlink( cache, node );
+
+    cache->cur_bytes -= node->size;
+    cache->num_nodes--;
+
+    if ( node->prefetched )
+      cache->prefetch_bytes -= node->size;
+
+#ifdef UNIX
+    if ( node->mapped )
+      sdf_file_release( cache, node->glyph.buffer );
+    else
+#endif
+      free( node->glyph.buffer );
+    free( node->glyph.mips );
+    free( node );
+  }
+
+
+  /* unless flushing, never evict the most recently used node, */
+  /* it may be on display, nor a locked one                     */
+  static void
+  sdf_cache_trim( FTDemo_SDF_Cache  cache )
+  {
+    FTDemo_SDF_Node  node = cache->tail;
+
+
+    while ( cache->cur_bytes > cache->max_bytes && node )
+    {
+      FTDemo_SDF_Node  prev = node->prev;
+
+
+      if ( !cache->max_bytes                          ||
+           ( node != cache->head && !node->locks )    )
+      {
+        sdf_cache_remove( cache, node );
+        cache->evictions++;
+      }
+
+      node = prev;
+    }
+  }
+
+
+  /* the node of a field returned by the cache */
+  static FTDemo_SDF_Node
+  sdf_glyph_node( FTDemo_SDF_Glyph  glyph )
+  {
+    return (FTDemo_SDF_Node)( (char*)glyph -
+                              offsetof( FTDemo_SDF_NodeRec, glyph ) );
+  }
+
+
+  double
+  FTDemo_Get_Time( void )
+  {
+#if defined _POSIX_TIMERS && _POSIX_TIMERS > 0
+    struct timespec  tv;
+
+
+#ifdef _POSIX_MONOTONIC_CLOCK
+    clock_gettime( CLOCK_MONOTONIC, &tv );
+#else
+    clock_gettime( CLOCK_REALTIME, &tv );
+#endif
+
+    return 1E9 * (double)tv.tv_sec + (double)tv.tv_nsec;
+#elif defined _WIN32
+    LARGE_INTEGER  ticks, frequency;
+
+
+    QueryPerformanceCounter( &ticks );
+    QueryPerformanceFrequency( &frequency );
+
+    return 1E9 * (double)ticks.QuadPart / (double)frequency.QuadPart;
+#else
+    return 1E9 * (double)clock() / (double)CLOCKS_PER_SEC;
+#endif
+  }
+
+
+  FT_Error
+  FTDemo_SDF_Render( FT_Face           face,
+                     FTDemo_SDF_Type   type,
+                     FT_UInt           gindex,
+                     FTDemo_SDF_Glyph  glyph,
+                     double*           times )
+  {
+    FT_Error      error;
+    FT_Library    library = face->glyph->library;
+    FT_GlyphSlot  slot    = face->glyph;
+    FT_Bitmap*    bitmap  = &slot->bitmap;
+    FT_Int        y;
+    double        start   = 0;
+
+
+    if ( times )
+    {
+      for ( y = 0; y < N_SDF_STEPS; y++ )
+        times[y] = 0;
+    }
+
+    glyph->glyph_index = gindex;
+    glyph->width       = 0;
+    glyph->rows        = 0;
+    glyph->left        = 0;
+    glyph->top         = 0;
+    glyph->buffer      = NULL;
+    glyph->mips        = NULL;
+    glyph->num_mips    = 0;
+    glyph->quantized   = 0;
+    glyph->error_max   = 0;
+    glyph->error_rms   = 0;
+    glyph->spread      = type->spread;
+
+    /* the SDF parameters are module properties */
+    error = FT_Property_Set( library, "sdf", "spread", &type->spread );
+    if ( !error )
+      error = FT_Property_Set( library, "bsdf", "spread", &type->spread );
+    if ( !error )
+      error = FT_Property_Set( library, "sdf", "overlaps", &type->overlaps );
+    if ( !error )
+      error = FT_Property_Set( library, "sdf", "flip_y", &type->flip_y );
+    if ( !error )
+      error = FT_Property_Set( library, "bsdf", "flip_y", &type->flip_y );
+    if ( error )
+      return error;
+
+    if ( times )
+      start = FTDemo_Get_Time();
+
+    error = FT_Load_Glyph( face, gindex, type->load_flags );
+    if ( error )
+      return error;
+
+    if ( times )
+    {
+      times[SDF_STEP_LOAD] = FTDemo_Get_Time() - start;
+      start               += times[SDF_STEP_LOAD];
+    }
+
+    glyph->advance = slot->advance;
+
+    /* nothing to render for empty glyphs like the space */
+    if ( slot->format == FT_GLYPH_FORMAT_OUTLINE &&
+         slot->outline.n_points == 0             )
+      return FT_Err_Ok;
+
+    if ( type->use_bitmap )
+    {
+      error = FT_Render_Glyph( slot, FT_RENDER_MODE_NORMAL );
+      if ( error )
+        return error;
+
+      if ( times )
+      {
+        times[SDF_STEP_RASTER] = FTDemo_Get_Time() - start;
+        start                 += times[SDF_STEP_RASTER];
+      }
+    }
+
+    error = FT_Render_Glyph( slot, FT_RENDER_MODE_SDF );
+    if ( error )
+      return error;
+
+    if ( times )
+      times[SDF_STEP_SDF] = FTDemo_Get_Time() - start;
+
+    if ( !bitmap->buffer || !bitmap->width || !bitmap->rows )
+      return FT_Err_Ok;
+
+    glyph->width  = (int)bitmap->width;
+    glyph->rows   = (int)bitmap->rows;
+    glyph->left   = slot->bitmap_left;
+    glyph->top    = slot->bitmap_top;
+    glyph->buffer = (FT_Short*)malloc( (size_t)glyph->width *
+                                       (size_t)glyph->rows  *
+                                       sizeof ( FT_Short ) );
+    if ( !glyph->buffer )
+      return FT_Err_Out_Of_Memory;
+
+    /* FreeType 2.11.1 and newer emit 8-bit fields with the edge at 128; */
+    /* widen them to the 6.10 distances that FreeType 2.11.0 produced    */
+    if ( bitmap->pixel_mode == FT_PIXEL_MODE_GRAY )
+    {
+      for ( y = 0; y < glyph->rows; y++ )
+      {
+        const FT_Byte*  src = bitmap->buffer + y * bitmap->pitch;
+        FT_Short*       dst = (FT_Short*)glyph->buffer + y * glyph->width;
+        FT_Int          x;
+
+
+        for ( x = 0; x < glyph->width; x++ )
+          dst[x] = (FT_Short)( ( src[x] - 128 ) * type->spread * 8 );
+      }
+    }
+    else
+    {
+      for ( y = 0; y < glyph->rows; y++ )
+        memcpy( (FT_Short*)glyph->buffer + y * glyph->width,
+                bitmap->buffer + y * bitmap->pitch,
+                (size_t)glyph->width * sizeof ( FT_Short ) );
+    }
+
+    if ( type->quantized )
+      return FTDemo_SDF_Quantize( glyph, type->spread );
+
+    return FT_Err_Ok;
+  }
+
+
+  FT_Error
+  FTDemo_SDF_Quantize( FTDemo_SDF_Glyph  glyph,
+                       int               spread )
+  {
+    const FT_Short*  src   = (const FT_Short*)glyph->buffer;
+    size_t           count = (size_t)glyph->width * (size_t)glyph->rows;
+    FT_Byte*         dst;
+    FT_Int32         scale = spread * 8;    /* 6.10 distance of one step */
+    FT_Int32         max   = 0;
+    double           sum   = 0;
+    size_t           n;
+
+
+    if ( !glyph->buffer || glyph->quantized )
+      return FT_Err_Ok;
+
+    dst = (FT_Byte*)malloc( count );
+    if ( !dst )
+      return FT_Err_Out_Of_Memory;
+
+    for ( n = 0; n < count; n++ )
+    {
+      FT_Int32  d = src[n];
+      FT_Int32  q = d >= 0 ? 128 + ( d + scale / 2 ) / scale
+                           : 128 - ( scale / 2 - d ) / scale;
+      FT_Int32  e;
+
+
+      /* +spread itself is one step beyond the range */
+      if ( q < 0 )
+        q = 0;
+      if ( q > 255 )
+        q = 255;
+
+      dst[n] = (FT_Byte)q;
+
+      e = d - ( q - 128 ) * scale;
+      if ( e < 0 )
+        e = -e;
+      if ( max < e )
+        max = e;
+      sum += (double)e * e;
+    }
+
+    free( glyph->buffer );
+    free( glyph->mips );
+
+    glyph->buffer    = dst;
+    glyph->mips      = NULL;
+    glyph->num_mips  = 0;
+    glyph->quantized = 1;
+    glyph->error_max = (FT_UShort)( max > 0xFFFF ? 0xFFFF : max );
+    glyph->error_rms = (FT_UShort)( sqrt( sum / (double)count ) + 0.5 );
+
+    return FT_Err_Ok;
+  }
+
+
+  static FTDemo_SDF_Node
+  sdf_cache_find( FTDemo_SDF_Cache  cache,
+                  FTDemo_SDF_Type   type,
+                  FT_UInt           gindex )
+  {
+    FTDemo_SDF_Node  node;
+
+
+    node = cache->buckets[sdf_type_hash( type, gindex ) % cache->num_buckets];
+
+    for ( ; node; node = node->hash_next )
+      if ( node->glyph.glyph_index == gindex     &&
+           sdf_type_equal( &node->type, type ) )
+        break;
+
+    return node;
+  }
+
+
+  static void
+  sdf_cache_add( FTDemo_SDF_Cache  cache,
+                 FTDemo_SDF_Type   type,
+                 FTDemo_SDF_Node   node )
+  {
+    FTDemo_SDF_Node*  bucket;
+
+
+    bucket = cache->buckets + sdf_type_hash( type, node->glyph.glyph_index ) %
+                                cache->num_buckets;
+
+    node->type      = *type;
+    node->hash_next = *bucket;
+    *bucket         = node;
+
+    /* prefetched nodes go right behind the head, so that */
+    /* the field on display is never evicted              */
+    if ( node->prefetched && cache->head )
+    {
+      node->prev = cache->head;
+      node->next = cache->head->next;
+
+      if ( node->next )
+        node->next->prev = node;
+      else
+        cache->tail = node;
+
+      cache->head->next = node;
+
+      cache->prefetches++;
+      cache->prefetch_bytes += node->size;
+    }
+    else
+      sdf_cache_push_front( cache, node );
+
+    cache->cur_bytes += node->size;
+    cache->num_nodes++;
+
+    sdf_cache_trim( cache );
+  }
+
+
+  static FT_Error
+  sdf_cache_insert( FTDemo_Handle*     handle,
+                    FTDemo_SDF_Type    type,
+                    FTDemo_SDF_Glyph   glyph,
+                    FT_Bool            prefetched,
+                    FTDemo_SDF_Glyph*  aglyph )
+  {
+    FTDemo_SDF_Cache  cache = handle->sdf_cache;
+    FTDemo_SDF_Node   node;
+
+
+    /* rendered twice, e.g., by prefetching and on demand */
+    node = sdf_cache_find( cache, type, glyph->glyph_index );
+    if ( node )
+    {
+      free( glyph->buffer );
+      glyph->buffer = NULL;
+
+      if ( !prefetched )
+      {
+        if ( node->prefetched )
+        {
+          node->prefetched = 0;
+
+          cache->prefetch_hits++;
+          cache->prefetch_bytes -= node->size;
+        }
+
+        sdf_cache_unlink( cache, node );
+        sdf_cache_push_front( cache, node );
+      }
+
+      if ( aglyph )
+        *aglyph = &node->glyph;
+      return FT_Err_Ok;
+    }
+
+    node = (FTDemo_SDF_Node)calloc( 1, sizeof ( FTDemo_SDF_NodeRec ) );
+    if ( !node )
+      return FT_Err_Out_Of_Memory;
+
+    node->glyph      = *glyph;
+    node->prefetched = prefetched;
+
+    node->glyph.mips     = NULL;
+    node->glyph.num_mips = 0;
+
+    node->size       = sizeof ( FTDemo_SDF_NodeRec ) +
+                       (FT_ULong)glyph->width * (FT_ULong)glyph->rows *
+                         ( glyph->quantized ? 1 : sizeof ( FT_Short ) );
+
+#ifdef UNIX
+    /* the file is just a cache, so failing to write it is harmless */
+    FTDemo_SDF_File_Store( handle, type, glyph );
+#endif
+
+    sdf_cache_add( cache, type, node );
+
+    if ( aglyph )
+      *aglyph = &node->glyph;
+    return FT_Err_Ok;
+  }
+
+
+  FT_Bool
+  FTDemo_SDF_Cache_Find( FTDemo_Handle*     handle,
+                         FTDemo_SDF_Type    type,
+                         FT_UInt            gindex,
+                         FTDemo_SDF_Glyph*  aglyph )
+  {
+    FTDemo_SDF_Cache  cache = handle->sdf_cache;
+    FTDemo_SDF_Node   node;
+
+
+    node = sdf_cache_find( cache, type, gindex );
+    if ( node )
+    {
+      if ( node->prefetched )
+      {
+        node->prefetched = 0;
+
+        cache->prefetch_hits++;
+        cache->prefetch_bytes -= node->size;
+      }
+
+      sdf_cache_unlink( cache, node );
+      sdf_cache_push_front( cache, node );
+      cache->hits++;
+
+      *aglyph = &node->glyph;
+      return 1;
+    }
+
+    cache->misses++;
+
+#ifdef UNIX
+    if ( !cache->file )
+      return 0;
+
+    node = (FTDemo_SDF_Node)calloc( 1, sizeof ( FTDemo_SDF_NodeRec ) );
+    if ( !node )
+      return 0;
+
+    if ( !FTDemo_SDF_File_Lookup( handle, type, gindex, &node->glyph ) )
+    {
+      free( node );
+      return 0;
+    }
+
+    /* mapped fields cost no heap memory */
+    node->mapped = 1;
+    node->size   = sizeof ( FTDemo_SDF_NodeRec );
+
+    sdf_cache_add( cache, type, node );
+
+    *aglyph = &node->glyph;
+    return 1;
+#else
+    return 0;
+#endif
+  }
+
+
+  FT_Error
+  FTDemo_SDF_Cache_Insert( FTDemo_Handle*     handle,
+                           FTDemo_SDF_Type    type,
+                           FTDemo_SDF_Glyph   glyph,
+                           FTDemo_SDF_Glyph*  aglyph )
+  {
+    return sdf_cache_insert( handle, type, glyph, 0, aglyph );
+  }
+
+
+  FT_Error
+  FTDemo_SDF_Cache_Prefetch( FTDemo_Handle*    handle,
+                             FTDemo_SDF_Type   type,
+                             FTDemo_SDF_Glyph  glyph )
+  {
+    return sdf_cache_insert( handle, type, glyph, 1, NULL );
+  }
+
+
+  FT_Bool
+  FTDemo_SDF_Cache_Has( FTDemo_Handle*   handle,
+                        FTDemo_SDF_Type  type,
+                        FT_UInt          gindex )
+  {
+    if ( sdf_cache_find( handle->sdf_cache, type, gindex ) )
+      return 1;
+
+#ifdef UNIX
+    return FTDemo_SDF_File_Lookup( handle, type, gindex, NULL );
+#else
+    return 0;
+#endif
+  }
+
+
+  FT_Error
+  FTDemo_SDF_Cache_Lookup( FTDemo_Handle*     handle,
+                           FTDemo_SDF_Type    type,
+                           FT_UInt            gindex,
+                           FTDemo_SDF_Glyph*  aglyph )
+  {
+    FT_Error             error;
+    FTDemo_SDF_GlyphRec  glyph;
+    FT_Size              size;
+
+
+    if ( FTDemo_SDF_Cache_Find( handle, type, gindex, aglyph ) )
+      return FT_Err_Ok;
+
+    glyph.buffer = NULL;
+
+    error = FTC_Manager_LookupSize( handle->cache_manager,
+                                    &type->scaler, &size );
+    if ( !error )
+      error = FTDemo_SDF_Render( size->face, type, gindex, &glyph, NULL );
+    if ( !error )
+      error = FTDemo_SDF_Cache_Insert( handle, type, &glyph, aglyph );
+    if ( error )
+      free( glyph.buffer );
+
+    return error;
+  }
+
+
+  /* Halve a pair of rows of `width' distances into `dst', using  */
+  /* `filter'.  Distances right of the row are `outside'.         */
+  static void
+  sdf_mip_row( FT_Short*        dst,
+               const FT_Short*  a,
+               const FT_Short*  b,
+               int              width,
+               FT_Short         outside,
+               int              filter )
+  {
+    int  x = 0;
+
+
+#ifdef __SSE2__
+    const __m128i  ones  = _mm_set1_epi16( 1 );
+    const __m128i  round = _mm_set1_epi32( 2 );
+
+
+    /* 8 results from 16 columns of each row */
+    for ( ; 2 * x + 16 <= width; x += 8 )
+    {
+      __m128i  a0 = _mm_loadu_si128( (const __m128i*)( a + 2 * x ) );
+      __m128i  a1 = _mm_loadu_si128( (const __m128i*)( a + 2 * x + 8 ) );
+      __m128i  b0 = _mm_loadu_si128( (const __m128i*)( b + 2 * x ) );
+      __m128i  b1 = _mm_loadu_si128( (const __m128i*)( b + 2 * x + 8 ) );
+      __m128i  r0, r1;
+
+
+      if ( filter == SDF_MIP_MAX )
+      {
+        /* the maximum of each pair ends up in its low half */
+        r0 = _mm_max_epi16( a0, b0 );
+        r1 = _mm_max_epi16( a1, b1 );
+        r0 = _mm_max_epi16( r0, _mm_srli_epi32( r0, 16 ) );
+        r1 = _mm_max_epi16( r1, _mm_srli_epi32( r1, 16 ) );
+        r0 = _mm_srai_epi32( _mm_slli_epi32( r0, 16 ), 16 );
+        r1 = _mm_srai_epi32( _mm_slli_epi32( r1, 16 ), 16 );
+      }
+      else
+      {
+        /* `madd' adds the pairs */
+        r0 = _mm_add_epi32( _mm_madd_epi16( a0, ones ),
+                            _mm_madd_epi16( b0, ones ) );
+        r1 = _mm_add_epi32( _mm_madd_epi16( a1, ones ),
+                            _mm_madd_epi16( b1, ones ) );
+        r0 = _mm_srai_epi32( _mm_add_epi32( r0, round ), 2 );
+        r1 = _mm_srai_epi32( _mm_add_epi32( r1, round ), 2 );
+      }
+
+      _mm_storeu_si128( (__m128i*)( dst + x ), _mm_packs_epi32( r0, r1 ) );
+    }
+#endif
+
+    for ( ; 2 * x < width; x++ )
+    {
+      FT_Int32  d0 = a[2 * x];
+      FT_Int32  d1 = b[2 * x];
+      FT_Int32  d2 = 2 * x + 1 < width ? a[2 * x + 1] : outside;
+      FT_Int32  d3 = 2 * x + 1 < width ? b[2 * x + 1] : outside;
+
+
+      if ( filter == SDF_MIP_MAX )
+      {
+        if ( d0 < d1 )
+          d0 = d1;
+        if ( d0 < d2 )
+          d0 = d2;
+        if ( d0 < d3 )
+          d0 = d3;
+
+        dst[x] = (FT_Short)d0;
+      }
+      else
+        dst[x] = (FT_Short)( ( d0 + d1 + d2 + d3 + 2 ) >> 2 );
+    }
+  }
+
+
+  /* the same for 8-bit distances */
+  static void
+  sdf_mip_row8( FT_Byte*        dst,
+                const FT_Byte*  a,
+                const FT_Byte*  b,
+                int             width,
+                FT_Byte         outside,
+                int             filter )
+  {
+    int  x = 0;
+
+
+#ifdef __SSE2__
+    const __m128i  low   = _mm_set1_epi16( 0xFF );
+    const __m128i  round = _mm_set1_epi16( 2 );
+
+
+    /* 16 results from 32 columns of each row */
+    for ( ; 2 * x + 32 <= width; x += 16 )
+    {
+      __m128i  a0 = _mm_loadu_si128( (const __m128i*)( a + 2 * x ) );
+      __m128i  a1 = _mm_loadu_si128( (const __m128i*)( a + 2 * x + 16 ) );
+      __m128i  b0 = _mm_loadu_si128( (const __m128i*)( b + 2 * x ) );
+      __m128i  b1 = _mm_loadu_si128( (const __m128i*)( b + 2 * x + 16 ) );
+      __m128i  r0, r1;
+
+
+      if ( filter == SDF_MIP_MAX )
+      {
+        /* the maximum of each pair ends up in its low byte */
+        r0 = _mm_max_epu8( a0, b0 );
+        r1 = _mm_max_epu8( a1, b1 );
+        r0 = _mm_and_si128( _mm_max_epu8( r0, _mm_srli_epi16( r0, 8 ) ),
+                            low );
+        r1 = _mm_and_si128( _mm_max_epu8( r1, _mm_srli_epi16( r1, 8 ) ),
+                            low );
+      }
+      else
+      {
+        /* the even and the odd columns, added as 16-bit values */
+        r0 = _mm_add_epi16( _mm_add_epi16( _mm_and_si128( a0, low ),
+                                           _mm_srli_epi16( a0, 8 ) ),
+                            _mm_add_epi16( _mm_and_si128( b0, low ),
+                                           _mm_srli_epi16( b0, 8 ) ) );
+        r1 = _mm_add_epi16( _mm_add_epi16( _mm_and_si128( a1, low ),
+                                           _mm_srli_epi16( a1, 8 ) ),
+                            _mm_add_epi16( _mm_and_si128( b1, low ),
+                                           _mm_srli_epi16( b1, 8 ) ) );
+        r0 = _mm_srli_epi16( _mm_add_epi16( r0, round ), 2 );
+        r1 = _mm_srli_epi16( _mm_add_epi16( r1, round ), 2 );
+      }
+
+      _mm_storeu_si128( (__m128i*)( dst + x ), _mm_packus_epi16( r0, r1 ) );
+    }
+#endif
+
+    for ( ; 2 * x < width; x++ )
+    {
+      FT_Int32  d0 = a[2 * x];
+      FT_Int32  d1 = b[2 * x];
+      FT_Int32  d2 = 2 * x + 1 < width ? a[2 * x + 1] : outside;
+      FT_Int32  d3 = 2 * x + 1 < width ? b[2 * x + 1] : outside;
+
+
+      if ( filter == SDF_MIP_MAX )
+      {
+        if ( d0 < d1 )
+          d0 = d1;
+        if ( d0 < d2 )
+          d0 = d2;
+        if ( d0 < d3 )
+          d0 = d3;
+
+        dst[x] = (FT_Byte)d0;
+      }
+      else
+        dst[x] = (FT_Byte)( ( d0 + d1 + d2 + d3 + 2 ) >> 2 );
+    }
+  }
+
+
+  FT_Error
+  FTDemo_SDF_Cache_Mips( FTDemo_Handle*    handle,
+                         FTDemo_SDF_Glyph  glyph,
+                         int               filter )
+  {
+    FTDemo_SDF_Cache  cache = handle->sdf_cache;
+    FTDemo_SDF_Node   node;
+    FT_Short          outside;
+    FT_Byte*          mips;
+    FT_Byte*          empty;
+    FT_Byte*          src;
+    FT_Byte*          dst;
+    size_t            size  = 0;
+    size_t            bytes = glyph->quantized ? 1 : sizeof ( FT_Short );
+    int               width = glyph->width;
+    int               rows  = glyph->rows;
+    int               n, y;
+
+
+    if ( !glyph->buffer || ( glyph->mips && glyph->mip_filter == filter ) )
+      return FT_Err_Ok;
+
+    node    = sdf_glyph_node( glyph );
+    outside = (FT_Short)( -glyph->spread * 1024 );
+
+    for ( n = 0; n < SDF_MAX_MIPS && ( width > 1 || rows > 1 ); n++ )
+    {
+      width = ( width + 1 ) / 2;
+      rows  = ( rows  + 1 ) / 2;
+      size += (size_t)width * (size_t)rows * bytes;
+    }
+
+    if ( !n )
+      return FT_Err_Ok;
+
+    mips  = (FT_Byte*)malloc( size );
+    empty = (FT_Byte*)malloc( (size_t)glyph->width * bytes );
+    if ( !mips || !empty )
+    {
+      free( mips );
+      free( empty );
+      return FT_Err_Out_Of_Memory;
+    }
+
+    /* an odd last row is paired with the outside, */
+    /* which is zero in 8-bit fields               */
+    if ( glyph->quantized )
+      memset( empty, 0, (size_t)glyph->width );
+    else
+      for ( y = 0; y < glyph->width; y++ )
+        ( (FT_Short*)empty )[y] = outside;
+
+    src   = (FT_Byte*)glyph->buffer;
+    dst   = mips;
+    width = glyph->width;
+    rows  = glyph->rows;
+
+    for ( n = 0; n < SDF_MAX_MIPS && ( width > 1 || rows > 1 ); n++ )
+    {
+      int  mip_width = ( width + 1 ) / 2;
+      int  mip_rows  = ( rows  + 1 ) / 2;
+
+
+      for ( y = 0; y < mip_rows; y++ )
+      {
+        FT_Byte*  a = src + 2 * (size_t)y * (size_t)width * bytes;
+        FT_Byte*  b = 2 * y + 1 < rows ? a + (size_t)width * bytes : empty;
+
+
+        if ( glyph->quantized )
+          sdf_mip_row8( dst + (size_t)y * (size_t)mip_width,
+                        a, b, width, 0, filter );
+        else
+          sdf_mip_row( (FT_Short*)dst + y * mip_width,
+                       (const FT_Short*)a, (const FT_Short*)b,
+                       width, outside, filter );
+      }
+
+      src   = dst;
+      dst  += (size_t)mip_width * (size_t)mip_rows * bytes;
+      width = mip_width;
+      rows  = mip_rows;
+    }
+
+    free( empty );
+
+    /* a chain for another filter has the same size */
+    if ( glyph->mips )
+      free( glyph->mips );
+    else
+    {
+      node->size       += size;
+      cache->cur_bytes += size;
+
+      if ( node->prefetched )
+        cache->prefetch_bytes += size;
+    }
+
+    glyph->mips       = mips;
+    glyph->num_mips   = n;
+    glyph->mip_filter = filter;
+
+    /* the field is in use, so it must survive the trimming */
+    sdf_cache_unlink( cache, node );
+    sdf_cache_push_front( cache, node );
+    sdf_cache_trim( cache );
+
+    return FT_Err_Ok;
+  }
+
+
+  void
+  FTDemo_SDF_Get_Mip( FTDemo_SDF_Glyph  glyph,
+                      int               level,
+                      FTDemo_SDF_Glyph  amip )
+  {
+    FT_Byte*  buffer = (FT_Byte*)glyph->mips;
+    size_t    bytes  = glyph->quantized ? 1 : sizeof ( FT_Short );
+    int       n;
+
+
+    *amip = *glyph;
+
+    amip->mips     = NULL;
+    amip->num_mips = 0;
+
+    if ( level > glyph->num_mips )
+      level = glyph->num_mips;
+    if ( level <= 0 )
+      return;
+
+    for ( n = 1; n <= level; n++ )
+    {
+      if ( n > 1 )
+        buffer += (size_t)amip->width * (size_t)amip->rows * bytes;
+
+      amip->width = ( amip->width + 1 ) / 2;
+      amip->rows  = ( amip->rows  + 1 ) / 2;
+    }
+
+    amip->buffer = buffer;
+  }
+
+
+  void
+  FTDemo_SDF_Cache_Lock( FTDemo_Handle*    handle,
+                         FTDemo_SDF_Glyph  glyph )
+  {
+    FT_UNUSED( handle );
+
+
+    sdf_glyph_node( glyph )->locks++;
+  }
+
+
+  void
+  FTDemo_SDF_Cache_Unlock( FTDemo_Handle*    handle,
+                           FTDemo_SDF_Glyph  glyph )
+  {
+    sdf_glyph_node( glyph )->locks--;
+
+    /* what was kept may be over the budget */
+    sdf_cache_trim( handle->sdf_cache );
+  }
+
+
+  void
+  FTDemo_SDF_Cache_Set_Max_Bytes( FTDemo_Handle*  handle,
+                                  FT_ULong        max_bytes )
+  {
+    handle->sdf_cache->max_bytes = max_bytes;
+
+    sdf_cache_trim( handle->sdf_cache );
+  }
+
+
+  /* the string's fields, rendered on a miss, or, with `missing', */
+  /* only those in the cache, listing the other glyphs             */
+  static FT_Error
+  sdf_string_load( FTDemo_Handle*          handle,
+                   FTDemo_SDF_Type         type,
+                   FTDemo_String_Context*  sc,
+                   FTDemo_SDF_String       string,
+                   FT_UInt*                missing,
+                   FT_Int*                 anum_missing )
+  {
+    FT_Error   error;
+    FT_Vector  pen = { 0, 0 };
+    FT_Vector  center;
+    FT_BBox    bbox;
+    FT_Int     n, m;
+
+
+    FTDemo_SDF_String_Done( handle, string );
+
+    if ( anum_missing )
+      *anum_missing = 0;
+
+    error = FTDemo_String_Load( handle, sc );
+    if ( error )
+      return error;
+
+    bbox.xMin = bbox.yMin =  0x7FFFFFFFL;
+    bbox.xMax = bbox.yMax = -0x7FFFFFFFL;
+
+    for ( n = 0; n < handle->string_length; n++ )
+    {
+      PGlyph            glyph  = handle->string + n;
+      FTDemo_SDF_Glyph  field  = NULL;
+      FT_Vector         origin = pen;
+
+
+      if ( sc->vertical )
+      {
+        origin.x += glyph->vvector.x;
+        origin.y += glyph->vvector.y;
+
+        pen.x += glyph->vadvance.x;
+        pen.y += glyph->vadvance.y;
+      }
+      else
+      {
+        pen.x += glyph->hadvance.x;
+        pen.y += glyph->hadvance.y;
+      }
+
+      if ( glyph->image && missing )
+      {
+        if ( !FTDemo_SDF_Cache_Find( handle, type,
+                                     glyph->glyph_index, &field ) )
+        {
+          for ( m = 0; m < *anum_missing; m++ )
+            if ( missing[m] == glyph->glyph_index )
+              break;
+
+          if ( m == *anum_missing )
+            missing[( *anum_missing )++] = glyph->glyph_index;
+
+          field = NULL;
+        }
+      }
+      else if ( glyph->image                                         &&
+                FTDemo_SDF_Cache_Lookup( handle, type,
+                                         glyph->glyph_index, &field ) )
+        field = NULL;
+
+      /* glyphs that fail to load just keep their place */
+      if ( field && field->buffer )
+      {
+        /* the next lookups must not evict it */
+        sdf_glyph_node( field )->locks++;
+
+        origin.x += field->left * 64;
+        origin.y += ( field->top - field->rows ) * 64;
+
+        if ( bbox.xMin > origin.x )
+          bbox.xMin = origin.x;
+        if ( bbox.yMin > origin.y )
+          bbox.yMin = origin.y;
+        if ( bbox.xMax < origin.x + field->width * 64 )
+          bbox.xMax = origin.x + field->width * 64;
+        if ( bbox.yMax < origin.y + field->rows * 64 )
+          bbox.yMax = origin.y + field->rows * 64;
+      }
+      else
+        field = NULL;
+
+      string->fields[n]  = field;
+      string->origins[n] = origin;
+    }
+
+    string->length = handle->string_length;
+
+    /* the same reference point as `FTDemo_String_Draw' */
+    center.x = FT_MulFix( pen.x, sc->center );
+    center.y = FT_MulFix( pen.y, sc->center );
+
+    for ( n = 0; n < string->length; n++ )
+    {
+      string->origins[n].x -= center.x;
+      string->origins[n].y -= center.y;
+    }
+
+    if ( bbox.xMin > bbox.xMax )
+      bbox.xMin = bbox.yMin = bbox.xMax = bbox.yMax = 0;
+    else
+    {
+      bbox.xMin -= center.x;
+      bbox.yMin -= center.y;
+      bbox.xMax -= center.x;
+      bbox.yMax -= center.y;
+    }
+
+    string->bbox = bbox;
+
+    return FT_Err_Ok;
+  }
+
+
+  FT_Error
+  FTDemo_SDF_String_Load( FTDemo_Handle*          handle,
+                          FTDemo_SDF_Type         type,
+                          FTDemo_String_Context*  sc,
+                          FTDemo_SDF_String       string )
+  {
+    return sdf_string_load( handle, type, sc, string, NULL, NULL );
+  }
+
+
+  FT_Error
+  FTDemo_SDF_String_Find( FTDemo_Handle*          handle,
+                          FTDemo_SDF_Type         type,
+                          FTDemo_String_Context*  sc,
+                          FTDemo_SDF_String       string,
+                          FT_UInt*                missing,
+                          FT_Int*                 anum_missing )
+  {
+    return sdf_string_load( handle, type, sc, string,
+                            missing, anum_missing );
+  }
+
+
+  void
+  FTDemo_SDF_String_Done( FTDemo_Handle*     handle,
+                          FTDemo_SDF_String  string )
+  {
+    FT_Int  n;
+
+
+    for ( n = 0; n < string->length; n++ )
+      if ( string->fields[n] )
+        sdf_glyph_node( string->fields[n] )->locks--;
+
+    string->length = 0;
+
+    /* what was kept for the string may be over the budget */
+    sdf_cache_trim( handle->sdf_cache );
+  }
+
+
+  /*************************************************************************/
+  /*                                                                       */
+  /* The atlas packer.  Each page keeps its skyline, the top edge of the   */
+  /* packed area as a list of horizontal segments.  A field goes to the    */
+  /* position where its top ends lowest, the narrowest segment winning a  */
+  /* tie; the segments it covers are then replaced by its own top edge.   */
+  /* The space left below a skyline step is lost, but with fields of      */
+  /* similar size that is little, and nothing ever has to move.           */
+  /*                                                                       */
+  /* Every field reserves `padding' extra pixels to its right and bottom; */
+  /* the skyline starts `padding' pixels into the page, so that fields    */
+  /* are padded on all sides.                                              */
+  /*                                                                       */
+
+  void
+  FTDemo_SDF_Atlas_Init( FTDemo_SDF_Atlas  atlas,
+                         int               page_width,
+                         int               page_height,
+                         int               padding )
+  {
+    atlas->page_width  = page_width;
+    atlas->page_height = page_height;
+    atlas->padding     = padding;
+    atlas->pages       = NULL;
+    atlas->num_pages   = 0;
+    atlas->max_pages   = 0;
+  }
+
+
+  void
+  FTDemo_SDF_Atlas_Done( FTDemo_SDF_Atlas  atlas )
+  {
+    int  n;
+
+
+    for ( n = 0; n < atlas->num_pages; n++ )
+      free( atlas->pages[n].skyline );
+
+    free( atlas->pages );
+
+    atlas->pages     = NULL;
+    atlas->num_pages = 0;
+    atlas->max_pages = 0;
+  }
+
+
+  static FT_Error
+  sdf_atlas_new_page( FTDemo_SDF_Atlas  atlas )
+  {
+    FTDemo_SDF_Page  page;
+
+
+    if ( atlas->num_pages >= atlas->max_pages )
+    {
+      int              max_pages = atlas->max_pages ? 2 * atlas->max_pages
+                                                    : 4;
+      FTDemo_SDF_Page  pages;
+
+
+      pages = (FTDemo_SDF_Page)realloc( atlas->pages,
+                                        (size_t)max_pages *
+                                          sizeof ( FTDemo_SDF_PageRec ) );
+      if ( !pages )
+        return FT_Err_Out_Of_Memory;
+
+      atlas->pages     = pages;
+      atlas->max_pages = max_pages;
+    }
+
+    page = atlas->pages + atlas->num_pages;
+
+    /* segments are at least one pixel wide; `sdf_atlas_add' */
+    /* needs one more while it updates the skyline            */
+    page->skyline = (FTDemo_SDF_Skyline)malloc(
+                      (size_t)( atlas->page_width + 1 ) *
+                        sizeof ( FTDemo_SDF_SkylineRec ) );
+    if ( !page->skyline )
+      return FT_Err_Out_Of_Memory;
+
+    page->skyline[0].x     = atlas->padding;
+    page->skyline[0].y     = atlas->padding;
+    page->skyline[0].width = atlas->page_width - atlas->padding;
+    page->num_segments     = 1;
+    page->num_glyphs       = 0;
+    page->used             = 0;
+
+    atlas->num_pages++;
+
+    return FT_Err_Ok;
+  }
+
+
+  /* the lowest `y' of a `width' by `rows' box whose left edge is */
+  /* at segment `n', or -1 if it doesn't fit                      */
+  static int
+  sdf_atlas_fit( FTDemo_SDF_Atlas  atlas,
+                 FTDemo_SDF_Page   page,
+                 int               n,
+                 int               width,
+                 int               rows )
+  {
+    FTDemo_SDF_Skyline  segment = page->skyline + n;
+    int                 y       = 0;
+
+
+    /* the segments reach the right edge of the page */
+    if ( segment->x + width > atlas->page_width )
+      return -1;
+
+    for ( ; width > 0; width -= segment->width, segment++ )
+    {
+      if ( segment->y > y )
+        y = segment->y;
+
+      if ( y + rows > atlas->page_height )
+        return -1;
+    }
+
+    return y;
+  }
+
+
+  /* put the top edge of a box placed at segment `n' into the skyline */
+  static void
+  sdf_atlas_add( FTDemo_SDF_Page  page,
+                 int              n,
+                 int              y,
+                 int              width,
+                 int              rows )
+  {
+    FTDemo_SDF_Skyline  skyline = page->skyline;
+    int                 right   = skyline[n].x + width;
+    int                 m;
+
+
+    memmove( skyline + n + 1, skyline + n,
+             (size_t)( page->num_segments - n ) *
+               sizeof ( FTDemo_SDF_SkylineRec ) );
+    page->num_segments++;
+
+    skyline[n].y     = y + rows;
+    skyline[n].width = width;
+
+    /* cut away what the box covers */
+    m = n + 1;
+    while ( m < page->num_segments && skyline[m].x < right )
+    {
+      int  cut = right - skyline[m].x;
+
+
+      if ( cut < skyline[m].width )
+      {
+        skyline[m].x     += cut;
+        skyline[m].width -= cut;
+        break;
+      }
+
+      memmove( skyline + m, skyline + m + 1,
+               (size_t)( page->num_segments - m - 1 ) *
+                 sizeof ( FTDemo_SDF_SkylineRec ) );
+      page->num_segments--;
+    }
+
+    /* join neighbours of the same height */
+    for ( m = 0; m + 1 < page->num_segments; )
+    {
+      if ( skyline[m].y != skyline[m + 1].y )
+      {
+        m++;
+        continue;
+      }
+
+      skyline[m].width += skyline[m + 1].width;
+      memmove( skyline + m + 1, skyline + m + 2,
+               (size_t)( page->num_segments - m - 2 ) *
+                 sizeof ( FTDemo_SDF_SkylineRec ) );
+      page->num_segments--;
+    }
+  }
+
+
+  FT_Error
+  FTDemo_SDF_Atlas_Insert( FTDemo_SDF_Atlas  atlas,
+                           int               width,
+                           int               rows,
+                           int*              apage,
+                           int*              ax,
+                           int*              ay )
+  {
+    int       box_width = width + atlas->padding;
+    int       box_rows  = rows + atlas->padding;
+    int       p;
+    FT_Error  error;
+
+
+    *apage = -1;
+    *ax    = 0;
+    *ay    = 0;
+
+    if ( width <= 0 || rows <= 0 )
+      return FT_Err_Ok;
+
+    if ( box_width + atlas->padding > atlas->page_width ||
+         box_rows + atlas->padding > atlas->page_height )
+      return FT_Err_Invalid_Argument;
+
+    for ( p = 0; ; p++ )
+    {
+      FTDemo_SDF_Page  page;
+      int              best   = -1;
+      int              best_y = 0;
+      int              n;
+
+
+      if ( p == atlas->num_pages )
+      {
+        error = sdf_atlas_new_page( atlas );
+        if ( error )
+          return error;
+      }
+
+      page = atlas->pages + p;
+
+      for ( n = 0; n < page->num_segments; n++ )
+      {
+        int  y = sdf_atlas_fit( atlas, page, n, box_width, box_rows );
+
+
+        if ( y < 0 )
+          continue;
+
+        if ( best < 0                                           ||
+             y < best_y                                         ||
+             ( y == best_y                                    &&
+               page->skyline[n].width < page->skyline[best].width ) )
+        {
+          best   = n;
+          best_y = y;
+        }
+      }
+
+      if ( best < 0 )
+        continue;
+
+      *apage = p;
+      *ax    = page->skyline[best].x;
+      *ay    = best_y;
+
+      sdf_atlas_add( page, best, best_y, box_width, box_rows );
+
+      page->num_glyphs++;
+      page->used += (unsigned long)width * (unsigned long)rows;
+
+      return FT_Err_Ok;
+    }
+  }
+
+
+  double
+  FTDemo_SDF_Atlas_Occupancy( FTDemo_SDF_Atlas  atlas,
+                              int               page )
+  {
+    double  area = (double)atlas->page_width * atlas->page_height;
+    double  used = 0;
+    int     n;
+
+
+    if ( page >= 0 )
+      return page < atlas->num_pages ? atlas->pages[page].used / area : 0;
+
+    if ( atlas->num_pages == 0 )
+      return 0;
+
+    for ( n = 0; n < atlas->num_pages; n++ )
+      used += atlas->pages[n].used;
+
+    return used / ( area * atlas->num_pages );
+  }
+
+
+  /*************************************************************************/
+  /*                                                                       */
+  /* The SDF cache file.  It starts with a header and continues with       */
+  /* records, each made of a fixed-size key and metrics part followed by   */
+  /* the distances, padded to a multiple of 8 bytes.  Everything is        */
+  /* stored in native byte order so that the mapped data can be used as    */
+  /* is; a file written on a different architecture or by a different     */
+  /* version is discarded.                                                 */
+  /*                                                                       */
+  /* Records are only ever appended.  On opening, the file is scanned and  */
+  /* the in-memory index rebuilt; the scan stops at the first record that  */
+  /* is truncated or fails its checksum, and everything from there on is   */
+  /* cut off.  A crash while writing thus loses at most the last glyph.    */
+  /*                                                                       */
+  /* Fonts are identified by a hash of the font file, not by their name.   */
+  /* Only the process holding the file lock appends to the file; other     */
+  /* processes use it read-only.                                           */
+  /*                                                                       */
+
+#ifdef UNIX
+
+#define SDF_FILE_MAGIC    "FTSDFC\r\n"
+#define SDF_FILE_VERSION  2
+#define SDF_BYTE_ORDER    0x01020304UL
+#define SDF_RECORD_MAGIC  0x52464453UL   /* `SDFR' */
+
+
+  typedef struct  FTDemo_SDF_FileHeaderRec_
+  {
+    char       magic[8];
+    FT_UInt32  version;
+    FT_UInt32  byte_order;
+    FT_UInt32  record_size;
+    FT_UInt32  reserved;
+
+  } FTDemo_SDF_FileHeaderRec;
+
+
+  typedef struct  FTDemo_SDF_RecordRec_
+  {
+    FT_UInt32  magic;
+    FT_UInt32  checksum;       /* of all following bytes, incl. data */
+
+    /* the key; keep `font_hash' first and `flags' last */
+    FT_UInt32  font_hash[2];
+    FT_UInt32  font_size;
+    FT_Int32   face_index;
+    FT_UInt32  glyph_index;
+    FT_UInt32  width;          /* the `FTC_ScalerRec' fields */
+    FT_UInt32  height;
+    FT_Int32   pixel;
+    FT_UInt32  x_res;
+    FT_UInt32  y_res;
+    FT_Int32   load_flags;
+    FT_Int32   spread;
+    FT_UInt32  flags;          /* SDF_FLAG_XXX */
+
+    /* the metrics */
+    FT_Int32   bitmap_width;
+    FT_Int32   bitmap_rows;
+    FT_Int32   left;
+    FT_Int32   top;
+    FT_Int32   advance_x;
+    FT_Int32   advance_y;
+    FT_UInt16  error_max;      /* of 8-bit fields */
+    FT_UInt16  error_rms;
+
+  } FTDemo_SDF_RecordRec, *FTDemo_SDF_Record;
+
+#define SDF_FLAG_OVERLAPS    1
+#define SDF_FLAG_USE_BITMAP  2
+#define SDF_FLAG_FLIP_Y      4
+#define SDF_FLAG_QUANTIZED   8
+
+#define SDF_KEY_OFFSET  offsetof( FTDemo_SDF_RecordRec, font_hash )
+#define SDF_KEY_SIZE    ( offsetof( FTDemo_SDF_RecordRec, bitmap_width ) - \
+                          SDF_KEY_OFFSET )
+
+#define SDF_DATA_SIZE( r )  ( (size_t)(r)->bitmap_width *          \
+                              (size_t)(r)->bitmap_rows  *          \
+                              ( (r)->flags & SDF_FLAG_QUANTIZED    \
+                                  ? 1 : sizeof ( FT_Short ) ) )
+#define SDF_TOTAL_SIZE( r )  ( ( sizeof ( FTDemo_SDF_RecordRec ) + \
+                                 SDF_DATA_SIZE( r ) + 7 ) & ~(size_t)7 )
+
+
+  /* an index entry, pointing to a record in the file */
+  typedef struct  FTDemo_SDF_EntryRec_
+  {
+    FTDemo_SDF_RecordRec           record;   /* copy of the header */
+    size_t                         offset;
+
+    struct FTDemo_SDF_EntryRec_*   next;
+
+  } FTDemo_SDF_EntryRec, *FTDemo_SDF_Entry;
+
+
+  typedef struct  FTDemo_SDF_FontHashRec_
+  {
+    PFont                            font;
+    FT_UInt32                        hash[2];
+    FT_UInt32                        size;
+
+    struct FTDemo_SDF_FontHashRec_*  next;
+
+  } FTDemo_SDF_FontHashRec, *FTDemo_SDF_FontHash;
+
+
+  /* A mapping covers a page-aligned window of the file, at least     */
+  /* `SDF_MAP_STEP' bytes long and possibly reaching beyond its end,   */
+  /* so that the records appended next need no new mapping.  It is     */
+  /* counted by the glyphs pointing into it and dropped when they are  */
+  /* all released, unless it is the most recent one.                   */
+  typedef struct  FTDemo_SDF_MapRec_
+  {
+    void*                       base;
+    size_t                      offset;   /* in the file */
+    size_t                      size;
+    FT_UInt                     refs;
+
+    struct FTDemo_SDF_MapRec_*  next;
+
+  } FTDemo_SDF_MapRec, *FTDemo_SDF_Map;
+
+#define SDF_MAP_STEP  ( 4UL << 20 )
+
+
+  typedef struct  FTDemo_SDF_FileRec_
+  {
+    int                  fd;
+    FT_Bool              read_only;
+    size_t               end;          /* of the last valid record */
+
+    FTDemo_SDF_Map       maps;         /* the most recent one first */
+
+    FTDemo_SDF_Entry*    buckets;
+    FT_UInt              num_buckets;
+    FT_UInt              num_entries;
+
+    FTDemo_SDF_FontHash  fonts;
+
+  } FTDemo_SDF_FileRec;
+
+
+  /* FNV-1a */
+  static FT_UInt32
+  sdf_file_checksum( FT_UInt32       h,
+                     const FT_Byte*  p,
+                     size_t          len )
+  {
+    while ( len-- )
+      h = ( h ^ *p++ ) * 0x01000193U;
+
+    return h;
+  }
+
+
+  static FT_UInt32
+  sdf_record_hash( FTDemo_SDF_Record  record )
+  {
+    return sdf_file_checksum( 0x811C9DC5U,
+                              (const FT_Byte*)record + SDF_KEY_OFFSET,
+                              SDF_KEY_SIZE );
+  }
+
+
+  /* FNV-1a and djb2 of the font file contents */
+  static void
+  sdf_font_hash_update( FTDemo_SDF_FontHash  fh,
+                        const FT_Byte*       p,
+                        size_t               len )
+  {
+    FT_UInt32  h0 = fh->hash[0];
+    FT_UInt32  h1 = fh->hash[1];
+
+
+    fh->size += (FT_UInt32)len;
+
+    while ( len-- )
+    {
+      h0 = ( h0 ^ *p ) * 0x01000193U;
+      h1 = h1 * 33 + *p++;
+    }
+
+    fh->hash[0] = h0;
+    fh->hash[1] = h1;
+  }
+
+
+  static FTDemo_SDF_FontHash
+  sdf_file_font_hash( FTDemo_SDF_File  file,
+                      PFont            font )
+  {
+    FTDemo_SDF_FontHash  fh;
+
+
+    for ( fh = file->fonts; fh; fh = fh->next )
+      if ( fh->font == font )
+        return fh;
+
+    fh = (FTDemo_SDF_FontHash)calloc( 1, sizeof ( FTDemo_SDF_FontHashRec ) );
+    if ( !fh )
+      return NULL;
+
+    fh->font    = font;
+    fh->hash[0] = 0x811C9DC5U;
+    fh->hash[1] = 5381;
+
+    if ( font->file_address )
+      sdf_font_hash_update( fh, (const FT_Byte*)font->file_address,
+                            font->file_size );
+    else
+    {
+      FILE*    in = fopen( font->filepathname, "rb" );
+      FT_Byte  buffer[16384];
+      size_t   len;
+
+
+      if ( !in )
+      {
+        free( fh );
+        return NULL;
+      }
+
+      while ( ( len = fread( buffer, 1, sizeof ( buffer ), in ) ) > 0 )
+        sdf_font_hash_update( fh, buffer, len );
+
+      fclose( in );
+    }
+
+    fh->next    = file->fonts;
+    file->fonts = fh;
+
+    return fh;
+  }
+
+
+  /* fill the key part of `record' */
+  static FT_Bool
+  sdf_file_make_key( FTDemo_SDF_File    file,
+                     FTDemo_SDF_Type    type,
+                     FT_UInt            gindex,
+                     FTDemo_SDF_Record  record )
+  {
+    PFont                font = (PFont)type->scaler.face_id;
+    FTDemo_SDF_FontHash  fh   = sdf_file_font_hash( file, font );
+
+
+    if ( !fh )
+      return 0;
+
+    memset( record, 0, sizeof ( *record ) );
+
+    record->magic        = SDF_RECORD_MAGIC;
+    record->font_hash[0] = fh->hash[0];
+    record->font_hash[1] = fh->hash[1];
+    record->font_size    = fh->size;
+    record->face_index   = font->face_index;
+    record->glyph_index  = gindex;
+    record->width        = type->scaler.width;
+    record->height       = type->scaler.height;
+    record->pixel        = type->scaler.pixel;
+    record->x_res        = type->scaler.x_res;
+    record->y_res        = type->scaler.y_res;
+    record->load_flags   = type->load_flags;
+    record->spread       = type->spread;
+    record->flags        = ( type->overlaps   ? SDF_FLAG_OVERLAPS   : 0 ) |
+                           ( type->use_bitmap ? SDF_FLAG_USE_BITMAP : 0 ) |
+                           ( type->flip_y     ? SDF_FLAG_FLIP_Y     : 0 ) |
+                           ( type->quantized  ? SDF_FLAG_QUANTIZED  : 0 );
+
+    return 1;
+  }
+
+
+  static FTDemo_SDF_Entry
+  sdf_file_find( FTDemo_SDF_File    file,
+                 FTDemo_SDF_Record  key )
+  {
+    FTDemo_SDF_Entry  entry;
+
+
+    entry = file->buckets[sdf_record_hash( key ) % file->num_buckets];
+    for ( ; entry; entry = entry->next )
+      if ( !memcmp( (const FT_Byte*)&entry->record + SDF_KEY_OFFSET,
+                    (const FT_Byte*)key + SDF_KEY_OFFSET,
+                    SDF_KEY_SIZE ) )
+        return entry;
+
+    return NULL;
+  }
+
+
+  static FT_Error
+  sdf_file_add( FTDemo_SDF_File    file,
+                FTDemo_SDF_Record  record,
+                size_t             offset )
+  {
+    FTDemo_SDF_Entry  entry;
+    FT_UInt           h;
+
+
+    /* keep the chains short */
+    if ( file->num_entries >= 2 * file->num_buckets )
+    {
+      FT_UInt            num_buckets = 2 * file->num_buckets;
+      FTDemo_SDF_Entry*  buckets;
+      FT_UInt            n;
+
+
+      buckets = (FTDemo_SDF_Entry*)calloc( num_buckets,
+                                           sizeof ( FTDemo_SDF_Entry ) );
+      if ( buckets )
+      {
+        for ( n = 0; n < file->num_buckets; n++ )
+        {
+          while ( ( entry = file->buckets[n] ) != NULL )
+          {
+            file->buckets[n] = entry->next;
+
+            h           = sdf_record_hash( &entry->record ) % num_buckets;
+            entry->next = buckets[h];
+            buckets[h]  = entry;
+          }
+        }
+
+        free( file->buckets );
+        file->buckets     = buckets;
+        file->num_buckets = num_buckets;
+      }
+    }
+
+    entry = (FTDemo_SDF_Entry)malloc( sizeof ( FTDemo_SDF_EntryRec ) );
+    if ( !entry )
+      return FT_Err_Out_Of_Memory;
+
+    entry->record = *record;
+    entry->offset = offset;
+
+    h                 = sdf_record_hash( record ) % file->num_buckets;
+    entry->next       = file->buckets[h];
+    file->buckets[h]  = entry;
+    file->num_entries++;
+
+    return FT_Err_Ok;
+  }
+
+
+  static void
+  sdf_file_unmap( FTDemo_SDF_Map*  pmap )
+  {
+    FTDemo_SDF_Map  map = *pmap;
+
+
+    *pmap = map->next;
+    munmap( map->base, map->size );
+    free( map );
+  }
+
+
+  /* get a mapping of the `size' bytes at `offset', mapping a */
+  /* new window of the file if none covers them yet           */
+  static FTDemo_SDF_Map
+  sdf_file_map( FTDemo_SDF_File  file,
+                size_t           offset,
+                size_t           size )
+  {
+    FTDemo_SDF_Map*  pmap;
+    FTDemo_SDF_Map   map;
+    void*            base;
+    size_t           page = (size_t)sysconf( _SC_PAGESIZE );
+    size_t           start, len;
+
+
+    for ( map = file->maps; map; map = map->next )
+      if ( offset >= map->offset                          &&
+           offset + size <= map->offset + map->size       )
+        return map;
+
+    start = offset - offset % page;
+    len   = offset + size - start;
+    if ( len < SDF_MAP_STEP )
+      len = SDF_MAP_STEP;
+    len = ( len + page - 1 ) / page * page;
+
+    base = mmap( NULL, len, PROT_READ, MAP_SHARED, file->fd, (off_t)start );
+    if ( base == MAP_FAILED )
+      return NULL;
+
+    map = (FTDemo_SDF_Map)malloc( sizeof ( FTDemo_SDF_MapRec ) );
+    if ( !map )
+    {
+      munmap( base, len );
+      return NULL;
+    }
+
+    /* the older windows nobody uses anymore are superseded */
+    pmap = &file->maps;
+    while ( *pmap )
+      if ( !(*pmap)->refs )
+        sdf_file_unmap( pmap );
+      else
+        pmap = &(*pmap)->next;
+
+    map->base   = base;
+    map->offset = start;
+    map->size   = len;
+    map->refs   = 0;
+    map->next   = file->maps;
+    file->maps  = map;
+
+    return map;
+  }
+
+
+  static void
+  sdf_file_release( FTDemo_SDF_Cache  cache,
+                    const void*       buffer )
+  {
+    FTDemo_SDF_File  file = cache->file;
+    const FT_Byte*   p    = (const FT_Byte*)buffer;
+    FTDemo_SDF_Map*  pmap;
+
+
+    if ( !file || !p )
+      return;
+
+    for ( pmap = &file->maps; *pmap; pmap = &(*pmap)->next )
+    {
+      FTDemo_SDF_Map  map  = *pmap;
+      const FT_Byte*  base = (const FT_Byte*)map->base;
+
+
+      if ( p >= base && p < base + map->size )
+      {
+        if ( !--map->refs && map != file->maps )
+          sdf_file_unmap( pmap );
+        return;
+      }
+    }
+  }
+
+
+  /* Check the header, (re)initializing the file if we own it.  Other */
+  /* processes may still map an outdated file, and truncating it would */
+  /* make them fault, so a fresh file is renamed over it instead.      */
+  static FT_Error
+  sdf_file_check_header( FTDemo_SDF_File  file,
+                         const char*      filepathname )
+  {
+    FTDemo_SDF_FileHeaderRec  header;
+    struct stat               st;
+    ssize_t                   len;
+    char*                     tmpname;
+    int                       fd;
+
+
+    if ( fstat( file->fd, &st ) )
+      return FT_Err_Cannot_Open_Resource;
+
+    len = pread( file->fd, &header, sizeof ( header ), 0 );
+    if ( len < 0 )
+      return FT_Err_Cannot_Open_Stream;
+
+    /* never touch files that aren't ours */
+    if ( memcmp( header.magic, SDF_FILE_MAGIC,
+                 (size_t)len < sizeof ( header.magic ) ? (size_t)len
+                                                       : sizeof ( header.magic ) ) )
+      return FT_Err_Unknown_File_Format;
+
+    if ( (size_t)len == sizeof ( header )                          &&
+         header.version     == SDF_FILE_VERSION                   &&
+         header.byte_order  == SDF_BYTE_ORDER                     &&
+         header.record_size == sizeof ( FTDemo_SDF_RecordRec )    )
+    {
+      file->end = (size_t)st.st_size;
+      return FT_Err_Ok;
+    }
+
+    /* empty, torn, or outdated: start over */
+    if ( file->read_only )
+      return FT_Err_Unknown_File_Format;
+
+    memset( &header, 0, sizeof ( header ) );
+    memcpy( header.magic, SDF_FILE_MAGIC, sizeof ( header.magic ) );
+    header.version     = SDF_FILE_VERSION;
+    header.byte_order  = SDF_BYTE_ORDER;
+    header.record_size = sizeof ( FTDemo_SDF_RecordRec );
+
+    tmpname = (char*)malloc( strlen( filepathname ) + 8 );
+    if ( !tmpname )
+      return FT_Err_Out_Of_Memory;
+
+    sprintf( tmpname, "%s.XXXXXX", filepathname );
+
+    fd = mkstemp( tmpname );
+    if ( fd < 0 )
+    {
+      free( tmpname );
+      return FT_Err_Cannot_Open_Stream;
+    }
+
+    if ( fchmod( fd, st.st_mode & 0777 )                         ||
+         pwrite( fd, &header, sizeof ( header ), 0 ) !=
+           (ssize_t)sizeof ( header )                            ||
+         rename( tmpname, filepathname )                         )
+    {
+      unlink( tmpname );
+      free( tmpname );
+      close( fd );
+      return FT_Err_Cannot_Open_Stream;
+    }
+
+    free( tmpname );
+
+    /* this also drops the lock on the old file */
+    close( file->fd );
+    file->fd = fd;
+
+    if ( lockf( file->fd, F_TLOCK, 0 ) )
+      file->read_only = 1;
+
+    file->end = sizeof ( header );
+
+    return FT_Err_Ok;
+  }
+
+
+  /* rebuild the index from a mapping of the whole file; */
+  /* returns the end of the last valid record            */
+  static size_t
+  sdf_file_scan( FTDemo_SDF_File  file,
+                 const FT_Byte*   base )
+  {
+    size_t          size   = file->end;
+    size_t          offset = sizeof ( FTDemo_SDF_FileHeaderRec );
+
+
+    while ( size - offset >= sizeof ( FTDemo_SDF_RecordRec ) )
+    {
+      FTDemo_SDF_RecordRec  record;
+      size_t                total;
+
+
+      memcpy( &record, base + offset, sizeof ( record ) );
+
+      if ( record.magic != SDF_RECORD_MAGIC                 ||
+           record.bitmap_width < 0 || record.bitmap_rows < 0 ||
+           record.bitmap_width > 0xFFFF                      ||
+           record.bitmap_rows  > 0xFFFF                      )
+        break;
+
+      total = SDF_TOTAL_SIZE( &record );
+      if ( total > size - offset )
+        break;
+
+      if ( record.checksum !=
+             sdf_file_checksum( 0x811C9DC5U,
+                                base + offset + 2 * sizeof ( FT_UInt32 ),
+                                sizeof ( record ) - 2 * sizeof ( FT_UInt32 ) +
+                                  SDF_DATA_SIZE( &record ) ) )
+        break;
+
+      /* a later record for the same key wins */
+      {
+        FTDemo_SDF_Entry  entry = sdf_file_find( file, &record );
+
+
+        if ( entry )
+        {
+          entry->record = record;
+          entry->offset = offset;
+        }
+        else if ( sdf_file_add( file, &record, offset ) )
+          break;
+      }
+
+      offset += total;
+    }
+
+    return offset;
+  }
+
+
+  FT_Error
+  FTDemo_SDF_Cache_Open_File( FTDemo_Handle*  handle,
+                              const char*     filepathname )
+  {
+    FT_Error         error;
+    FTDemo_SDF_File  file;
+    FTDemo_SDF_Map   map;
+    size_t           end;
+
+
+    FTDemo_SDF_Cache_Close_File( handle );
+
+    file = (FTDemo_SDF_File)calloc( 1, sizeof ( FTDemo_SDF_FileRec ) );
+    if ( !file )
+      return FT_Err_Out_Of_Memory;
+
+    file->num_buckets = 1024;
+    file->buckets     = (FTDemo_SDF_Entry*)calloc( file->num_buckets,
+                                                   sizeof ( FTDemo_SDF_Entry ) );
+    if ( !file->buckets )
+    {
+      free( file );
+      return FT_Err_Out_Of_Memory;
+    }
+
+    file->fd = open( filepathname, O_RDWR | O_CREAT, 0666 );
+    if ( file->fd < 0 )
+    {
+      file->fd        = open( filepathname, O_RDONLY );
+      file->read_only = 1;
+    }
+    if ( file->fd < 0 )
+    {
+      error = FT_Err_Cannot_Open_Resource;
+      goto Fail;
+    }
+
+    /* somebody else is appending to it */
+    if ( !file->read_only && lockf( file->fd, F_TLOCK, 0 ) )
+      file->read_only = 1;
+
+    error = sdf_file_check_header( file, filepathname );
+    if ( error )
+      goto Fail;
+
+    map = sdf_file_map( file, 0, file->end );
+    if ( !map )
+    {
+      error = FT_Err_Cannot_Open_Stream;
+      goto Fail;
+    }
+
+    end = sdf_file_scan( file, (const FT_Byte*)map->base );
+
+    /* drop the remains of an interrupted write */
+    if ( end < file->end )
+    {
+      if ( !file->read_only && ftruncate( file->fd, (off_t)end ) )
+        file->read_only = 1;
+      file->end = end;
+    }
+
+    handle->sdf_cache->file = file;
+
+    return FT_Err_Ok;
+
+  Fail:
+    handle->sdf_cache->file = file;
+    FTDemo_SDF_Cache_Close_File( handle );
+
+    return error;
+  }
+
+
+  void
+  FTDemo_SDF_Cache_Close_File( FTDemo_Handle*  handle )
+  {
+    FTDemo_SDF_Cache  cache = handle->sdf_cache;
+    FTDemo_SDF_File   file  = cache->file;
+    FT_ULong          max_bytes;
+    FT_UInt           n;
+
+
+    if ( !file )
+      return;
+
+    /* cached glyphs may point into the mappings */
+    if ( file->maps )
+    {
+      max_bytes = cache->max_bytes;
+      FTDemo_SDF_Cache_Set_Max_Bytes( handle, 0 );
+      cache->max_bytes = max_bytes;
+    }
+
+    while ( file->maps )
+      sdf_file_unmap( &file->maps );
+
+    for ( n = 0; n < file->num_buckets; n++ )
+      while ( file->buckets[n] )
+      {
+        FTDemo_SDF_Entry  entry = file->buckets[n];
+
+
+        file->buckets[n] = entry->next;
+        free( entry );
+      }
+
+    while ( file->fonts )
+    {
+      FTDemo_SDF_FontHash  fh = file->fonts;
+
+
+      file->fonts = fh->next;
+      free( fh );
+    }
+
+    if ( file->fd >= 0 )
+      close( file->fd );
+
+    free( file->buckets );
+    free( file );
+
+    cache->file = NULL;
+  }
+
+
+  FT_Bool
+  FTDemo_SDF_File_Lookup( FTDemo_Handle*    handle,
+                          FTDemo_SDF_Type   type,
+                          FT_UInt           gindex,
+                          FTDemo_SDF_Glyph  glyph )
+  {
+    FTDemo_SDF_File       file = handle->sdf_cache->file;
+    FTDemo_SDF_RecordRec  key;
+    FTDemo_SDF_Entry      entry;
+    FTDemo_SDF_Map        map;
+    FTDemo_SDF_Record     record;
+
+
+    if ( !file || !sdf_file_make_key( file, type, gindex, &key ) )
+      return 0;
+
+    entry = sdf_file_find( file, &key );
+    if ( !entry || !glyph )
+      return entry != NULL;
+
+    map = sdf_file_map( file, entry->offset,
+                        SDF_TOTAL_SIZE( &entry->record ) );
+    if ( !map )
+      return 0;
+
+    record = (FTDemo_SDF_Record)( (FT_Byte*)map->base +
+                                  ( entry->offset - map->offset ) );
+
+    glyph->glyph_index = gindex;
+    glyph->width       = record->bitmap_width;
+    glyph->rows        = record->bitmap_rows;
+    glyph->left        = record->left;
+    glyph->top         = record->top;
+    glyph->advance.x   = record->advance_x;
+    glyph->advance.y   = record->advance_y;
+    glyph->buffer      = glyph->width && glyph->rows
+                           ? (void*)( record + 1 )
+                           : NULL;
+    glyph->mips        = NULL;
+    glyph->num_mips    = 0;
+    glyph->quantized   = ( record->flags & SDF_FLAG_QUANTIZED ) != 0;
+    glyph->error_max   = record->error_max;
+    glyph->error_rms   = record->error_rms;
+    glyph->spread      = record->spread;
+
+    if ( glyph->buffer )
+      map->refs++;
+
+    handle->sdf_cache->file_hits++;
+
+    return 1;
+  }
+
+
+  FT_Error
+  FTDemo_SDF_File_Store( FTDemo_Handle*    handle,
+                         FTDemo_SDF_Type   type,
+                         FTDemo_SDF_Glyph  glyph )
+  {
+    FT_Error              error;
+    FTDemo_SDF_File       file = handle->sdf_cache->file;
+    FTDemo_SDF_RecordRec  record;
+    size_t                data_size, total;
+    FT_Byte*              buffer;
+
+
+    if ( !file || file->read_only )
+      return FT_Err_Ok;
+
+    if ( !sdf_file_make_key( file, type, glyph->glyph_index, &record ) )
+      return FT_Err_Cannot_Open_Resource;
+
+    record.bitmap_width = glyph->buffer ? glyph->width : 0;
+    record.bitmap_rows  = glyph->buffer ? glyph->rows  : 0;
+    record.left         = glyph->left;
+    record.top          = glyph->top;
+    record.advance_x    = (FT_Int32)glyph->advance.x;
+    record.advance_y    = (FT_Int32)glyph->advance.y;
+    record.error_max    = glyph->error_max;
+    record.error_rms    = glyph->error_rms;
+
+    data_size = SDF_DATA_SIZE( &record );
+    total     = SDF_TOTAL_SIZE( &record );
+
+    /* write each record with a single call */
+    buffer = (FT_Byte*)calloc( 1, total );
+    if ( !buffer )
+      return FT_Err_Out_Of_Memory;
+
+    memcpy( buffer, &record, sizeof ( record ) );
+    if ( data_size )
+      memcpy( buffer + sizeof ( record ), glyph->buffer, data_size );
+
+    record.checksum = sdf_file_checksum( 0x811C9DC5U,
+                                         buffer + 2 * sizeof ( FT_UInt32 ),
+                                         sizeof ( record ) -
+                                           2 * sizeof ( FT_UInt32 ) +
+                                           data_size );
+    memcpy( buffer, &record, sizeof ( record ) );
+
+    if ( pwrite( file->fd, buffer, total, (off_t)file->end ) !=
+           (ssize_t)total )
+    {
+      /* leave no partial record behind, or stop writing */
+      if ( ftruncate( file->fd, (off_t)file->end ) )
+        file->read_only = 1;
+      free( buffer );
+      return FT_Err_Cannot_Open_Stream;
+    }
+
+    free( buffer );
+
+    error = sdf_file_add( file, &record, file->end );
+    if ( error )
+      return error;
+
+    file->end += total;
+    handle->sdf_cache->file_writes++;
+
+    return FT_Err_Ok;
+  }
+
+
+
+  void
+  FTDemo_SDF_File_Release( FTDemo_Handle*    handle,
+                           FTDemo_SDF_Glyph  glyph )
+  {
+    sdf_file_release( handle->sdf_cache, glyph->buffer );
+  }
+
+#endif /* UNIX */
+
+
   unsigned long
   FTDemo_Make_Encoding_Tag( const char*  s )
   {
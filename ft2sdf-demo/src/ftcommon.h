@@ -121,6 +121,7 @@
 
 #define MAX_GLYPHS 512            /* at most 512 glyphs in the string */
 #define MAX_GLYPH_BYTES  150000   /* 150kB for the glyph image cache */
+#define MAX_SDF_BYTES  ( 32L * 1024 * 1024 )  /* 32MB for the SDF cache */
 
 
   typedef struct  TGlyph_
@@ -191,6 +192,139 @@
 
   } FTDemo_String_Context;
 
+  /* a signed distance field, as rendered by `FT_RENDER_MODE_SDF' */
+  typedef struct  FTDemo_SDF_GlyphRec_
+  {
+    FT_UInt    glyph_index;
+
+    int        width;
+    int        rows;
+    int        left;
+    int        top;
+    FT_Vector  advance;    /* 26.6 */
+
+    void*      buffer;     /* `width * rows' distances, NULL for empty */
+                           /* glyphs: 6.10 `FT_Short' values, or       */
+                           /* `FT_Byte' values if `quantized'          */
+
+    void*      mips;       /* levels 1 to `num_mips' of the mip chain, */
+    int        num_mips;   /* one after the other, or NULL             */
+    int        mip_filter;
+
+    FT_Bool    quantized;  /* see `FTDemo_SDF_Quantize'                */
+    FT_UShort  error_max;  /* the quantization error, 6.10             */
+    FT_UShort  error_rms;
+
+    int        spread;     /* the range of the distances, in pixels    */
+
+
+  } FTDemo_SDF_GlyphRec, *FTDemo_SDF_Glyph;
+
+#define SDF_MAX_MIPS  8
+
+  /* how a mip level is computed from 2x2 fields of the previous one */
+  enum {
+    SDF_MIP_BOX = 0,            /* the average distance              */
+    SDF_MIP_MAX,                /* the largest distance, which keeps */
+                                /* thin strokes                      */
+    N_SDF_MIPS
+  };
+
+  /* the SDF equivalent of `FTC_ImageTypeRec' */
+  typedef struct  FTDemo_SDF_TypeRec_
+  {
+    FTC_ScalerRec  scaler;
+    FT_Int32       load_flags;
+
+    FT_Int         spread;
+    FT_Bool        overlaps;
+    FT_Bool        use_bitmap;         /* render via a gray bitmap (bsdf) */
+    FT_Int         flip_y;
+    FT_Bool        quantized;          /* store 8-bit fields             */
+
+  } FTDemo_SDF_TypeRec, *FTDemo_SDF_Type;
+
+  /* a string of distance fields, laid out by `FTDemo_SDF_String_Load' */
+  typedef struct  FTDemo_SDF_StringRec_
+  {
+    int               length;
+    FTDemo_SDF_Glyph  fields[MAX_GLYPHS];   /* NULL for empty glyphs      */
+    FT_Vector         origins[MAX_GLYPHS];  /* bottom left field corners, */
+                                            /* 26.6, y up                 */
+    FT_BBox           bbox;                 /* of all fields              */
+
+  } FTDemo_SDF_StringRec, *FTDemo_SDF_String;
+
+  /* a segment of the skyline of an atlas page */
+  typedef struct  FTDemo_SDF_SkylineRec_
+  {
+    int  x;
+    int  y;                             /* top of the packed area below */
+    int  width;
+
+  } FTDemo_SDF_SkylineRec, *FTDemo_SDF_Skyline;
+
+  typedef struct  FTDemo_SDF_PageRec_
+  {
+    FTDemo_SDF_Skyline  skyline;        /* left to right */
+    int                 num_segments;
+
+    int                 num_glyphs;
+    unsigned long       used;           /* glyph pixels, without padding */
+
+  } FTDemo_SDF_PageRec, *FTDemo_SDF_Page;
+
+  /* fixed-size pages that distance fields are packed into, see */
+  /* `FTDemo_SDF_Atlas_Insert'                                   */
+  typedef struct  FTDemo_SDF_AtlasRec_
+  {
+    int              page_width;
+    int              page_height;
+    int              padding;           /* between fields and around pages */
+
+    FTDemo_SDF_Page  pages;
+    int              num_pages;
+    int              max_pages;
+
+  } FTDemo_SDF_AtlasRec, *FTDemo_SDF_Atlas;
+
+  /* the steps of `FTDemo_SDF_Render' that can be timed */
+  enum {
+    SDF_STEP_LOAD = 0,          /* `FT_Load_Glyph'                   */
+    SDF_STEP_RASTER,            /* rasterizing for the bitmap SDF    */
+    SDF_STEP_SDF,               /* rendering the distance field      */
+    N_SDF_STEPS
+  };
+
+  typedef struct FTDemo_SDF_NodeRec_*  FTDemo_SDF_Node;
+  typedef struct FTDemo_SDF_FileRec_*  FTDemo_SDF_File;
+
+  /* an LRU cache of distance fields, next to the FTC caches */
+  typedef struct  FTDemo_SDF_CacheRec_
+  {
+    FTDemo_SDF_Node*  buckets;
+    FT_UInt           num_buckets;
+    FTDemo_SDF_Node   head;            /* most recently used */
+    FTDemo_SDF_Node   tail;
+
+    FT_ULong          max_bytes;
+    FT_ULong          cur_bytes;
+    FT_UInt           num_nodes;
+
+    FT_ULong          hits;
+    FT_ULong          misses;
+    FT_ULong          evictions;
+
+    FTDemo_SDF_File   file;            /* persistent cache file, if any */
+    FT_ULong          file_hits;
+    FT_ULong          file_writes;
+
+    FT_ULong          prefetches;      /* fields added ahead of time     */
+    FT_ULong          prefetch_hits;   /* ... and looked up later        */
+    FT_ULong          prefetch_bytes;  /* ... and not yet looked up      */
+
+  } FTDemo_SDF_CacheRec, *FTDemo_SDF_Cache;
+
   typedef struct
   {
     FT_Library      library;           /* the FreeType library          */
@@ -198,6 +332,7 @@
     FTC_ImageCache  image_cache;       /* the glyph image cache         */
     FTC_SBitCache   sbits_cache;       /* the glyph small bitmaps cache */
     FTC_CMapCache   cmap_cache;        /* the charmap cache             */
+    FTDemo_SDF_Cache  sdf_cache;       /* the distance field cache      */
 
     PFont*          fonts;             /* installed fonts */
     int             num_fonts;
@@ -389,6 +524,227 @@
                              grColor            color );
 
 
+  /* wall clock time in nanoseconds, monotonic if possible */
+  double
+  FTDemo_Get_Time( void );
+
+
+  /* render a distance field with `face's current size, quantized */
+  /* if `type' says so; the caller owns the returned buffer.  If   */
+  /* `times' isn't NULL, it receives the nanoseconds spent in each */
+  /* of the N_SDF_STEPS steps.                                     */
+  FT_Error
+  FTDemo_SDF_Render( FT_Face           face,
+                     FTDemo_SDF_Type   type,
+                     FT_UInt           gindex,
+                     FTDemo_SDF_Glyph  glyph,
+                     double*           times );
+
+
+  /* Replace the 6.10 distances of `glyph' by 8-bit values, 128 on */
+  /* the outline and 0 and 255 at -`spread' and +`spread'; a value  */
+  /* `q' stands for the distance `(q - 128) * spread / 128'.  The   */
+  /* largest and the root mean square error of the conversion are   */
+  /* stored in the glyph.  Only unmapped buffers can be quantized;  */
+  /* the mip chain, if any, is dropped.                             */
+  FT_Error
+  FTDemo_SDF_Quantize( FTDemo_SDF_Glyph  glyph,
+                       int               spread );
+
+
+  /* get a distance field from the SDF cache or the cache file without */
+  /* rendering it; the field stays valid until the next lookup         */
+  FT_Bool
+  FTDemo_SDF_Cache_Find( FTDemo_Handle*     handle,
+                         FTDemo_SDF_Type    type,
+                         FT_UInt            gindex,
+                         FTDemo_SDF_Glyph*  aglyph );
+
+
+  /* add a distance field rendered elsewhere, e.g., in another thread; */
+  /* the cache takes over its buffer                                   */
+  FT_Error
+  FTDemo_SDF_Cache_Insert( FTDemo_Handle*     handle,
+                           FTDemo_SDF_Type    type,
+                           FTDemo_SDF_Glyph   glyph,
+                           FTDemo_SDF_Glyph*  aglyph );
+
+
+  /* add a distance field that will probably be needed soon; it */
+  /* doesn't displace the most recently used field              */
+  FT_Error
+  FTDemo_SDF_Cache_Prefetch( FTDemo_Handle*    handle,
+                             FTDemo_SDF_Type   type,
+                             FTDemo_SDF_Glyph  glyph );
+
+
+  /* whether the SDF cache or the cache file has a distance field, */
+  /* without counting it as a lookup                               */
+  FT_Bool
+  FTDemo_SDF_Cache_Has( FTDemo_Handle*   handle,
+                        FTDemo_SDF_Type  type,
+                        FT_UInt          gindex );
+
+
+  /* get a distance field from the SDF cache, rendering it on a miss; */
+  /* the field stays valid until the next lookup                      */
+  FT_Error
+  FTDemo_SDF_Cache_Lookup( FTDemo_Handle*     handle,
+                           FTDemo_SDF_Type    type,
+                           FT_UInt            gindex,
+                           FTDemo_SDF_Glyph*  aglyph );
+
+
+  /* keep a field from the SDF cache valid across lookups, e.g., while */
+  /* it is on display; each lock is dropped with a matching unlock     */
+  void
+  FTDemo_SDF_Cache_Lock( FTDemo_Handle*    handle,
+                         FTDemo_SDF_Glyph  glyph );
+
+  void
+  FTDemo_SDF_Cache_Unlock( FTDemo_Handle*    handle,
+                           FTDemo_SDF_Glyph  glyph );
+
+
+  /* Build the mip chain of a field from the SDF cache, unless it */
+  /* exists for `filter'.  Each level has half the width and      */
+  /* height of the previous one, rounded up, and is charged to    */
+  /* the cache with the field.                                    */
+  FT_Error
+  FTDemo_SDF_Cache_Mips( FTDemo_Handle*    handle,
+                         FTDemo_SDF_Glyph  glyph,
+                         int               filter );
+
+
+  /* level `level' of the mip chain of `glyph' as a field of its own; */
+  /* level 0 is `glyph' itself                                        */
+  void
+  FTDemo_SDF_Get_Mip( FTDemo_SDF_Glyph  glyph,
+                      int               level,
+                      FTDemo_SDF_Glyph  amip );
+
+
+  /* Lay out the string set with `FTDemo_String_Set' and get the   */
+  /* distance fields of its glyphs from the SDF cache, rendering    */
+  /* them on a miss.  The positions are relative to the point that  */
+  /* `FTDemo_String_Draw' puts at its `center_x' and `center_y',    */
+  /* with the field pixels as units; the string matrix, extent, and */
+  /* offset are not used, since SDF strings are transformed when    */
+  /* drawn.  The fields are locked in the cache until the string is */
+  /* loaded again or released with `FTDemo_SDF_String_Done'.        */
+  FT_Error
+  FTDemo_SDF_String_Load( FTDemo_Handle*          handle,
+                          FTDemo_SDF_Type         type,
+                          FTDemo_String_Context*  sc,
+                          FTDemo_SDF_String       string );
+
+
+  /* The same without rendering: fields not in the SDF cache are left */
+  /* out of the string, and the indices of their glyphs are listed    */
+  /* once each in `missing', which has room for MAX_GLYPHS entries.   */
+  FT_Error
+  FTDemo_SDF_String_Find( FTDemo_Handle*          handle,
+                          FTDemo_SDF_Type         type,
+                          FTDemo_String_Context*  sc,
+                          FTDemo_SDF_String       string,
+                          FT_UInt*                missing,
+                          FT_Int*                 anum_missing );
+
+
+  /* unlock the fields of a string */
+  void
+  FTDemo_SDF_String_Done( FTDemo_Handle*     handle,
+                          FTDemo_SDF_String  string );
+
+
+  /* set up an empty atlas; pages are allocated as they are needed */
+  void
+  FTDemo_SDF_Atlas_Init( FTDemo_SDF_Atlas  atlas,
+                         int               page_width,
+                         int               page_height,
+                         int               padding );
+
+
+  void
+  FTDemo_SDF_Atlas_Done( FTDemo_SDF_Atlas  atlas );
+
+
+  /* Find a place for a `width' by `rows' field, like the ones of    */
+  /* `FTDemo_SDF_GlyphRec' or an `FT_RENDER_MODE_SDF' bitmap.  Each  */
+  /* page is packed bottom-left along its skyline; the first page    */
+  /* with room is used, and a new one is started if there is none.   */
+  /* Fields already placed never move, so that glyphs can be added   */
+  /* at any time without repacking.  Empty fields take no room and   */
+  /* get page -1; fields larger than a page are an error.  Inserting */
+  /* in order of decreasing height packs tightest.                   */
+  FT_Error
+  FTDemo_SDF_Atlas_Insert( FTDemo_SDF_Atlas  atlas,
+                           int               width,
+                           int               rows,
+                           int*              apage,
+                           int*              ax,
+                           int*              ay );
+
+
+  /* the fraction of `page' covered by fields, or of all pages if */
+  /* `page' is negative                                          */
+  double
+  FTDemo_SDF_Atlas_Occupancy( FTDemo_SDF_Atlas  atlas,
+                              int               page );
+
+
+  /* change the SDF cache budget, evicting glyphs if necessary; */
+  /* a zero budget flushes the cache, even locked glyphs        */
+  void
+  FTDemo_SDF_Cache_Set_Max_Bytes( FTDemo_Handle*  handle,
+                                  FT_ULong        max_bytes );
+
+
+#ifdef UNIX
+
+  /* The cache file is memory-mapped, which is only implemented on */
+  /* UNIX; elsewhere there is no file and its functions are gone.  */
+
+  /* Attach a persistent cache file to the SDF cache, creating it if */
+  /* necessary.  Distance fields found in the file are served        */
+  /* directly from its memory mapping; new ones are appended to it.  */
+  FT_Error
+  FTDemo_SDF_Cache_Open_File( FTDemo_Handle*  handle,
+                              const char*     filepathname );
+
+
+  /* detach and close the cache file, if any */
+  void
+  FTDemo_SDF_Cache_Close_File( FTDemo_Handle*  handle );
+
+
+  /* look up a distance field in the cache file only; the buffer */
+  /* points into a mapping of the file and stays valid until it  */
+  /* is released or the file is closed; if `glyph' is NULL, just */
+  /* check for it                                                */
+  FT_Bool
+  FTDemo_SDF_File_Lookup( FTDemo_Handle*    handle,
+                          FTDemo_SDF_Type   type,
+                          FT_UInt           gindex,
+                          FTDemo_SDF_Glyph  glyph );
+
+
+  /* give back a field from `FTDemo_SDF_File_Lookup', so that the */
+  /* mapping it points into can be dropped                        */
+  void
+  FTDemo_SDF_File_Release( FTDemo_Handle*    handle,
+                           FTDemo_SDF_Glyph  glyph );
+
+
+  /* append a rendered distance field to the cache file */
+  FT_Error
+  FTDemo_SDF_File_Store( FTDemo_Handle*    handle,
+                         FTDemo_SDF_Type   type,
+                         FTDemo_SDF_Glyph  glyph );
+
+#endif /* UNIX */
+
+
   /* make a FT_Encoding tag from a string */
   unsigned long
   FTDemo_Make_Encoding_Tag( const char*  s );
@@ -1,11 +1,15 @@
 
 #include <freetype/ftmodapi.h>
+#include <freetype/fttrigon.h>
 
 #include "ftcommon.h"
+#include "ftworker.h"
 #include "common.h"
 #include "mlgetopt.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 
   typedef FT_Vector  Vec2;
@@ -21,13 +25,13 @@
 
   typedef struct  Status_
   {
-    FT_Face   face;
-
     FT_Int    ptsize;
 
     FT_Int    glyph_index;
 
-    FT_Int    scale;
+    FT_Fixed  zoom;
+
+    FT_Angle  angle;
 
     FT_Int    spread;
 
@@ -37,6 +41,8 @@
 
     FT_Bool   nearest_filtering;
 
+    FT_Int    mipmaps;      /* 0 for none, else the SDF_MIP_XXX filter + 1 */
+
     float     generation_time;
 
     FT_Bool   reconstruct;
@@ -45,159 +51,1192 @@
 
     FT_Bool   overlaps;
 
+    FT_Int    flip_y;
+
     /* params for reconstruction */
 
     float     width;
     float     edge;
 
+    FT_Bool   show_timers;
+
+    FT_Bool   show_string;  /* instead of the glyph */
+
+    FT_Bool   quantized;    /* store and draw 8-bit fields */
+
   } Status;
 
   static FTDemo_Handle*   handle   = NULL;
   static FTDemo_Display*  display  = NULL;
 
+  /* a generated distance field and its place in the atlas */
+  typedef struct  SDF_Glyph_
+  {
+    FTDemo_SDF_GlyphRec  field;
+    FT_Bool              mapped;   /* field comes from the cache file */
+
+    FT_Int               page;     /* -1 for empty glyphs */
+    FT_Int               x;
+    FT_Int               y;
+
+  } SDF_Glyph;
+
+  /* parameters of the headless atlas mode */
+  typedef struct  Atlas_
+  {
+    const char*  filename;     /* NULL for interactive mode */
+    FT_Int       page_width;   /* atlas page size in pixels */
+    FT_Int       page_height;
+
+    FT_Int       first;        /* glyph index range */
+    FT_Int       last;
+    const char*  charset;      /* UTF-8 characters, overrides the range */
+
+    FT_Int       num_threads;  /* 0 means one per processor */
+
+  } Atlas;
+
+  static Atlas  atlas = {
+    /* filename          */ NULL,
+    /* page_width        */ 1024,
+    /* page_height       */ 1024,
+    /* first             */ 0,
+    /* last              */ -1,
+    /* charset           */ NULL,
+    /* num_threads       */ 0
+  };
+
+#define BENCH_MAX_VALUES  32
+
+  /* parameters of the benchmark mode */
+  typedef struct  Bench_
+  {
+    FT_Bool      enabled;
+
+    FT_Int       sizes[BENCH_MAX_VALUES];
+    FT_Int       num_sizes;
+    FT_Int       spreads[BENCH_MAX_VALUES];
+    FT_Int       num_spreads;
+    const char*  sources;      /* `o'utline, `O'utline with overlaps, */
+                               /* `b'itmap                            */
+
+    FT_Int       warmup;       /* runs not measured */
+    FT_Int       runs;
+
+    FT_Bool      json;         /* CSV otherwise */
+    const char*  output;       /* NULL for stdout */
+
+  } Bench;
+
+  static Bench  bench = {
+    /* enabled           */ 0,
+    /* sizes             */ { 16, 32, 64 },
+    /* num_sizes         */ 3,
+    /* spreads           */ { 2, 8 },
+    /* num_spreads       */ 2,
+    /* sources           */ "oOb",
+    /* warmup            */ 1,
+    /* runs              */ 5,
+    /* json              */ 0,
+    /* output            */ NULL
+  };
+
+  /* the fonts benchmarked by default; they live in `bin/', which is */
+  /* also where the executable is built                               */
+  static const char*  bench_fonts[] = {
+    "Roboto-Regular.ttf",
+    "CascadiaCode.ttf"
+  };
+
+#define N_BENCH_FONTS  ( sizeof ( bench_fonts ) / sizeof ( bench_fonts[0] ) )
+
+  static char   bench_paths[N_BENCH_FONTS][1024];
+  static char*  bench_args[N_BENCH_FONTS];
+
+  /* FreeType objects are not thread-safe, so every worker thread */
+  /* gets its own library and face, opened from the font bytes    */
+  /* preloaded by `FTDemo_Install_Font'                           */
+  typedef struct  SDF_Worker_
+  {
+    FT_Library  library;
+    FT_Face     face;
+
+  } SDF_Worker;
+
+  /* a batch of glyphs shared by all workers */
+  typedef struct  SDF_Job_
+  {
+    FTDemo_SDF_TypeRec  type;
+
+    SDF_Worker*  workers;
+    FT_UInt*     indices;
+    SDF_Glyph*   glyphs;
+    FT_Error*    errors;
+    FT_Int*      pending;  /* glyphs not found in the cache file */
+
+  } SDF_Job;
+
+  /* a distance field for the background generator to render */
+  typedef struct  SDF_Request_
+  {
+    FTDemo_SDF_TypeRec  type;
+    FT_UInt             glyph_index;
+
+  } SDF_Request;
+
+  typedef struct  SDF_Result_
+  {
+    SDF_Request          request;
+    FTDemo_SDF_GlyphRec  field;
+    FT_Error             error;
+    double               time;     /* in nanoseconds */
+    double               size_time;
+    double               step_times[N_SDF_STEPS];
+
+  } SDF_Result;
+
+  /* The viewer generates fields in the background so that the window */
+  /* stays responsive; the generator has its own FreeType objects,     */
+  /* just like the atlas workers.                                      */
+  static SDF_Worker     async_worker;
+  static FTWorker_Task  async_task = NULL;
+
+  /* speculative generation of the states that the navigation keys */
+  /* lead to, done by idle threads while the user looks at a glyph */
+  typedef struct  Prefetch_
+  {
+    FT_Int          depth;        /* key presses ahead, 0 to disable  */
+    FT_ULong        max_bytes;    /* for fields not looked at yet     */
+
+    FT_Int          num_tasks;
+    SDF_Worker*     workers;
+    FTWorker_Task*  tasks;
+
+    SDF_Request*    queue;        /* candidates, most likely first */
+    FT_Int          num_queued;
+    FT_Int          next;
+
+    FT_Int          glyph_index;  /* the state of the last plan */
+    FT_Int          ptsize;
+
+  } Prefetch;
+
+  static Prefetch  prefetch = {
+    /* depth             */ 1,
+    /* max_bytes         */ MAX_SDF_BYTES / 4,
+    /* num_tasks         */ 0,
+    /* workers           */ NULL,
+    /* tasks             */ NULL,
+    /* queue             */ NULL,
+    /* num_queued        */ 0,
+    /* next              */ 0,
+    /* glyph_index       */ 0,
+    /* ptsize            */ 0
+  };
+
+  /* the glyph index and size steps of the navigation keys, */
+  /* most frequently used first                             */
+  static const FT_Int  prefetch_steps[][2] = {
+    {   1,  0 },
+    {   0,  1 },
+    {  50,  0 },
+    {   0, 25 },
+    { 500,  0 }
+  };
+
+#define NUM_PREFETCH_STEPS \
+          (FT_Int)( sizeof ( prefetch_steps ) / sizeof ( prefetch_steps[0] ) )
+
+  /*************************************************************************/
+  /*                                                                       */
+  /* Per-phase timing.  Each step of getting a glyph on screen is timed.   */
+  /* The latest PHASE_WINDOW samples of every phase are shown by the `t'   */
+  /* key; option `-T' writes totals and a log2 histogram of all samples    */
+  /* to a file at exit.                                                    */
+  /*                                                                       */
+
+  enum {
+    PHASE_SIZE = 0,             /* `FT_Set_Pixel_Sizes'              */
+    PHASE_LOAD,                 /* `FT_Load_Glyph'                   */
+    PHASE_RASTER,               /* rasterizing for the bitmap SDF    */
+    PHASE_SDF,                  /* rendering the distance field      */
+    PHASE_GENERATE,             /* all of the above, plus copying    */
+    PHASE_CLEAR,                /* `FTDemo_Display_Clear'            */
+    PHASE_DRAW,                 /* `draw'                            */
+    PHASE_HEADER,               /* `write_header'                    */
+    PHASE_REFRESH,              /* `grRefreshSurface'                */
+    PHASE_FRAME,                /* clearing to refreshing            */
+    N_PHASES
+  };
+
+#define PHASE_WINDOW   128
+#define PHASE_BUCKETS  40   /* 2^40ns are 18 minutes */
+
+  typedef struct  Phase_
+  {
+    double         window[PHASE_WINDOW];    /* latest samples, in ns */
+    FT_Int         next;
+    FT_Int         num_window;
+
+    unsigned long  count;
+    double         total;
+    double         min;
+    double         max;
+    unsigned long  buckets[PHASE_BUCKETS];  /* [2^n,2^(n+1)) ns */
+
+  } Phase;
+
+  static Phase  phases[N_PHASES];
+
+  static const char*  phase_names[N_PHASES] = {
+    "size", "load", "raster", "sdf", "generate",
+    "clear", "draw", "header", "refresh", "frame"
+  };
+
+  static const char*  timing_file = NULL;
+
   static Status status = { 
-    /* face              */ NULL,
     /* ptsize            */ 256,
     /* glyph_index       */ 0,
-    /* scale             */ 1,
+    /* zoom              */ 0x10000L,
+    /* angle             */ 0,
     /* spread            */ 4,
     /* x_offset          */ 0,
     /* y_offset          */ 0,
     /* nearest_filtering */ 0,
+    /* mipmaps           */ 1 + SDF_MIP_BOX,
     /* generation_time   */ 0.0f,
     /* reconstruct       */ 0,
     /* use_bitmap        */ 0,
     /* overlaps          */ 0,
+    /* flip_y            */ 0,
     /* width             */ 0.0f,
-    /* edge              */ 0.4f
+    /* edge              */ 0.4f,
+    /* show_timers       */ 0,
+    /* show_string       */ 0,
+    /* quantized         */ 0
+  };
+
+  /* the field currently on display, owned by the cache and locked */
+  /* in it so that no lookup evicts it while it is shown           */
+  static FTDemo_SDF_Glyph  current = NULL;
+
+  /* the string shown by the `n' key, its fields locked in the cache */
+  static const char*            sdf_text   = "The quick brown fox jumps "
+                                             "over the lazy dog";
+  static FTDemo_SDF_StringRec   sdf_string;
+  static FT_UInt                sdf_serial = 0;  /* changes with every load */
+
+  /* The next string, while the generator renders the fields that  */
+  /* weren't in the cache, one after the other; the fields found   */
+  /* and those rendered so far stay locked until it replaces       */
+  /* `sdf_string'.                                                 */
+  static FTDemo_SDF_StringRec   sdf_next;
+  static FTDemo_SDF_TypeRec     sdf_next_type;
+  static double                 sdf_next_start;
+  static FT_UInt                sdf_missing[MAX_GLYPHS];
+  static FT_Int                 sdf_num_missing = 0;   /* 0: no next string */
+  static FTDemo_SDF_Glyph       sdf_done[MAX_GLYPHS];  /* NULL on error     */
+  static FT_Int                 sdf_num_done    = 0;
+
+  static FTDemo_String_Context  sdf_context = {
+    /* kerning_mode      */ KERNING_MODE_NORMAL,
+    /* kerning_degree    */ KERNING_DEGREE_NONE,
+    /* center            */ 0x8000L,
+    /* vertical          */ 0,
+    /* matrix            */ NULL,
+    /* extent            */ 0,
+    /* offset            */ 0
+  };
+
+  /* the name of the `draw' kernel in use */
+  static const char*  draw_kernel = "scalar";
+
+  static const char*  mip_names[N_SDF_MIPS + 1] = {
+    "Off", "Box", "Max"
   };
 
+  /* `draw' splits the display into bands of rows for these threads */
+#define DRAW_BAND_ROWS  16
+
+  static FT_Int         draw_threads = 0;      /* 0: one per processor */
+  static FTWorker_Pool  draw_pool    = NULL;
+
+  /* what the display currently shows */
+  typedef struct  Frame_
+  {
+    FT_Bool           valid;     /* 0 forces a full redraw */
+
+    FTDemo_SDF_Glyph  field;
+    FT_UInt           string;    /* `sdf_serial', 0 for the glyph */
+    FT_Fixed          zoom;
+    FT_Angle          angle;
+    FT_Int            spread;
+    FT_Bool           nearest_filtering;
+    FT_Int            mipmaps;
+    FT_Bool           reconstruct;
+    float             width;
+    float             edge;
+    FT_Int            x_offset;
+    FT_Int            y_offset;
+
+    Box               region;       /* the field's pixels         */
+    FT_Int            header_rows;  /* the pixel rows of the text */
+
+  } Frame;
+
+  static Frame  frame;
+
+  static int
+  compare_times( const void*  a,
+                 const void*  b )
+  {
+    double  ta = *(const double*)a;
+    double  tb = *(const double*)b;
+
+
+    return ta < tb ? -1 : ta > tb;
+  }
+
+
+  /* nearest-rank percentile of sorted samples */
+  static double
+  percentile( const double*  samples,
+              FT_Int         count,
+              FT_Int         percent )
+  {
+    FT_Int  rank = ( count * percent + 99 ) / 100;
+
+
+    return samples[rank > 0 ? rank - 1 : 0];
+  }
+
+
+  static void
+  phase_record( FT_Int  id,
+                double  time )
+  {
+    Phase*  phase = phases + id;
+    double  limit = 2;
+    FT_Int  n;
+
+
+    phase->window[phase->next] = time;
+    phase->next                = ( phase->next + 1 ) % PHASE_WINDOW;
+    if ( phase->num_window < PHASE_WINDOW )
+      phase->num_window++;
+
+    if ( !phase->count || time < phase->min )
+      phase->min = time;
+    if ( time > phase->max )
+      phase->max = time;
+
+    phase->count++;
+    phase->total += time;
+
+    for ( n = 0; n < PHASE_BUCKETS - 1 && time >= limit; n++ )
+      limit *= 2;
+    phase->buckets[n]++;
+  }
+
+
+  /* record the time since `start' and return the current time */
+  static double
+  phase_end( FT_Int  id,
+             double  start )
+  {
+    double  now = FTDemo_Get_Time();
+
+
+    phase_record( id, now - start );
+
+    return now;
+  }
+
+
+  static void
+  phase_dump( const char*  filename )
+  {
+    FILE*   file = fopen( filename, "w" );
+    double  limit;
+    FT_Int  id, n;
+
+
+    if ( !file )
+    {
+      fprintf( stderr, "could not open `%s' for writing\n", filename );
+      return;
+    }
+
+    fprintf( file, "%-10s %8s %12s %10s %10s %10s\n",
+             "phase", "count", "total (ms)", "mean (ms)",
+             "min (ms)", "max (ms)" );
+
+    for ( id = 0; id < N_PHASES; id++ )
+      fprintf( file, "%-10s %8lu %12.3f %10.3f %10.3f %10.3f\n",
+               phase_names[id], phases[id].count,
+               phases[id].total / 1E6,
+               phases[id].count ? phases[id].total / phases[id].count / 1E6
+                                : 0.0,
+               phases[id].min / 1E6, phases[id].max / 1E6 );
+
+    for ( id = 0; id < N_PHASES; id++ )
+    {
+      if ( !phases[id].count )
+        continue;
+
+      fprintf( file, "\n%s (ns: samples)\n", phase_names[id] );
+
+      for ( n = 0, limit = 1; n < PHASE_BUCKETS; n++, limit *= 2 )
+        if ( phases[id].buckets[n] )
+          fprintf( file, "  %.0f-%.0f: %lu\n",
+                   n ? limit : 0.0, 2 * limit - 1, phases[id].buckets[n] );
+    }
+
+    fclose( file );
+  }
+
+
+  /* the recent timings, below the header */
+  static void
+  write_timers( int  line )
+  {
+    char    buffer[128];
+    double  sorted[PHASE_WINDOW];
+    FT_Int  id;
+
+
+    grWriteCellString( display->bitmap, 0, line++ * HEADER_HEIGHT,
+                       "Phase (ms)     last   median      p95      max",
+                       display->fore_color );
+
+    for ( id = 0; id < N_PHASES; id++ )
+    {
+      Phase*  phase = phases + id;
+      FT_Int  count = phase->num_window;
+
+
+      if ( !count )
+        continue;
+
+      memcpy( sorted, phase->window, (size_t)count * sizeof ( double ) );
+      qsort( sorted, (size_t)count, sizeof ( double ), compare_times );
+
+      sprintf( buffer, "%-10s %8.2f %8.2f %8.2f %8.2f",
+               phase_names[id],
+               phase->window[( phase->next + PHASE_WINDOW - 1 ) %
+                               PHASE_WINDOW] / 1E6,
+               percentile( sorted, count, 50 ) / 1E6,
+               percentile( sorted, count, 95 ) / 1E6,
+               sorted[count - 1] / 1E6 );
+      grWriteCellString( display->bitmap, 0, line++ * HEADER_HEIGHT,
+                         buffer, display->fore_color );
+    }
+  }
+
+
+  /* The mip level of `field' for the current zoom, the one whose */
+  /* pixels are closest in size to the display pixels; 0 until   */
+  /* `draw' has built the chain.                                  */
+  static FT_Int
+  draw_mip_level( FTDemo_SDF_Glyph  field )
+  {
+    FT_Int  level = 0;
+
+
+    if ( status.mipmaps && field->mip_filter == status.mipmaps - 1 )
+      while ( level < field->num_mips                        &&
+              ( status.zoom << ( level + 1 ) ) <= 0x16A0AL   )  /* sqrt(2) */
+        level++;
+
+    return level;
+  }
+
+
+  /* bytes per pixel of the display surface */
+  static FT_Int
+  display_bytes( void )
+  {
+    switch ( display->bitmap->mode )
+    {
+    case gr_pixel_mode_gray:
+      return 1;
+    case gr_pixel_mode_rgb32:
+      return 4;
+    default:
+      return 3;
+    }
+  }
+
+
+  /* the height of the header band in pixels */
+  static FT_Int
+  header_rows( void )
+  {
+    return ( status.show_timers ? 9 + N_PHASES : 7 ) * HEADER_HEIGHT;
+  }
+
+
   static void
   write_header()
   {
-    static char   header_string[512];
+    static char       header_string[512];
+    char              storage[64];
+    FTDemo_SDF_Glyph  field = current;
+    FT_Int            n;
 
-    sprintf( header_string, "Glyph Index: %d, Pt Size: %d, Spread: %d, Scale: %d",
-             status.glyph_index, status.ptsize, status.spread, status.scale );
+
+    /* the mip level and storage of the first glyph of a string */
+    if ( status.show_string )
+      for ( field = NULL, n = 0; !field && n < sdf_string.length; n++ )
+        field = sdf_string.fields[n];
+
+    if ( status.show_string )
+      sprintf( header_string, "String: %d glyphs, Pt Size: %d, Spread: %d, Zoom: %.2f, Angle: %ld",
+               sdf_string.length, status.ptsize, status.spread,
+               status.zoom / 65536.0, status.angle >> 16 );
+    else
+      sprintf( header_string, "Glyph Index: %d, Pt Size: %d, Spread: %d, Zoom: %.2f, Angle: %ld",
+               status.glyph_index, status.ptsize, status.spread,
+               status.zoom / 65536.0, status.angle >> 16 );
     grWriteCellString( display->bitmap, 0, 0, header_string, display->fore_color );
 
     sprintf( header_string, "Position Offset: %d,%d", status.x_offset, status.y_offset );
     grWriteCellString( display->bitmap, 0, 1 * HEADER_HEIGHT, header_string, display->fore_color );
 
-    sprintf( header_string, "SDF Generated in: %.0f ms, From: %s", status.generation_time,
-             status.use_bitmap ? "Bitmap" : "Outline" );
+    if ( field && field->quantized )
+      sprintf( storage, "8-bit (error max %.4f, rms %.4f px)",
+               field->error_max / 1024.0, field->error_rms / 1024.0 );
+    else
+      sprintf( storage, "16-bit" );
+
+    sprintf( header_string, "SDF Generated in: %.0f ms, From: %s, Storage: %s%s", status.generation_time,
+             status.use_bitmap ? "Bitmap" : "Outline", storage,
+             async_task && FTWorker_Task_Busy( async_task ) ? " (generating...)" : "" );
     grWriteCellString( display->bitmap, 0, 2 * HEADER_HEIGHT, header_string, display->fore_color );
 
-    sprintf( header_string, "Filtering: %s, View: %s", status.nearest_filtering ? "Nearest" : "Bilinear",
-                                                       status.reconstruct ? "Reconstructing": "Raw" );
+    sprintf( header_string, "Cache: %lu hits, %lu misses (%lu from file), %lu evictions, %u glyphs, %lu/%lu kB",
+             handle->sdf_cache->hits, handle->sdf_cache->misses,
+             handle->sdf_cache->file_hits,
+             handle->sdf_cache->evictions, handle->sdf_cache->num_nodes,
+             handle->sdf_cache->cur_bytes >> 10,
+             handle->sdf_cache->max_bytes >> 10 );
     grWriteCellString( display->bitmap, 0, 3 * HEADER_HEIGHT, header_string, display->fore_color );
 
+    if ( prefetch.num_tasks )
+    {
+      FTDemo_SDF_Cache  cache = handle->sdf_cache;
+
+
+      sprintf( header_string, "Prefetch: depth %d, %lu generated, %lu used (%.0f%%), %lu/%lu kB unused",
+               prefetch.depth, cache->prefetches, cache->prefetch_hits,
+               cache->prefetches ? 100.0 * cache->prefetch_hits / cache->prefetches : 0.0,
+               cache->prefetch_bytes >> 10, prefetch.max_bytes >> 10 );
+      grWriteCellString( display->bitmap, 0, 4 * HEADER_HEIGHT, header_string, display->fore_color );
+    }
+
+    sprintf( header_string, "Filtering: %s, Mipmaps: %s (level %d), View: %s, Kernel: %s x %d",
+                                                                        status.nearest_filtering ? "Nearest" : "Bilinear",
+                                                                        mip_names[status.mipmaps],
+                                                                        field ? draw_mip_level( field ) : 0,
+                                                                        status.reconstruct ? "Reconstructing": "Raw",
+                                                                        draw_kernel,
+                                                                        draw_pool ? FTWorker_Pool_Size( draw_pool ) : 1 );
+    grWriteCellString( display->bitmap, 0, 5 * HEADER_HEIGHT, header_string, display->fore_color );
+
     if ( status.reconstruct )
     {
       sprintf( header_string, "Width: %.2f, Edge: %.2f", status.width, status.edge );
-      grWriteCellString( display->bitmap, 0, 4 * HEADER_HEIGHT, header_string, display->fore_color );
+      grWriteCellString( display->bitmap, 0, 6 * HEADER_HEIGHT, header_string, display->fore_color );
     }
+
+    if ( status.show_timers )
+      write_timers( 8 );
   }
 
-  static FT_Error
-  event_font_update()
+  /* the SDF cache type of the current state at size `ptsize'; */
+  /* the handle's own size is left alone                       */
+  static void
+  sdf_state_type( FTDemo_SDF_Type  type,
+                  FT_Int           ptsize )
   {
-    FT_Error  error = FT_Err_Ok;
-    clock_t   start, end;
+    type->scaler        = handle->scaler;
+    type->scaler.width  = (FT_UInt)ptsize;
+    type->scaler.height = (FT_UInt)ptsize;
+    type->scaler.pixel  = 1;
+    type->scaler.x_res  = 0;
+    type->scaler.y_res  = 0;
 
-    FT_CALL( FT_Property_Set( handle->library, "bsdf", "spread", &status.spread ) );
-    FT_CALL( FT_Property_Set( handle->library, "sdf", "spread", &status.spread ) );
-    FT_CALL( FT_Property_Set( handle->library, "sdf", "overlaps", &status.overlaps ) );
+    type->load_flags = FT_LOAD_DEFAULT;
+    type->spread     = status.spread;
+    type->overlaps   = status.overlaps;
+    type->use_bitmap = status.use_bitmap;
+    type->flip_y     = status.flip_y;
+    type->quantized  = status.quantized;
+  }
+
+
+  /* the same for the current size, which also becomes the */
+  /* handle's, rounded to a strike for bitmap fonts         */
+  static void
+  sdf_current_type( FTDemo_SDF_Type  type )
+  {
+    FTDemo_Set_Current_Size( handle, status.ptsize );
 
-    FT_CALL( FT_Set_Pixel_Sizes( status.face, 0, status.ptsize ) );
-    FT_CALL( FT_Load_Glyph( status.face, status.glyph_index, FT_LOAD_DEFAULT ) );
+    sdf_state_type( type, status.ptsize );
+    type->scaler = handle->scaler;
+  }
 
-    start = clock();
 
-    if ( status.use_bitmap )
-      FT_CALL( FT_Render_Glyph( status.face->glyph, FT_RENDER_MODE_NORMAL ) );
-    FT_CALL( FT_Render_Glyph( status.face->glyph, FT_RENDER_MODE_SDF ) );
+  static void*
+  sdf_async_generate( FTWorker_Task  task,
+                      unsigned long  serial,
+                      const void*    data,
+                      void*          user )
+  {
+    const SDF_Request*  request = (const SDF_Request*)data;
+    SDF_Worker*         worker  = (SDF_Worker*)user;
+    SDF_Result*         result;
+    double              start   = FTDemo_Get_Time();
 
-    end = clock();
 
-    status.generation_time = ( (float)( end - start ) / (float)CLOCKS_PER_SEC ) * 1000.0f;
+    result = (SDF_Result*)calloc( 1, sizeof ( SDF_Result ) );
+    if ( !result )
+      return NULL;
 
-    printf( "Generation Time: %.0f ms\n", status.generation_time );
+    result->request   = *request;
+    result->error     = FT_Set_Pixel_Sizes( worker->face,
+                                            request->type.scaler.width,
+                                            request->type.scaler.height );
+    result->size_time = FTDemo_Get_Time() - start;
 
-  Exit:
-    return error;
+    /* `FT_Render_Glyph' can't be interrupted, so this */
+    /* is the last chance to skip outdated requests    */
+    if ( !FTWorker_Task_Is_Current( task, serial ) )
+    {
+      free( result );
+      return NULL;
+    }
+
+    if ( !result->error )
+      result->error = FTDemo_SDF_Render( worker->face,
+                                         &result->request.type,
+                                         request->glyph_index,
+                                         &result->field,
+                                         result->step_times );
+
+    result->time = FTDemo_Get_Time() - start;
+
+    return result;
   }
 
+
   static void
-  event_color_change()
+  sdf_async_free( void*  data,
+                  void*  user )
   {
-    display->back_color = grFindColor( display->bitmap,  0,  0,  0, 0xff );
-    display->fore_color = grFindColor( display->bitmap, 255, 255, 255, 0xff );
-    display->warn_color = grFindColor( display->bitmap,  0, 255, 255, 0xff );
+    SDF_Result*  result = (SDF_Result*)data;
+
+    FT_UNUSED( user );
+
+
+    free( result->field.buffer );
+    free( result );
   }
 
+
+  /* put another field from the cache on display */
   static void
-  event_help()
+  sdf_set_current( FTDemo_SDF_Glyph  field )
   {
-    char     buffer[512];
-    grEvent  dummy;
+    if ( field == current )
+      return;
 
-    display->back_color = grFindColor( display->bitmap, 30, 30, 30, 0xff );
-    FTDemo_Display_Clear( display );
-    display->back_color = grFindColor( display->bitmap,  0,  0,  0, 0xff );
+    if ( field )
+      FTDemo_SDF_Cache_Lock( handle, field );
+    if ( current )
+      FTDemo_SDF_Cache_Unlock( handle, current );
 
-    grSetLineHeight( 10 );
-    grGotoxy( 0, 0 );
-    grSetMargin( 2, 1 );
-    grGotobitmapColor( display->bitmap, 204, 153, 204, 255 );
+    current = field;
+  }
 
-    grWriteln( "Signed Distnace Field Viewer" );
-    grLn();
-    grWriteln( "Use the following keys:" );
-    grWriteln( "-----------------------" );
-    grLn();
-    grWriteln( "  F1 or ? or /       : display this help screen" );
-    grLn();
-    grWriteln( "  b                  : Toggle between bitmap/outline to be used for generating" );
-    grLn();
-    grWriteln( "  z, x               : Zoom/Scale Up and Down" );
-    grLn();
-    grWriteln( "  Up, Down Arrow     : Adjust glyph's point size by 1" );
-    grWriteln( "  PgUp, PgDn         : Adjust glyph's point size by 25" );
-    grLn();
-    grWriteln( "  Left, Right Arrow  : Adjust glyph index by 1" );
-    grWriteln( "  F5, F6             : Adjust glyph index by 50" );
-    grWriteln( "  F7, F8             : Adjust glyph index by 500" );
-    grLn();
-    grWriteln( "  o, l               : Adjust spread size by 1" );
-    grLn();
-    grWriteln( "  w, s               : Move glyph Up/Down" );
-    grWriteln( "  a, d               : Move glyph Left/right" );
-    grLn();
-    grWriteln( "  f                  : Toggle between bilinear/nearest filtering" );
-    grLn();
-    grWriteln( "  m                  : Toggle overlapping support" );
-    grLn();
-    grWriteln( "Reconstructing Image from SDF" );
-    grWriteln( "-----------------------------" );
-    grWriteln( "  r                  : Toggle between reconstruction/raw view" );
-    grWriteln( "  i, k               : Adjust width by 1 (makes the text bolder/thinner)" );
-    grWriteln( "  u, j               : Adjust edge by 1 (makes the text smoother/sharper)" );
-    grLn();
-    grWriteln( "press any key to exit this help screen" );
 
-    grRefreshSurface( display->surface );
-    grListenSurface( display->surface, gr_event_key, &dummy );
+  /* drop the next string and its fields */
+  static void
+  sdf_next_done( void )
+  {
+    FT_Int  n;
+
+
+    for ( n = 0; n < sdf_num_done; n++ )
+      if ( sdf_done[n] )
+        FTDemo_SDF_Cache_Unlock( handle, sdf_done[n] );
+
+    FTDemo_SDF_String_Done( handle, &sdf_next );
+
+    sdf_num_missing = 0;
+    sdf_num_done    = 0;
   }
 
+
+  /* request the next missing field, or show the string when */
+  /* there is none left                                      */
+  static void
+  sdf_next_step( void )
+  {
+    SDF_Request  request;
+    FT_UInt      failed[MAX_GLYPHS];
+    FT_Int       num_failed;
+    FT_Error     error;
+
+
+    if ( sdf_num_done < sdf_num_missing )
+    {
+      request.type        = sdf_next_type;
+      request.glyph_index = sdf_missing[sdf_num_done];
+
+      FTWorker_Task_Post( async_task, &request );
+      return;
+    }
+
+    /* all fields are locked in the cache now, except for the */
+    /* glyphs that failed, which just keep their place         */
+    error = FTDemo_SDF_String_Find( handle, &sdf_next_type, &sdf_context,
+                                    &sdf_string, failed, &num_failed );
+    if ( error )
+      printf( "FreeType error: %s\n", FT_Error_String( error ) );
+
+    sdf_next_done();
+    sdf_serial++;
+
+    status.generation_time = (float)( ( FTDemo_Get_Time() -
+                                        sdf_next_start ) / 1E6 );
+
+    printf( "Generation Time: %.0f ms\n", status.generation_time );
+  }
+
+
+  /* pick up a finished field; return 1 if there was one */
+  static int
+  sdf_async_update( void )
+  {
+    SDF_Result*       result;
+    FTDemo_SDF_Glyph  field = NULL;
+
+
+    if ( !async_task )
+      return 0;
+
+    result = (SDF_Result*)FTWorker_Task_Take_Result( async_task );
+    if ( !result )
+      return 0;
+
+    if ( !result->error )
+      result->error = FTDemo_SDF_Cache_Insert( handle,
+                                               &result->request.type,
+                                               &result->field,
+                                               &field );
+    if ( result->error )
+    {
+      printf( "FreeType error: %s [glyph %u]\n",
+              FT_Error_String( result->error ),
+              result->request.glyph_index );
+      free( result->field.buffer );
+      field = NULL;
+    }
+    else
+    {
+      phase_record( PHASE_SIZE, result->size_time );
+      phase_record( PHASE_LOAD, result->step_times[SDF_STEP_LOAD] );
+      if ( result->request.type.use_bitmap )
+        phase_record( PHASE_RASTER, result->step_times[SDF_STEP_RASTER] );
+      phase_record( PHASE_SDF, result->step_times[SDF_STEP_SDF] );
+      phase_record( PHASE_GENERATE, result->time );
+    }
+
+    /* a field of the next string waits for the others */
+    if ( sdf_num_missing )
+    {
+      if ( field )
+        FTDemo_SDF_Cache_Lock( handle, field );
+      sdf_done[sdf_num_done++] = field;
+
+      sdf_next_step();
+    }
+    else if ( field )
+    {
+      sdf_set_current( field );
+
+      status.generation_time = (float)( result->time / 1E6 );
+
+      printf( "Generation Time: %.0f ms\n", status.generation_time );
+    }
+
+    free( result );
+
+    return 1;
+  }
+
+
+  static void
+  prefetch_add( FT_Int  glyph_index,
+                FT_Int  ptsize,
+                FT_Int  num_glyphs )
+  {
+    SDF_Request*  request;
+    FT_Int        n;
+
+
+    /* the same limits as the navigation keys */
+    if ( glyph_index < 0 || glyph_index >= num_glyphs ||
+         ptsize < 8      || ptsize > 512              )
+      return;
+
+    for ( n = 0; n < prefetch.num_queued; n++ )
+      if ( prefetch.queue[n].glyph_index == (FT_UInt)glyph_index     &&
+           prefetch.queue[n].type.scaler.height == (FT_UInt)ptsize )
+        return;
+
+    request = prefetch.queue + prefetch.num_queued++;
+
+    sdf_state_type( &request->type, ptsize );
+    request->glyph_index = (FT_UInt)glyph_index;
+  }
+
+
+  /* queue the states that the next key presses probably lead to; */
+  /* repeating the last step is the most likely one               */
+  static void
+  prefetch_plan( void )
+  {
+    FT_Face  face;
+    FT_Int   glyph_step = status.glyph_index - prefetch.glyph_index;
+    FT_Int   size_step  = status.ptsize      - prefetch.ptsize;
+    FT_Int   k, n;
+
+
+    if ( !prefetch.num_tasks )
+      return;
+
+    prefetch.num_queued  = 0;
+    prefetch.next        = 0;
+    prefetch.glyph_index = status.glyph_index;
+    prefetch.ptsize      = status.ptsize;
+
+    if ( FTC_Manager_LookupFace( handle->cache_manager,
+                                 handle->scaler.face_id, &face ) )
+      return;
+
+    if ( ( glyph_step || size_step )                   &&
+         abs( glyph_step ) <= 500 && abs( size_step ) <= 25 )
+      prefetch_add( status.glyph_index + glyph_step,
+                    status.ptsize + size_step,
+                    (FT_Int)face->num_glyphs );
+
+    for ( k = 1; k <= prefetch.depth; k++ )
+      for ( n = 0; n < NUM_PREFETCH_STEPS; n++ )
+      {
+        prefetch_add( status.glyph_index + k * prefetch_steps[n][0],
+                      status.ptsize      + k * prefetch_steps[n][1],
+                      (FT_Int)face->num_glyphs );
+        prefetch_add( status.glyph_index - k * prefetch_steps[n][0],
+                      status.ptsize      - k * prefetch_steps[n][1],
+                      (FT_Int)face->num_glyphs );
+      }
+  }
+
+
+  /* collect prefetched fields and feed the idle threads; */
+  /* return a busy thread to wait for, if any              */
+  static FTWorker_Task
+  prefetch_update( void )
+  {
+    FTWorker_Task  busy = NULL;
+    FT_Int         n;
+
+
+    for ( n = 0; n < prefetch.num_tasks; n++ )
+    {
+      FTWorker_Task  task   = prefetch.tasks[n];
+      SDF_Result*    result = (SDF_Result*)FTWorker_Task_Take_Result( task );
+
+
+      if ( result )
+      {
+        if ( result->error                                              ||
+             FTDemo_SDF_Cache_Prefetch( handle, &result->request.type,
+                                        &result->field )                )
+          free( result->field.buffer );
+        free( result );
+      }
+
+      /* the field on display comes first */
+      while ( !FTWorker_Task_Busy( task )                                &&
+              !FTWorker_Task_Busy( async_task )                          &&
+              handle->sdf_cache->prefetch_bytes < prefetch.max_bytes     &&
+              prefetch.next < prefetch.num_queued                        )
+      {
+        SDF_Request*  request = prefetch.queue + prefetch.next++;
+
+
+        if ( !FTDemo_SDF_Cache_Has( handle, &request->type,
+                                    request->glyph_index ) )
+          FTWorker_Task_Post( task, request );
+      }
+
+      if ( !busy && FTWorker_Task_Busy( task ) )
+        busy = task;
+    }
+
+    return busy;
+  }
+
+
+  static FT_Error
+  event_font_update()
+  {
+    FT_Error          error = FT_Err_Ok;
+    SDF_Request       request;
+    FTDemo_SDF_Glyph  field;
+    double            start;
+
+
+    sdf_current_type( &request.type );
+    request.glyph_index = (FT_UInt)status.glyph_index;
+
+    /* the string on display stays until the next one is complete */
+    sdf_next_done();
+
+    if ( status.show_string )
+    {
+      start = FTDemo_Get_Time();
+
+      FTDemo_String_Set( handle, sdf_text );
+
+      if ( !async_task )
+      {
+        FT_CALL( FTDemo_SDF_String_Load( handle, &request.type,
+                                         &sdf_context, &sdf_string ) );
+        sdf_serial++;
+
+        status.generation_time = (float)( ( FTDemo_Get_Time() - start ) /
+                                          1E6 );
+        goto Exit;
+      }
+
+      /* a glyph being generated isn't wanted anymore */
+      FTWorker_Task_Cancel( async_task );
+
+      FT_CALL( FTDemo_SDF_String_Find( handle, &request.type, &sdf_context,
+                                       &sdf_next, sdf_missing,
+                                       &sdf_num_missing ) );
+
+      sdf_next_type  = request.type;
+      sdf_next_start = start;
+
+      sdf_next_step();
+      goto Exit;
+    }
+
+    /* give the string's fields back to the cache */
+    FTDemo_SDF_String_Done( handle, &sdf_string );
+
+    if ( FTDemo_SDF_Cache_Find( handle, &request.type,
+                                request.glyph_index, &field ) )
+    {
+      sdf_set_current( field );
+
+      /* nothing else to show anymore */
+      if ( async_task )
+        FTWorker_Task_Cancel( async_task );
+
+      prefetch_plan();
+      goto Exit;
+    }
+
+    /* keep showing the current field until the new one is ready */
+    if ( async_task )
+    {
+      FTWorker_Task_Post( async_task, &request );
+
+      prefetch_plan();
+      goto Exit;
+    }
+
+    start = FTDemo_Get_Time();
+
+    FT_CALL( FTDemo_SDF_Cache_Lookup( handle, &request.type,
+                                      request.glyph_index,
+                                      &field ) );
+    sdf_set_current( field );
+
+    start = FTDemo_Get_Time() - start;
+    phase_record( PHASE_GENERATE, start );
+
+    status.generation_time = (float)( start / 1E6 );
+
+    printf( "Generation Time: %.0f ms\n", status.generation_time );
+
+  Exit:
+    return error;
+  }
+
+  static void
+  event_color_change()
+  {
+    display->back_color = grFindColor( display->bitmap,  0,  0,  0, 0xff );
+    display->fore_color = grFindColor( display->bitmap, 255, 255, 255, 0xff );
+    display->warn_color = grFindColor( display->bitmap,  0, 255, 255, 0xff );
+  }
+
+  static void
+  event_help()
+  {
+    char     buffer[512];
+    grEvent  dummy;
+
+    display->back_color = grFindColor( display->bitmap, 30, 30, 30, 0xff );
+    FTDemo_Display_Clear( display );
+    display->back_color = grFindColor( display->bitmap,  0,  0,  0, 0xff );
+
+    grSetLineHeight( 10 );
+    grGotoxy( 0, 0 );
+    grSetMargin( 2, 1 );
+    grGotobitmapColor( display->bitmap, 204, 153, 204, 255 );
+
+    grWriteln( "Signed Distnace Field Viewer" );
+    grLn();
+    grWriteln( "Use the following keys:" );
+    grWriteln( "-----------------------" );
+    grLn();
+    grWriteln( "  F1 or ? or /       : display this help screen" );
+    grLn();
+    grWriteln( "  b                  : Toggle between bitmap/outline to be used for generating" );
+    grLn();
+    grWriteln( "  z, x               : Zoom in and out by a factor of 2^(1/4)" );
+    grWriteln( "  c, v               : Rotate by 15 degrees counter-/clockwise" );
+    grLn();
+    grWriteln( "  Up, Down Arrow     : Adjust glyph's point size by 1" );
+    grWriteln( "  PgUp, PgDn         : Adjust glyph's point size by 25" );
+    grLn();
+    grWriteln( "  Left, Right Arrow  : Adjust glyph index by 1" );
+    grWriteln( "  F5, F6             : Adjust glyph index by 50" );
+    grWriteln( "  F7, F8             : Adjust glyph index by 500" );
+    grLn();
+    grWriteln( "  o, l               : Adjust spread size by 1" );
+    grLn();
+    grWriteln( "  w, s               : Move glyph Up/Down" );
+    grWriteln( "  a, d               : Move glyph Left/right" );
+    grLn();
+    grWriteln( "  f                  : Toggle between bilinear/nearest filtering" );
+    grWriteln( "  g                  : Cycle through box/max/no mipmaps for zoom < 1" );
+    grLn();
+    grWriteln( "  m                  : Toggle overlapping support" );
+    grWriteln( "  e                  : Toggle between 16-bit and 8-bit fields" );
+    grLn();
+    grWriteln( "  t                  : Toggle the timings of the drawing phases" );
+    grWriteln( "  n                  : Toggle between the glyph and the string" );
+    grLn();
+    grWriteln( "Reconstructing Image from SDF" );
+    grWriteln( "-----------------------------" );
+    grWriteln( "  r                  : Toggle between reconstruction/raw view" );
+    grWriteln( "  i, k               : Adjust width by 1 (makes the text bolder/thinner)" );
+    grWriteln( "  u, j               : Adjust edge by 1 (makes the text smoother/sharper)" );
+    grLn();
+    grWriteln( "press any key to exit this help screen" );
+
+    grRefreshSurface( display->surface );
+    grListenSurface( display->surface, gr_event_key, &dummy );
+
+    frame.valid = 0;
+  }
+
+  /* zoom levels are powers of 2^(1/4), from 1/8 to 64 */
+#define ZOOM_LEVEL_MIN  -12
+#define ZOOM_LEVEL_MAX   24
+
+  static FT_Fixed
+  zoom_level( FT_Int  level )
+  {
+    static const FT_Fixed  steps[4] = { 0x10000L, 0x1306FL,
+                                        0x16A0AL, 0x1AE8AL };
+
+    FT_Int  n = level - ZOOM_LEVEL_MIN;
+
+
+    return ( steps[n & 3] << ( n >> 2 ) ) >> ( -ZOOM_LEVEL_MIN / 4 );
+  }
+
+
+  /* the zoom `delta' levels away from the level nearest to `zoom' */
+  static FT_Fixed
+  zoom_step( FT_Fixed  zoom,
+             FT_Int    delta )
+  {
+    FT_Int  level, nearest = 0;
+
+
+    for ( level = ZOOM_LEVEL_MIN; level <= ZOOM_LEVEL_MAX; level++ )
+      if ( labs( zoom_level( level ) - zoom ) <
+           labs( zoom_level( nearest ) - zoom ) )
+        nearest = level;
+
+    nearest += delta;
+    if ( nearest < ZOOM_LEVEL_MIN )
+      nearest = ZOOM_LEVEL_MIN;
+    if ( nearest > ZOOM_LEVEL_MAX )
+      nearest = ZOOM_LEVEL_MAX;
+
+    return zoom_level( nearest );
+  }
+
+
+  static void
+  event_rotate( FT_Int  degrees )
+  {
+    status.angle += (FT_Angle)degrees << 16;
+
+    if ( status.angle >= FT_ANGLE_2PI )
+      status.angle -= FT_ANGLE_2PI;
+    if ( status.angle < 0 )
+      status.angle += FT_ANGLE_2PI;
+  }
+
+
   static int
   Process_Event()
   {
     grEvent  event;
     int      ret = 0;
-    int      speed = 10 * status.scale;
+    int      speed = status.zoom > 0x10000L
+                       ? (int)( ( 10 * status.zoom ) >> 16 )
+                       : 10;
 
-    grListenSurface( display->surface, 0, &event );
+    /* while a field is being generated, poll for events */
+    /* and show the field as soon as it is ready         */
+    for (;;)
+    {
+      FTWorker_Task  busy;
+
+
+      if ( sdf_async_update() )
+        return 0;
+
+      busy = prefetch_update();
+      if ( async_task && FTWorker_Task_Busy( async_task ) )
+        busy = async_task;
+
+      event.type = gr_event_none;
+      event.key  = grKeyNone;
+
+      grListenSurface( display->surface, busy ? gr_event_poll : 0, &event );
+      if ( event.type != gr_event_none )
+        break;
+
+      /* a blocking listen can still return without an event */
+      if ( busy )
+        FTWorker_Task_Wait( busy, 10 );
+    }
 
     switch (event.key) {
     case grKEY( 'q' ):
@@ -205,12 +1244,16 @@
       ret = 1;
       break;
     case grKEY( 'z' ):
-      status.scale++;
+      status.zoom = zoom_step( status.zoom, 1 );
       break;
     case grKEY( 'x' ):
-      status.scale--;
-      if ( status.scale < 1 )
-        status.scale = 1;
+      status.zoom = zoom_step( status.zoom, -1 );
+      break;
+    case grKEY( 'c' ):
+      event_rotate( 15 );
+      break;
+    case grKEY( 'v' ):
+      event_rotate( -15 );
       break;
     case grKeyPageUp:
       status.ptsize += 24;
@@ -296,6 +1339,20 @@
       status.overlaps = !status.overlaps;
       event_font_update();
       break;
+    case grKEY( 'g' ):
+      status.mipmaps = ( status.mipmaps + 1 ) % ( N_SDF_MIPS + 1 );
+      break;
+    case grKEY( 't' ):
+      status.show_timers = !status.show_timers;
+      break;
+    case grKEY( 'n' ):
+      status.show_string = !status.show_string;
+      event_font_update();
+      break;
+    case grKEY( 'e' ):
+      status.quantized = !status.quantized;
+      event_font_update();
+      break;
     case grKEY( '?' ):
     case grKEY( '/' ):
     case grKeyF1:
@@ -305,196 +1362,2770 @@
         break;
     }
 
-    return ret;
-  }
+    return ret;
+  }
+
+  float clamp(float x, float lowerlimit, float upperlimit) {
+    if (x < lowerlimit)
+      x = lowerlimit;
+    if (x > upperlimit)
+      x = upperlimit;
+    return x;
+  }
+
+  float smoothstep(float edge0, float edge1, float x) {
+    // Scale, bias and saturate x to 0..1 range
+    x = clamp((x - edge0) / (edge1 - edge0), 0.0, 1.0); 
+    // Evaluate polynomial
+    return x * x * (3 - 2 * x);
+  }
+
+  /*************************************************************************/
+  /*                                                                       */
+  /* `draw' fills the display row by row with one of the kernels below.    */
+  /* Display pixels are mapped back to the field by the inverse of the     */
+  /* zoom and rotation matrix.  Along a display row the field position     */
+  /* then advances by a constant 16.16 step, so each row is just a start   */
+  /* and a step, clipped to the field, and a rotated row costs the same as */
+  /* an upright one.  The interpolation keeps the 6.10 format of the field */
+  /* with 8-bit weights, rounding after each direction, and the resulting  */
+  /* distance is looked up in a table of display values, built for the     */
+  /* current view.  An 8-bit field `q' is read as the 16-bit samples       */
+  /* `(q - 128) << 8' instead, with a table for that scale, so that the    */
+  /* same arithmetic serves both.  `draw_pixel' is the reference; the SIMD */
+  /* kernels do the same on 4 (SSE2) or 8 (AVX2) pixels at once and        */
+  /* produce the same bytes.  The kernel is chosen at run time.            */
+  /*                                                                       */
+
+  /* the display values of the samples -32768..32767 */
+  typedef struct  Draw_LUT_
+  {
+    FT_Bool        valid;
+    float          width;     /* the parameters it was built for */
+    float          edge;
+    FT_Int         spread;
+    FT_Bool        quantized;
+
+    unsigned char  values[65536 + 4];  /* padded for 32-bit gathers */
+
+  } Draw_LUT;
+
+  static Draw_LUT  draw_luts[2];  /* for the raw and reconstructing views */
+
+
+  /* the display value of a distance in pixels, in a field of `spread' */
+  static unsigned char
+  draw_shade( float   min_dist,
+              FT_Int  spread )
+  {
+    if ( status.reconstruct )
+    {
+      float alpha;
+
+
+      alpha  = 1.0f - smoothstep( status.width, status.width + status.edge, -min_dist );
+      alpha *= 255;
+
+      return (unsigned char)alpha;
+    }
+    else
+    {
+      float final_dist = min_dist;
+
+
+      /* for display purposes */
+      final_dist = final_dist < 0 ? -final_dist : final_dist;
+      final_dist /= (float)spread;
+
+      final_dist = 1.0f - final_dist;
+      final_dist *= 255;
+
+      return (unsigned char)final_dist;
+    }
+  }
+
+
+  /* the table of the current view for 6.10 or 8-bit fields of  */
+  /* `spread', as generated, rebuilt if its parameters changed */
+  static const unsigned char*
+  draw_lut( FT_Bool  quantized,
+            FT_Int   spread )
+  {
+    Draw_LUT*  lut   = draw_luts + status.reconstruct;
+    float      scale = quantized ? (float)spread / 32768.0f
+                                 : 1.0f / 1024.0f;
+    FT_Int     n;
+
+
+    if ( !lut->valid                        ||
+         lut->width     != status.width     ||
+         lut->edge      != status.edge      ||
+         lut->spread    != spread           ||
+         lut->quantized != quantized        )
+    {
+      for ( n = 0; n < 65536; n++ )
+        lut->values[n] = draw_shade( (float)( n - 32768 ) * scale, spread );
+
+      lut->valid     = 1;
+      lut->width     = status.width;
+      lut->edge      = status.edge;
+      lut->spread    = spread;
+      lut->quantized = quantized;
+    }
+
+    return lut->values;
+  }
+
+
+  /* a run of display pixels and the field positions it samples */
+  typedef struct  Draw_Row_
+  {
+    const void*           buffer;
+    FT_Bool               quantized;  /* 8-bit distances             */
+    FT_Int                spread;     /* of the field, not the state */
+    FT_Int                width;
+    FT_Int                rows;
+    const unsigned char*  lut;
+
+    FT_Int32              u, v;     /* field position of the first pixel */
+    FT_Int32              du, dv;   /* and to the next pixel, 16.16      */
+
+    FT_Int                count;    /* number of pixels                  */
+    unsigned char*        line;     /* first pixel in the display        */
+    FT_Int                bytes;    /* per display pixel: 1, 3, or 4     */
+
+  } Draw_Row;
+
+
+  /* the sample at field index i */
+  static FT_Int32
+  draw_sample( const Draw_Row*  row,
+               FT_Int32         i )
+  {
+    if ( row->quantized )
+      return ( ( (const FT_Byte*)row->buffer )[i] - 128 ) * 256;
+
+    return ( (const FT_Short*)row->buffer )[i];
+  }
+
+
+  /* the sample of -spread, which is all there is outside of the field */
+  static FT_Int32
+  draw_outside( const Draw_Row*  row )
+  {
+    return row->quantized ? -32768 : -row->spread * 1024;
+  }
+
+
+  /* the sample at (x,y) */
+  static FT_Int32
+  draw_tap( const Draw_Row*  row,
+            FT_Int32         x,
+            FT_Int32         y )
+  {
+    if ( (FT_UInt32)x >= (FT_UInt32)row->width ||
+         (FT_UInt32)y >= (FT_UInt32)row->rows  )
+      return draw_outside( row );
+
+    return draw_sample( row, y * row->width + x );
+  }
+
+
+  /* the interpolated sample of pixel n */
+  static FT_Int32
+  draw_distance( const Draw_Row*  row,
+                 FT_Int           n )
+  {
+    FT_Int32  u = row->u + n * row->du;
+    FT_Int32  v = row->v + n * row->dv;
+    FT_Int32  x = u >> 16;
+    FT_Int32  y = v >> 16;
+    FT_Int32  d0, d1, d2, d3;
+    FT_Int32  fx, fy, top, bottom;
+
+
+    /* the nearest sample is always inside of the field */
+    if ( status.nearest_filtering )
+      return draw_sample( row, y * row->width + x );
+
+    /* [0,0] [0,1] [1,0] [1,1] */
+    d0 = draw_tap( row, x,     y     );
+    d1 = draw_tap( row, x,     y + 1 );
+    d2 = draw_tap( row, x + 1, y     );
+    d3 = draw_tap( row, x + 1, y + 1 );
+
+    fx = ( u >> 8 ) & 0xFF;
+    fy = ( v >> 8 ) & 0xFF;
+
+    /* rounded 6.10 results after each direction */
+    top    = ( d0 * ( 256 - fx ) + d2 * fx + 128 ) >> 8;
+    bottom = ( d1 * ( 256 - fx ) + d3 * fx + 128 ) >> 8;
+
+    return ( top * ( 256 - fy ) + bottom * fy + 128 ) >> 8;
+  }
+
+
+  static unsigned char
+  draw_pixel( const Draw_Row*  row,
+              FT_Int           n )
+  {
+    return row->lut[draw_distance( row, n ) + 32768];
+  }
+
+
+  /* write a gray value in the display's own format */
+  static void
+  draw_put( const Draw_Row*  row,
+            unsigned char*   p,
+            unsigned char    value )
+  {
+    switch ( row->bytes )
+    {
+    case 1:
+      p[0] = value;
+      break;
+
+    case 4:
+      *(FT_UInt32*)p = 0xFF000000UL | value * 0x010101UL;
+      break;
+
+    default:
+      p[0] = p[1] = p[2] = value;
+    }
+  }
+
+
+  static void
+  draw_row_scalar( const Draw_Row*  row )
+  {
+    FT_Int  n;
+
+
+    for ( n = 0; n < row->count; n++ )
+      draw_put( row, row->line + n * row->bytes, draw_pixel( row, n ) );
+  }
+
+
+  static void
+  (*draw_row)( const Draw_Row*  row ) = draw_row_scalar;
+
+  /* the rows of one `draw' call */
+  typedef struct  Draw_Job_
+  {
+    Draw_Row  row;              /* the first row, unclipped          */
+    FT_Int    pitch;            /* from row to row, bytes            */
+    FT_Int32  u_step, v_step;   /* from row to row, 16.16            */
+
+    FT_Int32  u_min, u_max;     /* the pixels whose centers are in   */
+    FT_Int32  v_min, v_max;     /* the field have positions in these */
+                                /* ranges                            */
+
+  } Draw_Job;
+
+
+  /* floor( a / b ) for b > 0 */
+  static FT_Int32
+  draw_div_floor( FT_Int32  a,
+                  FT_Int32  b )
+  {
+    return a >= 0 ? a / b : -( ( b - 1 - a ) / b );
+  }
+
+
+  /* narrow [*afirst,*alast) to the pixels n whose positions */
+  /* `start + n * step' are in [min,max)                      */
+  static void
+  draw_span( FT_Int32  start,
+             FT_Int32  step,
+             FT_Int32  min,
+             FT_Int32  max,
+             FT_Int*   afirst,
+             FT_Int*   alast )
+  {
+    FT_Int32  first, last;
+
+
+    if ( step == 0 )
+    {
+      if ( start < min || start >= max )
+        *alast = *afirst;
+      return;
+    }
+
+    if ( step > 0 )
+    {
+      first = -draw_div_floor( start - min, step );
+      last  = -draw_div_floor( start - max, step );
+    }
+    else
+    {
+      first = draw_div_floor( start - max, -step ) + 1;
+      last  = draw_div_floor( start - min, -step ) + 1;
+    }
+
+    if ( *afirst < first )
+      *afirst = first;
+    if ( *alast > last )
+      *alast = last;
+    if ( *alast < *afirst )
+      *alast = *afirst;
+  }
+
+
+  /* fill rows [first,last) of a job */
+  static void
+  draw_band( int    thread,
+             int    first,
+             int    last,
+             void*  user )
+  {
+    Draw_Job*  job = (Draw_Job*)user;
+    Draw_Row   row = job->row;
+    FT_Int     n;
+
+    FT_UNUSED( thread );
+
+
+    for ( n = first; n < last; n++ )
+    {
+      FT_Int32  u     = job->row.u + n * job->u_step;
+      FT_Int32  v     = job->row.v + n * job->v_step;
+      FT_Int    start = 0;
+      FT_Int    end   = job->row.count;
+
+
+      draw_span( u, row.du, job->u_min, job->u_max, &start, &end );
+      draw_span( v, row.dv, job->v_min, job->v_max, &start, &end );
+
+      if ( start == end )
+        continue;
+
+      row.u     = u + start * row.du;
+      row.v     = v + start * row.dv;
+      row.count = end - start;
+      row.line  = job->row.line + n * job->pitch + start * row.bytes;
+
+      draw_row( &row );
+    }
+  }
+
+
+#if ( defined __GNUC__ || defined __clang__ )    && \
+    ( defined __x86_64__ || defined __i386__ )
+
+#define DRAW_SIMD
+
+#include <immintrin.h>
+
+
+  /* Whether the taps of pixels n..n+count-1 and their right neighbours */
+  /* can be read without checks.  The positions are linear, so the      */
+  /* first and the last pixel have the extreme taps.                    */
+  static FT_Bool
+  draw_inside( const Draw_Row*  row,
+               FT_Int           n,
+               FT_Int           count )
+  {
+    FT_Int32  x0 = ( row->u + n * row->du ) >> 16;
+    FT_Int32  y0 = ( row->v + n * row->dv ) >> 16;
+    FT_Int32  x1 = ( row->u + ( n + count - 1 ) * row->du ) >> 16;
+    FT_Int32  y1 = ( row->v + ( n + count - 1 ) * row->dv ) >> 16;
+    FT_Int32  t;
+
+
+    if ( x0 > x1 )
+    {
+      t  = x0;
+      x0 = x1;
+      x1 = t;
+    }
+    if ( y0 > y1 )
+    {
+      t  = y0;
+      y0 = y1;
+      y1 = t;
+    }
+
+    /* the nearest samples are inside, but the 32-bit loads of the */
+    /* AVX2 kernel also read the next one (6.10) or three (8-bit)  */
+    /* samples                                                     */
+    if ( !status.nearest_filtering )
+    {
+      if ( x0 < 0 || x1 >= row->width - 1 ||
+           y0 < 0 || y1 >= row->rows  - 1 )
+        return 0;
+
+      y1++;
+    }
+
+    return y1 * row->width + x1 + ( row->quantized ? 3 : 1 ) <
+             row->width * row->rows;
+  }
+
+
+  /* the samples at field indices i and i+1 as a pair */
+#define DRAW_PAIR( buffer, i )                                       \
+          ( (FT_UInt16)(buffer)[i] |                                 \
+            (FT_UInt32)(FT_UInt16)(buffer)[(i) + 1] << 16 )
+
+  /* the same for 8-bit fields: (q - 128) << 8 is q << 8 with the  */
+  /* sign bit flipped                                              */
+#define DRAW_PAIR8( buffer, i )                                      \
+          ( ( (FT_UInt32)(buffer)[i] << 8 |                          \
+              (FT_UInt32)(buffer)[(i) + 1] << 24 ) ^ 0x80008000UL )
+
+
+  /* Fetch the taps of pixels n..n+count-1 as pairs of 16-bit values,  */
+  /* the left tap in the low half: [0,0] [1,0] in `pairs[0]', and      */
+  /* [0,1] [1,1] in `pairs[1]'.  Taps outside of the field are -spread. */
+  static void
+  draw_gather( const Draw_Row*  row,
+               FT_Int           n,
+               FT_Int           count,
+               FT_UInt32        pairs[2][8] )
+  {
+    const FT_Short*  buffer = (const FT_Short*)row->buffer;
+    const FT_Byte*   bytes  = (const FT_Byte*)row->buffer;
+    FT_Int           k;
+
+
+    if ( draw_inside( row, n, count ) )
+    {
+      for ( k = 0; k < count; k++ )
+      {
+        FT_Int32  i = ( ( row->v + ( n + k ) * row->dv ) >> 16 ) * row->width +
+                      ( ( row->u + ( n + k ) * row->du ) >> 16 );
+
+
+        pairs[0][k] = row->quantized ? DRAW_PAIR8( bytes, i )
+                                     : DRAW_PAIR( buffer, i );
+
+        if ( status.nearest_filtering )
+          continue;
+
+        i += row->width;
+
+        pairs[1][k] = row->quantized ? DRAW_PAIR8( bytes, i )
+                                     : DRAW_PAIR( buffer, i );
+      }
+
+      return;
+    }
+
+    for ( k = 0; k < count; k++ )
+    {
+      FT_Int32  x = ( row->u + ( n + k ) * row->du ) >> 16;
+      FT_Int32  y = ( row->v + ( n + k ) * row->dv ) >> 16;
+
+
+      pairs[0][k] = (FT_UInt16)draw_tap( row, x, y ) |
+                    (FT_UInt32)(FT_UInt16)draw_tap( row, x + 1, y ) << 16;
+
+      if ( status.nearest_filtering )
+        continue;
+
+      pairs[1][k] = (FT_UInt16)draw_tap( row, x, y + 1 ) |
+                    (FT_UInt32)(FT_UInt16)draw_tap( row, x + 1, y + 1 ) << 16;
+    }
+  }
+
+
+  /* look up table indices and write the pixels */
+  static void
+  draw_store( const Draw_Row*  row,
+              unsigned char*   p,
+              const FT_Int32*  indices,
+              FT_Int           count )
+  {
+    const unsigned char*  lut = row->lut;
+    FT_Int                k;
+
+
+    switch ( row->bytes )
+    {
+    case 1:
+      for ( k = 0; k < count; k++ )
+        p[k] = lut[indices[k]];
+      break;
+
+    case 4:
+      for ( k = 0; k < count; k++, p += 4 )
+        *(FT_UInt32*)p = 0xFF000000UL | lut[indices[k]] * 0x010101UL;
+      break;
+
+    default:
+      for ( k = 0; k < count; k++, p += 3 )
+        p[0] = p[1] = p[2] = lut[indices[k]];
+    }
+  }
+
+
+  __attribute__(( target( "sse2" ) ))
+  static void
+  draw_row_sse2( const Draw_Row*  row )
+  {
+    const __m128i  round  = _mm_set1_epi32( 128 );
+    const __m128i  one    = _mm_set1_epi32( 256 );
+    const __m128i  offset = _mm_set1_epi32( 32768 );
+    const __m128i  low    = _mm_set1_epi32( 0xFFFF );
+    const __m128i  bits   = _mm_set1_epi32( 0xFF );
+    const __m128i  du     = _mm_set1_epi32( 4 * row->du );
+    const __m128i  dv     = _mm_set1_epi32( 4 * row->dv );
+
+    __m128i    u = _mm_setr_epi32( row->u,
+                                   row->u + row->du,
+                                   row->u + 2 * row->du,
+                                   row->u + 3 * row->du );
+    __m128i    v = _mm_setr_epi32( row->v,
+                                   row->v + row->dv,
+                                   row->v + 2 * row->dv,
+                                   row->v + 3 * row->dv );
+    FT_UInt32  pairs[2][8];
+    FT_Int32   indices[4];
+    FT_Int     n;
+
+
+    for ( n = 0; n + 4 <= row->count; n += 4 )
+    {
+      __m128i  a, index;
+
+
+      draw_gather( row, n, 4, pairs );
+
+      a = _mm_loadu_si128( (const __m128i*)pairs[0] );
+
+      if ( status.nearest_filtering )
+        index = _mm_srai_epi32( _mm_slli_epi32( a, 16 ), 16 );
+      else
+      {
+        __m128i  b  = _mm_loadu_si128( (const __m128i*)pairs[1] );
+        __m128i  fx = _mm_and_si128( _mm_srli_epi32( u, 8 ), bits );
+        __m128i  fy = _mm_and_si128( _mm_srli_epi32( v, 8 ), bits );
+        __m128i  wx, wy, top, bottom;
+
+
+        /* 256 - f | f << 16 */
+        wx = _mm_add_epi32( _mm_sub_epi32( _mm_slli_epi32( fx, 16 ), fx ),
+                            one );
+        wy = _mm_add_epi32( _mm_sub_epi32( _mm_slli_epi32( fy, 16 ), fy ),
+                            one );
+
+        top    = _mm_srai_epi32( _mm_add_epi32( _mm_madd_epi16( a, wx ),
+                                                round ), 8 );
+        bottom = _mm_srai_epi32( _mm_add_epi32( _mm_madd_epi16( b, wx ),
+                                                round ), 8 );
+
+        index = _mm_or_si128( _mm_and_si128( top, low ),
+                              _mm_slli_epi32( bottom, 16 ) );
+        index = _mm_srai_epi32( _mm_add_epi32( _mm_madd_epi16( index, wy ),
+                                               round ), 8 );
+      }
+
+      _mm_storeu_si128( (__m128i*)indices, _mm_add_epi32( index, offset ) );
+      draw_store( row, row->line + n * row->bytes, indices, 4 );
+
+      u = _mm_add_epi32( u, du );
+      v = _mm_add_epi32( v, dv );
+    }
+
+    for ( ; n < row->count; n++ )
+      draw_put( row, row->line + n * row->bytes, draw_pixel( row, n ) );
+  }
+
+
+  __attribute__(( target( "avx2" ) ))
+  static void
+  draw_row_avx2( const Draw_Row*  row )
+  {
+    const __m256i  round  = _mm256_set1_epi32( 128 );
+    const __m256i  one    = _mm256_set1_epi32( 256 );
+    const __m256i  offset = _mm256_set1_epi32( 32768 );
+    const __m256i  low    = _mm256_set1_epi32( 0xFFFF );
+    const __m256i  bits   = _mm256_set1_epi32( 0xFF );
+    const __m256i  alpha  = _mm256_set1_epi32( (int)0xFF000000UL );
+    const __m256i  width  = _mm256_set1_epi32( row->width );
+    const __m256i  sign   = _mm256_set1_epi32( (int)0x80008000UL );
+
+    /* the low byte of each value, moved to the bottom of each lane */
+    const __m256i  gather = _mm256_setr_epi8(  0,  4,  8, 12, -1, -1, -1, -1,
+                                              -1, -1, -1, -1, -1, -1, -1, -1,
+                                               0,  4,  8, 12, -1, -1, -1, -1,
+                                              -1, -1, -1, -1, -1, -1, -1, -1 );
+    const __m256i  du     = _mm256_set1_epi32( 8 * row->du );
+    const __m256i  dv     = _mm256_set1_epi32( 8 * row->dv );
+
+    /* gathering 32 bits at a field index fetches the right neighbour */
+    /* too; this is safe while the taps are inside of the field       */
+    const int*  base = (const int*)row->buffer;
+
+    __m256i    u = _mm256_add_epi32(
+                     _mm256_set1_epi32( row->u ),
+                     _mm256_mullo_epi32( _mm256_set1_epi32( row->du ),
+                                         _mm256_setr_epi32( 0, 1, 2, 3,
+                                                            4, 5, 6, 7 ) ) );
+    __m256i    v = _mm256_add_epi32(
+                     _mm256_set1_epi32( row->v ),
+                     _mm256_mullo_epi32( _mm256_set1_epi32( row->dv ),
+                                         _mm256_setr_epi32( 0, 1, 2, 3,
+                                                            4, 5, 6, 7 ) ) );
+    FT_UInt32  pairs[2][8];
+    FT_Int32   values[8];
+    FT_Int     n, k;
+
+    unsigned char*  p = row->line;
+
+
+    for ( n = 0; n + 8 <= row->count; n += 8 )
+    {
+      __m256i  a, b = _mm256_setzero_si256();
+      __m256i  index, value;
+
+
+      if ( draw_inside( row, n, 8 ) )
+      {
+        __m256i  i = _mm256_add_epi32(
+                       _mm256_mullo_epi32( _mm256_srai_epi32( v, 16 ),
+                                           width ),
+                       _mm256_srai_epi32( u, 16 ) );
+
+
+        if ( row->quantized )
+        {
+          a = _mm256_i32gather_epi32( base, i, 1 );
+          if ( !status.nearest_filtering )
+            b = _mm256_i32gather_epi32( base, _mm256_add_epi32( i, width ),
+                                        1 );
+
+          /* q0 q1 q2 q3 to q0 << 8 | q1 << 24, see `DRAW_PAIR8' */
+          a = _mm256_xor_si256( _mm256_or_si256(
+                                  _mm256_slli_epi32(
+                                    _mm256_and_si256( a, bits ), 8 ),
+                                  _mm256_slli_epi32(
+                                    _mm256_srli_epi32( a, 8 ), 24 ) ),
+                                sign );
+          b = _mm256_xor_si256( _mm256_or_si256(
+                                  _mm256_slli_epi32(
+                                    _mm256_and_si256( b, bits ), 8 ),
+                                  _mm256_slli_epi32(
+                                    _mm256_srli_epi32( b, 8 ), 24 ) ),
+                                sign );
+        }
+        else
+        {
+          a = _mm256_i32gather_epi32( base, i, 2 );
+          if ( !status.nearest_filtering )
+            b = _mm256_i32gather_epi32( base, _mm256_add_epi32( i, width ),
+                                        2 );
+        }
+      }
+      else
+      {
+        draw_gather( row, n, 8, pairs );
+
+        a = _mm256_loadu_si256( (const __m256i*)pairs[0] );
+        b = _mm256_loadu_si256( (const __m256i*)pairs[1] );
+      }
+
+      if ( status.nearest_filtering )
+        index = _mm256_srai_epi32( _mm256_slli_epi32( a, 16 ), 16 );
+      else
+      {
+        __m256i  fx = _mm256_and_si256( _mm256_srli_epi32( u, 8 ), bits );
+        __m256i  fy = _mm256_and_si256( _mm256_srli_epi32( v, 8 ), bits );
+        __m256i  wx, wy, top, bottom;
+
+
+        /* 256 - f | f << 16 */
+        wx = _mm256_add_epi32(
+               _mm256_sub_epi32( _mm256_slli_epi32( fx, 16 ), fx ), one );
+        wy = _mm256_add_epi32(
+               _mm256_sub_epi32( _mm256_slli_epi32( fy, 16 ), fy ), one );
+
+        top    = _mm256_srai_epi32(
+                   _mm256_add_epi32( _mm256_madd_epi16( a, wx ), round ), 8 );
+        bottom = _mm256_srai_epi32(
+                   _mm256_add_epi32( _mm256_madd_epi16( b, wx ), round ), 8 );
+
+        index = _mm256_or_si256( _mm256_and_si256( top, low ),
+                                 _mm256_slli_epi32( bottom, 16 ) );
+        index = _mm256_srai_epi32(
+                  _mm256_add_epi32( _mm256_madd_epi16( index, wy ), round ),
+                  8 );
+      }
+
+      /* the table is padded for the 3 bytes read after the value */
+      value = _mm256_and_si256(
+                _mm256_i32gather_epi32( (const int*)row->lut,
+                                        _mm256_add_epi32( index, offset ),
+                                        1 ),
+                bits );
+
+      switch ( row->bytes )
+      {
+      case 1:
+        value = _mm256_shuffle_epi8( value, gather );
+        _mm_storel_epi64( (__m128i*)p,
+                          _mm_unpacklo_epi32(
+                            _mm256_castsi256_si128( value ),
+                            _mm256_extracti128_si256( value, 1 ) ) );
+        p += 8;
+        break;
+
+      case 4:
+        value = _mm256_or_si256(
+                  _mm256_or_si256( value, alpha ),
+                  _mm256_or_si256( _mm256_slli_epi32( value, 8 ),
+                                   _mm256_slli_epi32( value, 16 ) ) );
+        _mm256_storeu_si256( (__m256i*)p, value );
+        p += 32;
+        break;
+
+      default:
+        _mm256_storeu_si256( (__m256i*)values, value );
+
+        for ( k = 0; k < 8; k++, p += 3 )
+          p[0] = p[1] = p[2] = (unsigned char)values[k];
+      }
+
+      u = _mm256_add_epi32( u, du );
+      v = _mm256_add_epi32( v, dv );
+    }
+
+    for ( ; n < row->count; n++ )
+      draw_put( row, row->line + n * row->bytes, draw_pixel( row, n ) );
+  }
+
+#endif /* DRAW_SIMD */
+
+
+  /* pick the fastest kernel the processor supports */
+  static void
+  draw_init( void )
+  {
+#ifdef DRAW_SIMD
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports( "avx2" ) )
+    {
+      draw_row    = draw_row_avx2;
+      draw_kernel = "AVX2";
+    }
+    else if ( __builtin_cpu_supports( "sse2" ) )
+    {
+      draw_row    = draw_row_sse2;
+      draw_kernel = "SSE2";
+    }
+#endif
+  }
+
+
+  /* Run the kernels the processor supports on random fields, positions, */
+  /* and display formats, and compare their pixels with those of the     */
+  /* scalar kernel; for the hidden `-K' option.  Return the number of    */
+  /* rows that differ.                                                   */
+  static int
+  draw_self_test( int  num_cases )
+  {
+    static const FT_Int  formats[3] = { 1, 3, 4 };
+    static const char*   names[3]   = { "scalar", "SSE2", "AVX2" };
+
+    void  (*kernels[3])( const Draw_Row*  row ) = { draw_row_scalar,
+                                                     NULL,
+                                                     NULL };
+
+    static unsigned char  lines[3][64 * 4];
+
+    FT_Bool        nearest     = status.nearest_filtering;
+    FT_Bool        reconstruct = status.reconstruct;
+    unsigned long  seed        = 1;
+    int            failures    = 0;
+    int            tested      = 0;
+    int            c, k;
+
+#define DRAW_RANDOM( n )                                 \
+          ( seed = seed * 1103515245UL + 12345UL,        \
+            (FT_Int32)( ( seed >> 8 ) % (unsigned long)(n) ) )
+
+
+#ifdef DRAW_SIMD
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports( "sse2" ) )
+      kernels[1] = draw_row_sse2;
+    if ( __builtin_cpu_supports( "avx2" ) )
+      kernels[2] = draw_row_avx2;
+#endif
+
+    for ( c = 0; c < num_cases; c++ )
+    {
+      Draw_Row  row;
+      void*     buffer;
+      FT_Int32  bias, i;
+      FT_Int    start, end;
+      size_t    size;
+
+
+      row.width     = 1 + DRAW_RANDOM( 64 );
+      row.rows      = 1 + DRAW_RANDOM( 64 );
+      row.quantized = (FT_Bool)DRAW_RANDOM( 2 );
+      row.spread    = 2 + DRAW_RANDOM( 31 );
+
+      /* exactly as large as the field, so that overreads show */
+      size   = (size_t)row.width * (size_t)row.rows;
+      buffer = malloc( row.quantized ? size : size * sizeof ( FT_Short ) );
+      if ( !buffer )
+        break;
+
+      for ( i = 0; i < (FT_Int32)size; i++ )
+      {
+        if ( row.quantized )
+          ( (FT_Byte*)buffer )[i] = (FT_Byte)DRAW_RANDOM( 256 );
+        else
+          ( (FT_Short*)buffer )[i] =
+            (FT_Short)( DRAW_RANDOM( 2 * row.spread * 1024 + 1 ) -
+                        row.spread * 1024 );
+      }
+
+      status.nearest_filtering = (FT_Bool)DRAW_RANDOM( 2 );
+      status.reconstruct       = (FT_Bool)DRAW_RANDOM( 2 );
+
+      row.buffer = buffer;
+      row.lut    = draw_lut( row.quantized, row.spread );
+      row.bytes  = formats[DRAW_RANDOM( 3 )];
+
+      /* upright fields, as at integer zoom, are the common case */
+      row.du = DRAW_RANDOM( 4 << 16 ) - ( 2 << 16 );
+      row.dv = DRAW_RANDOM( 4 ) ? DRAW_RANDOM( 4 << 16 ) - ( 2 << 16 ) : 0;
+      row.u  = DRAW_RANDOM( ( row.width + 8 ) << 16 ) - ( 4 << 16 );
+      row.v  = DRAW_RANDOM( ( row.rows  + 8 ) << 16 ) - ( 4 << 16 );
+
+      /* clip like `draw_band' */
+      bias  = status.nearest_filtering ? 0 : 0x80L - 0x8000L;
+      start = 0;
+      end   = 1 + DRAW_RANDOM( 64 );
+
+      draw_span( row.u, row.du, bias, ( row.width << 16 ) + bias,
+                 &start, &end );
+      draw_span( row.v, row.dv, bias, ( row.rows  << 16 ) + bias,
+                 &start, &end );
+
+      row.u    += start * row.du;
+      row.v    += start * row.dv;
+      row.count = end - start;
+
+      for ( k = 0; k < 3 && row.count > 0; k++ )
+      {
+        if ( !kernels[k] )
+          continue;
+
+        memset( lines[k], 0x5A, sizeof ( lines[k] ) );
+        row.line = lines[k];
+        kernels[k]( &row );
+
+        if ( k && memcmp( lines[k], lines[0], sizeof ( lines[k] ) ) )
+        {
+          if ( !failures )
+            fprintf( stderr, "%s differs from scalar: %dx%d %s field,"
+                             " %s, %d bytes per pixel, %d pixels\n",
+                     names[k], row.width, row.rows,
+                     row.quantized ? "8-bit" : "6.10",
+                     status.nearest_filtering ? "nearest" : "bilinear",
+                     row.bytes, row.count );
+          failures++;
+        }
+      }
+
+      if ( row.count > 0 )
+        tested++;
+
+      free( buffer );
+    }
+
+#undef DRAW_RANDOM
+
+    status.nearest_filtering = nearest;
+    status.reconstruct       = reconstruct;
+
+    printf( "Compared %d rows of the%s%s kernels with scalar: %d differ\n",
+            tested,
+            kernels[1] ? " SSE2" : "",
+            kernels[2] ? " AVX2" : "",
+            failures );
+
+    return failures;
+  }
+
+
+  /* Where `box' (26.6, y up) goes on the display, with its (0,0)   */
+  /* point at the center: `ainverse' maps a display offset to an    */
+  /* offset in field pixels (16.16, y up), `aorigin' is the display */
+  /* point at the box's bottom left corner, and `aregion' is the    */
+  /* area the box covers, clipped to the display.                   */
+  static void
+  draw_transform( const Box*  box,
+                  FT_Matrix*  ainverse,
+                  FT_Vector*  aorigin,
+                  Box*        aregion )
+  {
+    FT_Fixed   cos   = FT_Cos( status.angle );
+    FT_Fixed   sin   = FT_Sin( status.angle );
+    FT_Fixed   scale = FT_DivFix( 0x10000L, status.zoom );
+    FT_Matrix  matrix;
+    FT_Vector  corners[4];
+    FT_Vector  origin;
+    Box        region;
+    FT_Int     n;
+
+
+    /* from the field to the display, both y up */
+    matrix.xx =  FT_MulFix( status.zoom, cos );
+    matrix.xy = -FT_MulFix( status.zoom, sin );
+    matrix.yx =  FT_MulFix( status.zoom, sin );
+    matrix.yy =  FT_MulFix( status.zoom, cos );
+
+    /* back from the display, y down */
+    ainverse->xx =  FT_MulFix( scale, cos );
+    ainverse->xy = -FT_MulFix( scale, sin );
+    ainverse->yx = -FT_MulFix( scale, sin );
+    ainverse->yy = -FT_MulFix( scale, cos );
+
+    for ( n = 0; n < 4; n++ )
+    {
+      corners[n].x = n & 1 ? box->xMax : box->xMin;
+      corners[n].y = n & 2 ? box->yMax : box->yMin;
+
+      FT_Vector_Transform( &corners[n], &matrix );
+    }
+
+    /* the center goes to the middle of the display; rounding the */
+    /* origin to a pixel makes an upright field at integer zoom   */
+    /* sample whole field pixels                                  */
+    origin.x = ( display->bitmap->width / 2 + status.x_offset ) * 64 +
+                 corners[0].x;
+    origin.y = ( display->bitmap->rows  / 2 + status.y_offset ) * 64 -
+                 corners[0].y;
+    origin.x = ( origin.x + 32 ) & -64;
+    origin.y = ( origin.y + 32 ) & -64;
+
+    region.xMin = region.yMin = 0x7FFFFFFFL;
+    region.xMax = region.yMax = -0x7FFFFFFFL;
+
+    for ( n = 0; n < 4; n++ )
+    {
+      FT_Pos  x = origin.x + corners[n].x - corners[0].x;
+      FT_Pos  y = origin.y - corners[n].y + corners[0].y;
+
+
+      if ( region.xMin > x )
+        region.xMin = x;
+      if ( region.xMax < x )
+        region.xMax = x;
+      if ( region.yMin > y )
+        region.yMin = y;
+      if ( region.yMax < y )
+        region.yMax = y;
+    }
+
+    region.xMin = region.xMin >> 6;
+    region.yMin = region.yMin >> 6;
+    region.xMax = ( region.xMax + 63 ) >> 6;
+    region.yMax = ( region.yMax + 63 ) >> 6;
+
+    if ( region.xMin < 0 )
+      region.xMin = 0;
+    if ( region.yMin < 0 )
+      region.yMin = 0;
+    if ( region.xMax > display->bitmap->width )
+      region.xMax = display->bitmap->width;
+    if ( region.yMax > display->bitmap->rows )
+      region.yMax = display->bitmap->rows;
+
+    aorigin->x = origin.x >> 6;
+    aorigin->y = origin.y >> 6;
+    *aregion   = region;
+  }
+
+
+  /* the box of a field centered on (0,0) */
+  static void
+  draw_field_box( FTDemo_SDF_Glyph  field,
+                  Box*              abox )
+  {
+    abox->xMin = -32 * field->width;
+    abox->yMin = -32 * field->rows;
+    abox->xMax =  32 * field->width;
+    abox->yMax =  32 * field->rows;
+  }
+
+
+  /*************************************************************************/
+  /*                                                                       */
+  /* A string is drawn in one pass over the display, just like a single    */
+  /* field.  The whole string is placed by `draw_transform', and every     */
+  /* glyph samples its own mip level at its exact offset from the string's */
+  /* corner.  Each display row first collects the largest distance of the  */
+  /* glyphs covering it, which is the union of their shapes, and is then   */
+  /* looked up and written once.  The cost depends on the covered display  */
+  /* area, not on the size of the fields.                                  */
+  /*                                                                       */
+
+  /* a glyph of the string on the display */
+  typedef struct  Draw_Glyph_
+  {
+    Draw_Row  row;              /* the first row of the region      */
+    FT_Int32  u_step, v_step;   /* from row to row, 16.16           */
+    FT_Int32  u_max, v_max;     /* the field, as in `Draw_Job'      */
+    FT_Int    first, last;      /* the rows of the region it covers */
+
+  } Draw_Glyph;
+
+  /* the rows of one `draw_string' call */
+  typedef struct  Draw_String_Job_
+  {
+    Draw_Row     row;           /* the region's first row             */
+    FT_Int       pitch;         /* from row to row, bytes             */
+    FT_Int32     bias;          /* the lower end of the field ranges  */
+    FT_Int32     outside;       /* the sample where no glyph is       */
+
+    Draw_Glyph*  glyphs;
+    FT_Int       num_glyphs;
+
+    FT_Int32*    distances;     /* a row for each thread */
+
+  } Draw_String_Job;
+
+
+  /* keep the larger of the distances of the pixels and `distances' */
+  static void
+  draw_merge( const Draw_Row*  row,
+              FT_Int32*        distances )
+  {
+    FT_Int  n;
+
+
+    for ( n = 0; n < row->count; n++ )
+    {
+      FT_Int32  distance = draw_distance( row, n );
+
+
+      if ( distances[n] < distance )
+        distances[n] = distance;
+    }
+  }
+
+
+  /* fill rows [first,last) of a string job */
+  static void
+  draw_string_band( int    thread,
+                    int    first,
+                    int    last,
+                    void*  user )
+  {
+    Draw_String_Job*  job       = (Draw_String_Job*)user;
+    FT_Int32*         distances = job->distances + thread * job->row.count;
+    FT_Int            n, k, g;
+
+
+    for ( n = first; n < last; n++ )
+    {
+      unsigned char*  line = job->row.line + n * job->pitch;
+      FT_Int          lo   = 0;
+      FT_Int          hi   = 0;  /* the pixels with distances */
+
+
+      for ( g = 0; g < job->num_glyphs; g++ )
+      {
+        Draw_Glyph*  glyph = job->glyphs + g;
+        Draw_Row     row   = glyph->row;
+        FT_Int32     u, v;
+        FT_Int       start = 0;
+        FT_Int       end   = job->row.count;
+
+
+        if ( n < glyph->first || n >= glyph->last )
+          continue;
+
+        u = row.u + n * glyph->u_step;
+        v = row.v + n * glyph->v_step;
+
+        draw_span( u, row.du, job->bias, glyph->u_max, &start, &end );
+        draw_span( v, row.dv, job->bias, glyph->v_max, &start, &end );
+
+        if ( start == end )
+          continue;
+
+        /* pixels between the glyphs are outside */
+        if ( lo == hi )
+          lo = hi = start;
+        for ( k = start; k < lo; k++ )
+          distances[k] = job->outside;
+        for ( k = hi; k < end; k++ )
+          distances[k] = job->outside;
+        if ( lo > start )
+          lo = start;
+        if ( hi < end )
+          hi = end;
+
+        row.u     = u + start * row.du;
+        row.v     = v + start * row.dv;
+        row.count = end - start;
+
+        draw_merge( &row, distances + start );
+      }
+
+      for ( k = lo; k < hi; k++ )
+        draw_put( &job->row, line + k * job->row.bytes,
+                  job->row.lut[distances[k] + 32768] );
+    }
+  }
+
+
+  /* draw the part of the current string inside of `clip' */
+  static FT_Error
+  draw_string( const Box*  clip )
+  {
+    FTDemo_SDF_String  string  = &sdf_string;
+    FT_Int             threads = FTWorker_Pool_Size( draw_pool );
+    Draw_String_Job    job;
+    FT_Matrix          inverse;
+    FT_Vector          origin;
+    Box                region;
+    FT_Int32           x, y;
+    FT_Int             n;
+
+
+    if ( string->bbox.xMax <= string->bbox.xMin ||
+         string->bbox.yMax <= string->bbox.yMin )
+      return FT_Err_Ok;
+
+    draw_transform( &string->bbox, &inverse, &origin, &region );
+
+    if ( region.xMin < clip->xMin )
+      region.xMin = clip->xMin;
+    if ( region.yMin < clip->yMin )
+      region.yMin = clip->yMin;
+    if ( region.xMax > clip->xMax )
+      region.xMax = clip->xMax;
+    if ( region.yMax > clip->yMax )
+      region.yMax = clip->yMax;
+
+    if ( region.xMax <= region.xMin ||
+         region.yMax <= region.yMin )
+      return FT_Err_Ok;
+
+    /* the center of the first pixel, in half pixels from the origin */
+    x = (FT_Int32)( 2 * ( region.xMin - origin.x ) + 1 );
+    y = (FT_Int32)( 2 * ( region.yMin - origin.y ) + 1 );
+
+    /* the fields of a string all have the same format */
+    job.row.quantized = 0;
+    job.row.spread    = status.spread;
+    for ( n = 0; n < string->length; n++ )
+      if ( string->fields[n] )
+      {
+        job.row.quantized = string->fields[n]->quantized;
+        job.row.spread    = string->fields[n]->spread;
+        break;
+      }
+
+    job.row.lut    = draw_lut( job.row.quantized, job.row.spread );
+    job.row.count  = (FT_Int)( region.xMax - region.xMin );
+    job.row.bytes  = display_bytes();
+    job.row.line   = display->bitmap->buffer +
+                       region.yMin * display->bitmap->pitch +
+                       region.xMin * job.row.bytes;
+    job.pitch      = display->bitmap->pitch;
+    job.bias       = status.nearest_filtering ? 0 : 0x80L - 0x8000L;
+    job.outside    = draw_outside( &job.row );
+    job.num_glyphs = 0;
+
+    job.glyphs    = (Draw_Glyph*)malloc( (size_t)string->length *
+                                           sizeof ( Draw_Glyph ) );
+    job.distances = (FT_Int32*)malloc( (size_t)( threads > 1 ? threads : 1 ) *
+                                         (size_t)job.row.count *
+                                         sizeof ( FT_Int32 ) );
+    if ( !job.glyphs || !job.distances )
+    {
+      free( job.glyphs );
+      free( job.distances );
+
+      return FT_Err_Out_Of_Memory;
+    }
+
+    for ( n = 0; n < string->length; n++ )
+    {
+      FTDemo_SDF_Glyph     field = string->fields[n];
+      Draw_Glyph*          glyph = job.glyphs + job.num_glyphs;
+      FTDemo_SDF_GlyphRec  mip;
+      FT_Matrix            scaled;
+      FT_Vector            corner;
+      FT_Pos               dx, dy;
+      Box                  box, covered;
+      FT_Int               level;
+
+
+      if ( !field )
+        continue;
+
+      /* the rows the glyph may cover, give or take the rounding */
+      /* of the origin                                           */
+      box.xMin = string->origins[n].x;
+      box.yMin = string->origins[n].y;
+      box.xMax = box.xMin + 64 * field->width;
+      box.yMax = box.yMin + 64 * field->rows;
+
+      draw_transform( &box, &scaled, &corner, &covered );
+
+      glyph->first = (FT_Int)( covered.yMin - 1 - region.yMin );
+      glyph->last  = (FT_Int)( covered.yMax + 1 - region.yMin );
+
+      if ( covered.xMax + 1 <= region.xMin ||
+           covered.xMin - 1 >= region.xMax ||
+           glyph->last <= 0                ||
+           glyph->first >= region.yMax - region.yMin )
+        continue;
+
+      if ( status.mipmaps && status.zoom <= 0xB505L )     /* 1/sqrt(2) */
+        FTDemo_SDF_Cache_Mips( handle, field, status.mipmaps - 1 );
+
+      level = draw_mip_level( field );
+      FTDemo_SDF_Get_Mip( field, level, &mip );
+
+      scaled.xx = inverse.xx / ( 1L << level );
+      scaled.xy = inverse.xy / ( 1L << level );
+      scaled.yx = inverse.yx / ( 1L << level );
+      scaled.yy = inverse.yy / ( 1L << level );
+
+      /* the field's corner from the string's, 16.16 */
+      dx = ( string->origins[n].x - string->bbox.xMin ) << 10;
+      dy = ( string->origins[n].y - string->bbox.yMin ) << 10;
+
+      glyph->row.quantized = mip.quantized;
+      glyph->row.spread    = mip.spread;
+
+      glyph->row.buffer = mip.buffer;
+      glyph->row.width  = mip.width;
+      glyph->row.rows   = mip.rows;
+      glyph->row.lut    = job.row.lut;
+      glyph->row.u      = (FT_Int32)( ( ( scaled.xx * x +
+                                        scaled.xy * y ) >> 1 ) -
+                                      ( dx >> level ) ) + job.bias;
+      glyph->row.v      = (FT_Int32)( ( ( scaled.yx * x +
+                                        scaled.yy * y ) >> 1 ) -
+                                      ( dy >> level ) ) + job.bias;
+      glyph->row.du     = (FT_Int32)scaled.xx;
+      glyph->row.dv     = (FT_Int32)scaled.yx;
+      glyph->u_step     = (FT_Int32)scaled.xy;
+      glyph->v_step     = (FT_Int32)scaled.yy;
+      glyph->u_max      = ( ( field->width << 16 ) >> level ) + job.bias;
+      glyph->v_max      = ( ( field->rows  << 16 ) >> level ) + job.bias;
+
+      job.num_glyphs++;
+    }
+
+    FTWorker_Pool_Run( draw_pool,
+                       (int)( region.yMax - region.yMin ),
+                       DRAW_BAND_ROWS, draw_string_band, &job );
+
+    free( job.glyphs );
+    free( job.distances );
+
+    return FT_Err_Ok;
+  }
+
+
+  /* draw the part of the current field inside of `clip' */
+  static FT_Error
+  draw( const Box*  clip )
+  {
+    FTDemo_SDF_Glyph     bitmap = current;
+    FTDemo_SDF_GlyphRec  mip;
+    FT_Matrix            inverse;
+    FT_Vector            origin;
+    Box                  box, region;
+    Draw_Job             job;
+    FT_Int32             x, y, bias;
+    FT_Int               level;
+
+
+    if ( status.show_string )
+      return draw_string( clip );
+
+    if ( !bitmap || !bitmap->buffer )
+      return FT_Err_Invalid_Argument;
+
+    draw_field_box( bitmap, &box );
+    draw_transform( &box, &inverse, &origin, &region );
+
+    if ( region.xMin < clip->xMin )
+      region.xMin = clip->xMin;
+    if ( region.yMin < clip->yMin )
+      region.yMin = clip->yMin;
+    if ( region.xMax > clip->xMax )
+      region.xMax = clip->xMax;
+    if ( region.yMax > clip->yMax )
+      region.yMax = clip->yMax;
+
+    if ( region.xMax <= region.xMin ||
+         region.yMax <= region.yMin )
+      return FT_Err_Ok;
+
+    /* A minified field is sampled from the level of its mip chain   */
+    /* that is closest to the display in resolution, which avoids    */
+    /* aliasing and reads less memory.  Positions on level `level'   */
+    /* are scaled down by 2^level; failing to build the chain only   */
+    /* costs quality.                                                 */
+    if ( status.mipmaps && status.zoom <= 0xB505L )     /* 1/sqrt(2) */
+      FTDemo_SDF_Cache_Mips( handle, bitmap, status.mipmaps - 1 );
+
+    level = draw_mip_level( bitmap );
+    FTDemo_SDF_Get_Mip( bitmap, level, &mip );
+
+    inverse.xx /= 1L << level;
+    inverse.xy /= 1L << level;
+    inverse.yx /= 1L << level;
+    inverse.yy /= 1L << level;
+
+    /* the center of the first pixel, in half pixels from the origin */
+    x = (FT_Int32)( 2 * ( region.xMin - origin.x ) + 1 );
+    y = (FT_Int32)( 2 * ( region.yMin - origin.y ) + 1 );
+
+    /* Field pixel centers are at position 0.5, but the kernels want    */
+    /* the top left tap in the integer part: for bilinear filtering the */
+    /* position is moved by -0.5, and rounded to the 8-bit weights; for */
+    /* nearest filtering it stays, which rounds it to the nearest tap.  */
+    bias = status.nearest_filtering ? 0 : 0x80L - 0x8000L;
+
+    job.row.quantized = mip.quantized;
+    job.row.spread    = mip.spread;
+
+    job.row.buffer = mip.buffer;
+    job.row.width  = mip.width;
+    job.row.rows   = mip.rows;
+    job.row.lut    = draw_lut( mip.quantized, mip.spread );
+    job.row.u      = (FT_Int32)( ( inverse.xx * x + inverse.xy * y ) >> 1 ) +
+                       bias;
+    job.row.v      = (FT_Int32)( ( inverse.yx * x + inverse.yy * y ) >> 1 ) +
+                       bias;
+    job.row.du     = (FT_Int32)inverse.xx;
+    job.row.dv     = (FT_Int32)inverse.yx;
+    job.row.count  = (FT_Int)( region.xMax - region.xMin );
+    job.row.bytes  = display_bytes();
+    job.row.line   = display->bitmap->buffer +
+                       region.yMin * display->bitmap->pitch +
+                       region.xMin * job.row.bytes;
+    job.pitch      = display->bitmap->pitch;
+    job.u_step     = (FT_Int32)inverse.xy;
+    job.v_step     = (FT_Int32)inverse.yy;
+
+    job.u_min = bias;
+    job.v_min = bias;
+    /* the area of the field, not of the rounded up level */
+    job.u_max = ( ( bitmap->width << 16 ) >> level ) + bias;
+    job.v_max = ( ( bitmap->rows  << 16 ) >> level ) + bias;
+
+    FTWorker_Pool_Run( draw_pool,
+                       (int)( region.yMax - region.yMin ),
+                       DRAW_BAND_ROWS, draw_band, &job );
+
+    return FT_Err_Ok;
+  }
+
+
+  /*************************************************************************/
+  /*                                                                       */
+  /* Redrawing.  The display keeps what the last frame showed: outside of  */
+  /* the field's region everything is background, and a pan moves the     */
+  /* region's pixels, so that only the newly exposed parts are sampled.    */
+  /* The header band is redrawn every frame.  Only the changed rectangles  */
+  /* are refreshed.                                                        */
+  /*                                                                       */
+
+  static FT_Bool
+  box_is_empty( const Box*  box )
+  {
+    return box->xMin >= box->xMax || box->yMin >= box->yMax;
+  }
+
+
+  static void
+  box_intersect( Box*        box,
+                 const Box*  other )
+  {
+    if ( box->xMin < other->xMin )
+      box->xMin = other->xMin;
+    if ( box->yMin < other->yMin )
+      box->yMin = other->yMin;
+    if ( box->xMax > other->xMax )
+      box->xMax = other->xMax;
+    if ( box->yMax > other->yMax )
+      box->yMax = other->yMax;
+  }
+
+
+  static void
+  box_union( Box*        box,
+             const Box*  other )
+  {
+    if ( box_is_empty( other ) )
+      return;
+
+    if ( box_is_empty( box ) )
+    {
+      *box = *other;
+      return;
+    }
+
+    if ( box->xMin > other->xMin )
+      box->xMin = other->xMin;
+    if ( box->yMin > other->yMin )
+      box->yMin = other->yMin;
+    if ( box->xMax < other->xMax )
+      box->xMax = other->xMax;
+    if ( box->yMax < other->yMax )
+      box->yMax = other->yMax;
+  }
+
+
+  static void
+  box_shift( Box*    box,
+             FT_Int  dx,
+             FT_Int  dy )
+  {
+    box->xMin += dx;
+    box->xMax += dx;
+    box->yMin += dy;
+    box->yMax += dy;
+  }
+
+
+  /* clear `box' and draw the field into it */
+  static void
+  display_fill( const Box*  box )
+  {
+    if ( box_is_empty( box ) )
+      return;
+
+    grFillRect( display->bitmap,
+                (int)box->xMin, (int)box->yMin,
+                (int)( box->xMax - box->xMin ),
+                (int)( box->yMax - box->yMin ),
+                display->back_color );
+    draw( box );
+  }
+
+
+  /* move the pixels of `box' by (dx,dy) */
+  static void
+  display_move( const Box*  box,
+                FT_Int      dx,
+                FT_Int      dy )
+  {
+    grBitmap*  bit   = display->bitmap;
+    FT_Int     bytes = display_bytes();
+    size_t     size  = (size_t)( bytes * ( box->xMax - box->xMin ) );
+    FT_Pos     y;
+
+
+    /* don't overwrite rows that are still to be moved */
+    if ( dy > 0 )
+      for ( y = box->yMax - 1; y >= box->yMin; y-- )
+        memmove( bit->buffer + ( y + dy ) * bit->pitch +
+                   bytes * ( box->xMin + dx ),
+                 bit->buffer + y * bit->pitch + bytes * box->xMin,
+                 size );
+    else
+      for ( y = box->yMin; y < box->yMax; y++ )
+        memmove( bit->buffer + ( y + dy ) * bit->pitch +
+                   bytes * ( box->xMin + dx ),
+                 bit->buffer + y * bit->pitch + bytes * box->xMin,
+                 size );
+  }
+
+
+  static void
+  display_refresh( const Box*  box )
+  {
+    if ( !box_is_empty( box ) )
+      grRefreshRectangle( display->surface,
+                          (int)box->xMin, (int)box->yMin,
+                          (int)( box->xMax - box->xMin ),
+                          (int)( box->yMax - box->yMin ) );
+  }
+
+
+  static void
+  display_update( void )
+  {
+    Box        screen, region, band, area, moved, part;
+    FT_Matrix  inverse;
+    FT_Vector  origin;
+    FT_Int     dx    = status.x_offset - frame.x_offset;
+    FT_Int     dy    = status.y_offset - frame.y_offset;
+    FT_Int     rows  = header_rows();
+    FT_UInt    shown = status.show_string ? sdf_serial : 0;
+    double     start = FTDemo_Get_Time();
+    double     now;
+    FT_Bool    full;
+
+
+    screen.xMin = 0;
+    screen.yMin = 0;
+    screen.xMax = display->bitmap->width;
+    screen.yMax = display->bitmap->rows;
+
+    region.xMin = region.yMin = region.xMax = region.yMax = 0;
+    if ( status.show_string )
+    {
+      if ( !box_is_empty( &sdf_string.bbox ) )
+        draw_transform( &sdf_string.bbox, &inverse, &origin, &region );
+    }
+    else if ( current && current->buffer )
+    {
+      Box  box;
+
+
+      draw_field_box( current, &box );
+      draw_transform( &box, &inverse, &origin, &region );
+    }
+
+    full = !frame.valid                                          ||
+           frame.field             != current                    ||
+           frame.string            != shown                      ||
+           frame.zoom              != status.zoom                ||
+           frame.angle             != status.angle               ||
+           frame.spread            != status.spread              ||
+           frame.nearest_filtering != status.nearest_filtering   ||
+           frame.mipmaps           != status.mipmaps             ||
+           frame.reconstruct       != status.reconstruct         ||
+           frame.width             != status.width               ||
+           frame.edge              != status.edge                ;
+
+    if ( full )
+    {
+      FTDemo_Display_Clear( display );
+      now = phase_end( PHASE_CLEAR, start );
+
+      draw( &screen );
+      now = phase_end( PHASE_DRAW, now );
+    }
+    else
+    {
+      area = frame.region;
+      box_union( &area, &region );
+
+      /* the old pixels that stay visible, but not the header text */
+      moved = region;
+      box_shift( &moved, -dx, -dy );
+      box_intersect( &moved, &frame.region );
+      if ( moved.yMin < frame.header_rows )
+        moved.yMin = frame.header_rows;
+
+      if ( !dx && !dy )
+        area.xMin = area.yMin = area.xMax = area.yMax = 0;
+      else if ( !box_is_empty( &moved ) )
+      {
+        display_move( &moved, dx, dy );
+        box_shift( &moved, dx, dy );
+      }
+
+      now = phase_end( PHASE_CLEAR, start );
+
+      /* the parts of `area' around `moved' */
+      if ( box_is_empty( &moved ) )
+        display_fill( &area );
+      else if ( !box_is_empty( &area ) )
+      {
+        part      = area;
+        part.yMax = moved.yMin;
+        display_fill( &part );
+
+        part      = area;
+        part.yMin = moved.yMax;
+        display_fill( &part );
+
+        part      = moved;
+        part.xMin = area.xMin;
+        part.xMax = moved.xMin;
+        display_fill( &part );
+
+        part      = moved;
+        part.xMin = moved.xMax;
+        part.xMax = area.xMax;
+        display_fill( &part );
+      }
+
+      now = phase_end( PHASE_DRAW, now );
+    }
+
+    /* the header is written over the field */
+    band.xMin = 0;
+    band.yMin = 0;
+    band.xMax = screen.xMax;
+    band.yMax = rows > frame.header_rows ? rows : frame.header_rows;
+    box_intersect( &band, &screen );
+
+    display_fill( &band );
+    write_header();
+    now = phase_end( PHASE_HEADER, now );
+
+    if ( full )
+      grRefreshSurface( display->surface );
+    else
+    {
+      display_refresh( &area );
+      display_refresh( &band );
+    }
+    now = phase_end( PHASE_REFRESH, now );
+
+    phase_record( PHASE_FRAME, now - start );
+
+    frame.valid             = 1;
+    frame.field             = current;
+    frame.string            = shown;
+    frame.zoom              = status.zoom;
+    frame.angle             = status.angle;
+    frame.spread            = status.spread;
+    frame.nearest_filtering = status.nearest_filtering;
+    frame.mipmaps           = status.mipmaps;
+    frame.reconstruct       = status.reconstruct;
+    frame.width             = status.width;
+    frame.edge              = status.edge;
+    frame.x_offset          = status.x_offset;
+    frame.y_offset          = status.y_offset;
+    frame.region            = region;
+    frame.header_rows       = rows;
+  }
+
+
+  /*************************************************************************/
+  /*                                                                       */
+  /* Headless atlas mode.  Every requested glyph is rendered to an SDF,    */
+  /* the fields are packed into fixed-size pages with as much padding as   */
+  /* the spread, each page is written as a gray image (the distance is     */
+  /* mapped to 0..255 with 128 on the outline), and a text table with the  */
+  /* glyph metrics and atlas positions is written next to them.  No        */
+  /* display device is opened.                                             */
+  /*                                                                       */
+
+  /* sort by decreasing height, which keeps the skylines flat */
+  static int
+  compare_glyph_rows( const void*  a,
+                      const void*  b )
+  {
+    const SDF_Glyph*  ga = *(const SDF_Glyph* const*)a;
+    const SDF_Glyph*  gb = *(const SDF_Glyph* const*)b;
+
+
+    if ( ga->field.rows != gb->field.rows )
+      return gb->field.rows - ga->field.rows;
+
+    return (int)ga->field.glyph_index - (int)gb->field.glyph_index;
+  }
+
+
+  /* the atlas stores 8-bit distances */
+  static FT_Error
+  atlas_quantize( SDF_Glyph*  glyph )
+  {
+    FTDemo_SDF_Glyph  field = &glyph->field;
+
+
+    if ( !field->buffer || field->quantized )
+      return FT_Err_Ok;
+
+#ifdef UNIX
+    /* a mapped buffer belongs to the cache file */
+    if ( glyph->mapped )
+    {
+      size_t  size = (size_t)field->width * (size_t)field->rows *
+                       sizeof ( FT_Short );
+      void*   copy = malloc( size );
+
+
+      if ( !copy )
+        return FT_Err_Out_Of_Memory;
+
+      memcpy( copy, field->buffer, size );
+      FTDemo_SDF_File_Release( handle, field );
+
+      field->buffer = copy;
+      glyph->mapped = 0;
+    }
+#endif
+
+    return FTDemo_SDF_Quantize( field, field->spread );
+  }
+
+
+  /* place the glyphs in the pages of `packer' */
+  static FT_Error
+  atlas_pack( FTDemo_SDF_Atlas  packer,
+              SDF_Glyph**       sorted,
+              FT_Int            count )
+  {
+    FT_Error  error = FT_Err_Ok;
+    FT_Int    n;
+
+
+    for ( n = 0; n < count; n++ )
+    {
+      SDF_Glyph*  glyph = sorted[n];
+
+
+      error = FTDemo_SDF_Atlas_Insert( packer,
+                                       glyph->field.width,
+                                       glyph->field.rows,
+                                       &glyph->page, &glyph->x, &glyph->y );
+      if ( error == FT_Err_Invalid_Argument )
+        fprintf( stderr, "glyph %u (%dx%d) doesn't fit in a %dx%d page\n",
+                 glyph->field.glyph_index,
+                 glyph->field.width, glyph->field.rows,
+                 packer->page_width, packer->page_height );
+      if ( error )
+        break;
+    }
+
+    return error;
+  }
+
+
+  /* `file' for a single page, `file-N.ext' or `file-N' otherwise */
+  static char*
+  atlas_page_name( FT_Int  page,
+                   FT_Int  num_pages )
+  {
+    const char*  name = atlas.filename;
+    const char*  dot  = strrchr( name, '.' );
+    const char*  base = strrchr( name, '/' );
+    char*        page_name;
+    size_t       len;
+
+
+    page_name = (char*)malloc( strlen( name ) + 16 );
+    if ( !page_name )
+      return NULL;
+
+    if ( num_pages == 1 )
+      return strcpy( page_name, name );
+
+    if ( !dot || ( base && dot < base ) )
+      dot = name + strlen( name );
+
+    len = (size_t)( dot - name );
+    memcpy( page_name, name, len );
+    sprintf( page_name + len, "-%d%s", page, dot );
+
+    return page_name;
+  }
+
+
+  static FT_Error
+  atlas_write_page( FTDemo_SDF_Atlas  packer,
+                    FT_Int            page,
+                    SDF_Glyph*        glyphs,
+                    FT_Int            count )
+  {
+    FT_Error        error = FT_Err_Ok;
+    FT_Int          width = packer->page_width;
+    FT_Int          rows  = packer->page_height;
+    unsigned char*  image;
+    char*           name  = NULL;
+    FILE*           file;
+    FT_Int          n, y;
+
+
+    image = (unsigned char*)calloc( (size_t)width * (size_t)rows, 1 );
+    if ( !image )
+      return FT_Err_Out_Of_Memory;
+
+    for ( n = 0; n < count; n++ )
+    {
+      SDF_Glyph*         glyph = glyphs + n;
+      FTDemo_SDF_Glyph  field = &glyph->field;
+
+
+      if ( glyph->page != page )
+        continue;
+
+      /* the fields are quantized already */
+      for ( y = 0; y < field->rows; y++ )
+        memcpy( image + ( glyph->y + y ) * width + glyph->x,
+                (FT_Byte*)field->buffer + y * field->width,
+                (size_t)field->width );
+    }
+
+    name = atlas_page_name( page, packer->num_pages );
+    if ( !name )
+    {
+      error = FT_Err_Out_Of_Memory;
+      goto Exit;
+    }
+
+    file = fopen( name, "wb" );
+    if ( !file )
+    {
+      fprintf( stderr, "could not open `%s' for writing\n", name );
+      error = FT_Err_Cannot_Open_Resource;
+      goto Exit;
+    }
+
+    fprintf( file, "P5\n%d %d\n255\n", width, rows );
+    fwrite( image, (size_t)width, (size_t)rows, file );
+    fclose( file );
+
+    printf( "Wrote page %d to `%s' (%.1f%% used)\n",
+            page, name, 100 * FTDemo_SDF_Atlas_Occupancy( packer, page ) );
+
+  Exit:
+    free( name );
+    free( image );
+    return error;
+  }
+
+
+  static FT_Error
+  atlas_write( FTDemo_SDF_Atlas  packer,
+               SDF_Glyph*        glyphs,
+               FT_Int            count )
+  {
+    FT_Error  error = FT_Err_Ok;
+    FILE*     file;
+    char*     metrics_name;
+    FT_Int    n;
+
+
+    for ( n = 0; n < packer->num_pages; n++ )
+    {
+      error = atlas_write_page( packer, n, glyphs, count );
+      if ( error )
+        return error;
+    }
+
+    metrics_name = (char*)malloc( strlen( atlas.filename ) + 5 );
+    if ( !metrics_name )
+      return FT_Err_Out_Of_Memory;
+
+    sprintf( metrics_name, "%s.txt", atlas.filename );
+
+    file = fopen( metrics_name, "w" );
+    if ( !file )
+    {
+      fprintf( stderr, "could not open `%s' for writing\n", metrics_name );
+      free( metrics_name );
+      return FT_Err_Cannot_Open_Resource;
+    }
+
+    fprintf( file, "# ptsize %d, spread %d, source %s, "
+                   "%d page%s of %dx%d, padding %d\n",
+             status.ptsize, status.spread,
+             status.use_bitmap ? "bitmap" : "outline",
+             packer->num_pages, packer->num_pages == 1 ? "" : "s",
+             packer->page_width, packer->page_height, packer->padding );
+    fprintf( file, "# index page x y width rows left top"
+                   " advance_x advance_y\n" );
+
+    for ( n = 0; n < count; n++ )
+    {
+      SDF_Glyph*         glyph = glyphs + n;
+      FTDemo_SDF_Glyph  field = &glyph->field;
+
+
+      fprintf( file, "%u %d %d %d %d %d %d %d %.2f %.2f\n",
+               field->glyph_index, glyph->page,
+               glyph->x, glyph->y, field->width, field->rows,
+               field->left, field->top,
+               field->advance.x / 64.0, field->advance.y / 64.0 );
+    }
+
+    fclose( file );
+    free( metrics_name );
+
+    return error;
+  }
+
+
+  static FT_Error
+  sdf_worker_init( SDF_Worker*  worker,
+                   PFont        font )
+  {
+    FT_Error  error = FT_Err_Ok;
+
+
+    worker->library = NULL;
+    worker->face    = NULL;
+
+    FT_CALL( FT_Init_FreeType( &worker->library ) );
+    FT_CALL( FT_New_Memory_Face( worker->library,
+                                 (const FT_Byte*)font->file_address,
+                                 (FT_Long)font->file_size,
+                                 font->face_index,
+                                 &worker->face ) );
+    FT_CALL( FT_Set_Pixel_Sizes( worker->face, 0, status.ptsize ) );
+
+  Exit:
+    return error;
+  }
+
+
+  static void
+  sdf_worker_done( SDF_Worker*  worker )
+  {
+    if ( worker->face )
+      FT_Done_Face( worker->face );
+    if ( worker->library )
+      FT_Done_FreeType( worker->library );
+  }
+
+
+  static void
+  sdf_job_range( int    thread,
+                 int    first,
+                 int    last,
+                 void*  user )
+  {
+    SDF_Job*     job    = (SDF_Job*)user;
+    SDF_Worker*  worker = job->workers + thread;
+    int          n;
+
+
+    for ( n = first; n < last; n++ )
+    {
+      FT_Int  m = job->pending[n];
+
+
+      job->errors[m] = FTDemo_SDF_Render( worker->face,
+                                          &job->type,
+                                          job->indices[m],
+                                          &job->glyphs[m].field,
+                                          NULL );
+    }
+  }
+
+
+  static void
+  prefetch_done( void )
+  {
+    FT_Int  n;
+
+
+    for ( n = 0; n < prefetch.num_tasks; n++ )
+    {
+      FTWorker_Task_Done( prefetch.tasks[n] );
+      sdf_worker_done( prefetch.workers + n );
+    }
+
+    free( prefetch.tasks );
+    free( prefetch.workers );
+    free( prefetch.queue );
+
+    prefetch.num_tasks = 0;
+  }
+
+
+  /* one thread per processor, minus the main generator's */
+  static void
+  prefetch_init( FT_Int  num_threads )
+  {
+    FT_Int  n;
+
+
+    if ( num_threads <= 0 )
+    {
+      num_threads = FTWorker_Num_CPUs() - 1;
+      if ( num_threads < 1 )
+        num_threads = 1;
+    }
+
+    prefetch.workers = (SDF_Worker*)calloc( (size_t)num_threads,
+                                            sizeof ( SDF_Worker ) );
+    prefetch.tasks   = (FTWorker_Task*)calloc( (size_t)num_threads,
+                                               sizeof ( FTWorker_Task ) );
+    prefetch.queue   = (SDF_Request*)calloc(
+                         1 + 2 * NUM_PREFETCH_STEPS * (size_t)prefetch.depth,
+                         sizeof ( SDF_Request ) );
+    if ( !prefetch.workers || !prefetch.tasks || !prefetch.queue )
+    {
+      prefetch_done();
+      return;
+    }
+
+    for ( n = 0; n < num_threads; n++ )
+    {
+      if ( sdf_worker_init( prefetch.workers + n, handle->fonts[0] ) )
+      {
+        sdf_worker_done( prefetch.workers + n );
+        break;
+      }
 
-  float clamp(float x, float lowerlimit, float upperlimit) {
-    if (x < lowerlimit)
-      x = lowerlimit;
-    if (x > upperlimit)
-      x = upperlimit;
-    return x;
+      prefetch.tasks[n] = FTWorker_Task_New( sizeof ( SDF_Request ),
+                                             sdf_async_generate,
+                                             sdf_async_free,
+                                             prefetch.workers + n );
+      if ( !prefetch.tasks[n] )
+      {
+        sdf_worker_done( prefetch.workers + n );
+        break;
+      }
+
+      prefetch.num_tasks++;
+    }
   }
 
-  float smoothstep(float edge0, float edge1, float x) {
-    // Scale, bias and saturate x to 0..1 range
-    x = clamp((x - edge0) / (edge1 - edge0), 0.0, 1.0); 
-    // Evaluate polynomial
-    return x * x * (3 - 2 * x);
+
+  /* the glyph indices selected with `-r' or `-c', without duplicates */
+  static FT_Error
+  glyph_list( FT_Face    face,
+              FT_UInt**  aindices,
+              FT_Int*    acount )
+  {
+    FT_Byte*  wanted;
+    FT_Int    count = 0;
+    FT_Int    n;
+
+
+    *aindices = NULL;
+    *acount   = 0;
+
+    wanted = (FT_Byte*)calloc( (size_t)face->num_glyphs, 1 );
+    if ( !wanted )
+      return FT_Err_Out_Of_Memory;
+
+    if ( atlas.charset )
+    {
+      const char*  p   = atlas.charset;
+      const char*  end = p + strlen( p );
+      int          ch;
+
+
+      while ( ( ch = utf8_next( &p, end ) ) >= 0 )
+      {
+        FT_UInt  gindex = FT_Get_Char_Index( face, (FT_ULong)ch );
+
+
+        if ( gindex )
+          wanted[gindex] = 1;
+        else
+          fprintf( stderr, "no glyph for U+%04X\n", ch );
+      }
+    }
+    else
+    {
+      FT_Int  last = atlas.last;
+
+
+      if ( last < 0 || last >= face->num_glyphs )
+        last = face->num_glyphs - 1;
+
+      for ( n = atlas.first; n <= last; n++ )
+        wanted[n] = 1;
+    }
+
+    for ( n = 0; n < face->num_glyphs; n++ )
+      count += wanted[n];
+
+    *aindices = (FT_UInt*)calloc( (size_t)count + 1, sizeof ( FT_UInt ) );
+    if ( !*aindices )
+    {
+      free( wanted );
+      return FT_Err_Out_Of_Memory;
+    }
+
+    for ( count = 0, n = 0; n < face->num_glyphs; n++ )
+      if ( wanted[n] )
+        (*aindices)[count++] = (FT_UInt)n;
+
+    *acount = count;
+
+    free( wanted );
+
+    return FT_Err_Ok;
   }
 
+
   static FT_Error
-  draw()
+  atlas_build( void )
   {
-    FT_Bitmap*  bitmap = &status.face->glyph->bitmap;
-    Box         draw_region;
-    Box         sample_region;
-    Vec2        center;
-    FT_Short*   buffer;
+    FT_Error       error   = FT_Err_Ok;
+    FT_Int         count   = 0;
+    FT_Int         done    = 0;
+    FT_Int         owned   = 0;  /* leading `job.glyphs' holding a field */
+    FT_Int         num_pending = 0;
+    FT_Int         n;
+    SDF_Glyph**    sorted  = NULL;
+    SDF_Job        job;
+    FTWorker_Pool  pool    = NULL;
+    FT_Int         num_workers = 0;
+    double         start;
+    FT_Face        face;
 
+    FTDemo_SDF_AtlasRec  packer;
+    FT_UShort            error_max = 0;
+    double               error_sum = 0;
+    double               pixels    = 0;
 
-    if ( !bitmap || !bitmap->buffer )
-      return FT_Err_Invalid_Argument;
 
-    center.x = display->bitmap->width / 2;
-    center.y = display->bitmap->rows  / 2;
+    memset( &job, 0, sizeof ( job ) );
 
-    draw_region.xMin = center.x - ( bitmap->width * status.scale) / 2;
-    draw_region.xMax = center.x + ( bitmap->width * status.scale) / 2;
-    draw_region.yMin = center.y - ( bitmap->rows  * status.scale) / 2;
-    draw_region.yMax = center.y + ( bitmap->rows  * status.scale) / 2;
+    /* enough padding that no sample near an edge reads a neighbour */
+    FTDemo_SDF_Atlas_Init( &packer, atlas.page_width, atlas.page_height,
+                           status.spread );
 
-    draw_region.xMin += status.x_offset;
-    draw_region.xMax += status.x_offset;
-    draw_region.yMin += status.y_offset;
-    draw_region.yMax += status.y_offset;
+    /* the atlas is stored top-down */
+    sdf_current_type( &job.type );
+    job.type.flip_y = 0;
 
-    sample_region.xMin = 0;
-    sample_region.xMax = bitmap->width * status.scale;
-    sample_region.yMin = 0;
-    sample_region.yMax = bitmap->rows * status.scale;
+    FT_CALL( FTC_Manager_LookupFace( handle->cache_manager,
+                                     handle->scaler.face_id, &face ) );
 
-    if ( draw_region.yMin < 0 )
+    FT_CALL( glyph_list( face, &job.indices, &count ) );
+
+    job.glyphs  = (SDF_Glyph*)calloc( (size_t)count + 1, sizeof ( SDF_Glyph ) );
+    job.errors  = (FT_Error*)calloc( (size_t)count + 1, sizeof ( FT_Error ) );
+    job.pending = (FT_Int*)calloc( (size_t)count + 1, sizeof ( FT_Int ) );
+    sorted      = (SDF_Glyph**)calloc( (size_t)count + 1, sizeof ( SDF_Glyph* ) );
+    if ( !job.glyphs || !job.errors || !job.pending || !sorted )
     {
-      sample_region.yMax -= draw_region.yMin;
-      draw_region.yMin = 0;
+      error = FT_Err_Out_Of_Memory;
+      goto Exit;
     }
 
-    if ( draw_region.yMax > display->bitmap->rows )
+    /* unrendered fields are NULL */
+    owned = count;
+
+    /* only generate what the cache file doesn't have */
+    for ( n = 0; n < count; n++ )
     {
-      sample_region.yMin += draw_region.yMax - display->bitmap->rows;
-      draw_region.yMax = display->bitmap->rows;
+#ifdef UNIX
+      if ( FTDemo_SDF_File_Lookup( handle, &job.type, job.indices[n],
+                                   &job.glyphs[n].field ) )
+        job.glyphs[n].mapped = 1;
+      else
+#endif
+        job.pending[num_pending++] = n;
     }
 
-    if ( draw_region.xMin < 0 )
+    if ( count > num_pending )
+      printf( "Loaded %d glyphs from the cache file\n", count - num_pending );
+
+    if ( num_pending == 0 )
+      goto Pack;
+
+    if ( atlas.num_threads != 1 )
+      pool = FTWorker_Pool_New( atlas.num_threads );
+
+    num_workers = pool ? FTWorker_Pool_Size( pool ) : 1;
+    job.workers = (SDF_Worker*)calloc( (size_t)num_workers,
+                                       sizeof ( SDF_Worker ) );
+    if ( !job.workers )
     {
-      sample_region.xMin -= draw_region.xMin;
-      draw_region.xMin = 0;
+      error = FT_Err_Out_Of_Memory;
+      goto Exit;
     }
 
-    if ( draw_region.xMax > display->bitmap->width )
+    for ( n = 0; n < num_workers; n++ )
     {
-      sample_region.xMax += draw_region.xMax - display->bitmap->width;
-      draw_region.xMax = display->bitmap->width;
+      FT_CALL( sdf_worker_init( job.workers + n, handle->fonts[0] ) );
     }
 
-    buffer = (FT_Short*)bitmap->buffer;
+    start = FTDemo_Get_Time();
 
-    for ( FT_Int j = draw_region.yMax - 1, y = sample_region.yMin; j >= draw_region.yMin; j--, y++ )
+    /* glyph costs vary a lot, so keep the chunks small */
+    FTWorker_Pool_Run( pool, num_pending, 8, sdf_job_range, &job );
+
+    printf( "Generated %d glyphs with %d thread%s in %.0f ms\n",
+            num_pending, num_workers, num_workers == 1 ? "" : "s",
+            ( FTDemo_Get_Time() - start ) / 1E6 );
+
+#ifdef UNIX
+    for ( n = 0; n < num_pending; n++ )
+    {
+      FT_Int  m = job.pending[n];
+
+
+      if ( !job.errors[m] )
+        FTDemo_SDF_File_Store( handle, &job.type, &job.glyphs[m].field );
+    }
+#endif
+
+  Pack:
+    /* a broken glyph shouldn't spoil the whole atlas */
+    for ( done = 0, n = 0; n < count; n++ )
     {
-      for ( FT_Int i = draw_region.xMin, x = sample_region.xMin; i < draw_region.xMax; i++, x++ )
+      if ( job.errors[n] )
       {
-        FT_UInt   display_index = j * display->bitmap->width + i;
-        float     min_dist;
+        fprintf( stderr, "skipping glyph %u: %s\n",
+                 job.indices[n], FT_Error_String( job.errors[n] ) );
+        if ( !job.glyphs[n].mapped )
+          free( job.glyphs[n].field.buffer );
+        continue;
+      }
 
-        if ( status.nearest_filtering )
-        {
-          FT_UInt   bitmap_index  = ( y / status.scale ) * bitmap->width + ( x / status.scale );
-          FT_Short  pixel_value   = buffer[bitmap_index];
-          
-          
-          min_dist = (float)pixel_value / 1024.0f;
-        }
+      job.glyphs[done++] = job.glyphs[n];
+    }
+
+    owned = done;
+
+    for ( n = 0; n < done; n++ )
+    {
+      FT_CALL( atlas_quantize( job.glyphs + n ) );
+
+      sorted[n] = job.glyphs + n;
+    }
+
+    qsort( sorted, (size_t)done, sizeof ( SDF_Glyph* ), compare_glyph_rows );
+    FT_CALL( atlas_pack( &packer, sorted, done ) );
+    FT_CALL( atlas_write( &packer, job.glyphs, done ) );
+
+    printf( "Packed %d glyphs into %d page%s of %dx%d, %.1f%% used\n",
+            done, packer.num_pages, packer.num_pages == 1 ? "" : "s",
+            packer.page_width, packer.page_height,
+            100 * FTDemo_SDF_Atlas_Occupancy( &packer, -1 ) );
+
+    /* what the 8-bit distances lost, in pixels */
+    for ( n = 0; n < done; n++ )
+    {
+      FTDemo_SDF_Glyph  field = &job.glyphs[n].field;
+
+
+      if ( error_max < field->error_max )
+        error_max = field->error_max;
+      error_sum += (double)field->error_rms * field->error_rms *
+                     field->width * field->rows;
+      pixels    += (double)field->width * field->rows;
+    }
+
+    printf( "Quantization error: max %.4f, rms %.4f pixels\n",
+            error_max / 1024.0,
+            pixels ? sqrt( error_sum / pixels ) / 1024.0 : 0.0 );
+
+  Exit:
+    FTDemo_SDF_Atlas_Done( &packer );
+    FTWorker_Pool_Done( pool );
+
+    if ( job.workers )
+      for ( n = 0; n < num_workers; n++ )
+        sdf_worker_done( job.workers + n );
+
+    if ( job.glyphs )
+    {
+      for ( n = 0; n < owned; n++ )
+      {
+#ifdef UNIX
+        if ( job.glyphs[n].mapped )
+          FTDemo_SDF_File_Release( handle, &job.glyphs[n].field );
         else
-        {
-          /* for simplicity use floats */
-          float  bi_x;
-          float  bi_y;
+#endif
+          free( job.glyphs[n].field.buffer );
+      }
+    }
 
-          float  nbi_x;
-          float  nbi_y;
+    free( job.workers );
+    free( job.indices );
+    free( job.glyphs );
+    free( job.errors );
+    free( job.pending );
+    free( sorted );
 
-          int    indc[4]; /* [0,0] [0,1] [1,0] [1,1] */
-          float  dist[4];
+    return error;
+  }
 
-          float  m1, m2;
 
-          bi_x = (float)x / (float)status.scale;
-          bi_y = (float)y / (float)status.scale;
+  /* parse a comma-separated list of numbers in [min,max] */
+  static FT_Int
+  parse_list( const char*  list,
+              FT_Int*      values,
+              FT_Int       min,
+              FT_Int       max )
+  {
+    FT_Int  count = 0;
+    char*   end;
+
 
-          nbi_x = bi_x - (int)bi_x;
-          nbi_y = bi_y - (int)bi_y;
+    while ( count < BENCH_MAX_VALUES )
+    {
+      long  value = strtol( list, &end, 10 );
 
-          indc[0] = (int)bi_y * bitmap->width + (int)bi_x;
-          indc[1] = ( (int)bi_y + 1 ) * bitmap->width + (int)bi_x;
-          indc[2] = (int)bi_y * bitmap->width + (int)bi_x + 1;
-          indc[3] = ( (int)bi_y + 1 ) * bitmap->width + (int)bi_x + 1;
 
-          dist[0] = (float)buffer[indc[0]] / 1024.0f;
+      if ( end == list || value < min || value > max )
+        return 0;
 
-          if ( indc[1] >= bitmap->width * bitmap->rows )
-            dist[1] = -status.spread;
-          else
-            dist[1] = (float)buffer[indc[1]] / 1024.0f;
+      values[count++] = (FT_Int)value;
 
-          if ( indc[2] >= bitmap->width * bitmap->rows )
-            dist[2] = -status.spread;
-          else
-            dist[2] = (float)buffer[indc[2]] / 1024.0f;
+      if ( *end != ',' )
+        break;
+      list = end + 1;
+    }
 
-          if ( indc[3] >= bitmap->width * bitmap->rows )
-            dist[3] = -status.spread;
-          else
-            dist[3] = (float)buffer[indc[3]] / 1024.0f;
+    return *end ? 0 : count;
+  }
 
-          m1 = dist[0] * ( 1.0f - nbi_y ) + dist[1] * nbi_y;
-          m2 = dist[2] * ( 1.0f - nbi_y ) + dist[3] * nbi_y;
 
-          min_dist = ( 1.0f - nbi_x ) * m1 +
-                       ( nbi_x ) * m2;
-        }
+  /* render every configuration `bench.runs' times and report */
+  /* statistics of the single glyph times                     */
+  static FT_Error
+  bench_run( void )
+  {
+    FT_Error            error   = FT_Err_Ok;
+    FILE*               out     = stdout;
+    FT_UInt*            indices = NULL;
+    double*             samples = NULL;
+    FT_Int              num_rows = 0;
+    FT_Int              f, i, j, run, n, count;
+    const char*         source;
+    FTDemo_SDF_TypeRec  type;
 
 
-        if ( status.reconstruct )
-        {
-          float alpha;
+    if ( bench.output )
+    {
+      out = fopen( bench.output, "w" );
+      if ( !out )
+      {
+        fprintf( stderr, "could not open `%s' for writing\n", bench.output );
+        return FT_Err_Cannot_Open_Resource;
+      }
+    }
 
+    if ( bench.json )
+      fprintf( out, "[" );
+    else
+      fprintf( out, "font,face,size,spread,source,overlaps,glyphs,samples,"
+                    "errors,min_ns,median_ns,p95_ns,p99_ns,mean_ns\n" );
 
-          alpha  = 1.0f - smoothstep( status.width, status.width + status.edge, -min_dist );
-          alpha *= 255;
+    for ( f = 0; f < handle->num_fonts; f++ )
+    {
+      PFont    font = handle->fonts[f];
+      FT_Face  face;
 
-          display_index *= 3;
-          display->bitmap->buffer[display_index + 0] = (unsigned char)alpha;
-          display->bitmap->buffer[display_index + 1] = (unsigned char)alpha;
-          display->bitmap->buffer[display_index + 2] = (unsigned char)alpha;
-        }
-        else
-        {
-          float final_dist = min_dist;
 
+      FTDemo_Set_Current_Font( handle, font );
+      FT_CALL( FTC_Manager_LookupFace( handle->cache_manager,
+                                       handle->scaler.face_id, &face ) );
 
-          /* for display purposes */
-          final_dist = final_dist < 0 ? -final_dist : final_dist;
-          final_dist /= (float)status.spread;
+      free( indices );
+      FT_CALL( glyph_list( face, &indices, &count ) );
 
-          final_dist = 1.0f - final_dist;
-          final_dist *= 255;
+      free( samples );
+      samples = (double*)malloc( ( (size_t)count * (size_t)bench.runs + 1 ) *
+                                 sizeof ( double ) );
+      if ( !samples )
+      {
+        error = FT_Err_Out_Of_Memory;
+        goto Exit;
+      }
 
-          display_index *= 3;
-          display->bitmap->buffer[display_index + 0] = (unsigned char)final_dist;
-          display->bitmap->buffer[display_index + 1] = (unsigned char)final_dist;
-          display->bitmap->buffer[display_index + 2] = (unsigned char)final_dist;
-        }
+      for ( i = 0; i < bench.num_sizes; i++ )
+        for ( j = 0; j < bench.num_spreads; j++ )
+          for ( source = bench.sources; *source; source++ )
+          {
+            FT_Size  size;
+            FT_Int   num_samples = 0;
+            FT_Int   num_errors  = 0;
+            double   total       = 0;
+
+
+            sdf_state_type( &type, bench.sizes[i] );
+            type.spread     = bench.spreads[j];
+            type.use_bitmap = *source == 'b';
+            type.overlaps   = *source == 'O';
+            type.flip_y     = 0;
+
+            FT_CALL( FTC_Manager_LookupSize( handle->cache_manager,
+                                             &type.scaler, &size ) );
+
+            for ( run = -bench.warmup; run < bench.runs; run++ )
+              for ( n = 0; n < count; n++ )
+              {
+                FTDemo_SDF_GlyphRec  glyph;
+                FT_Error             err;
+                double               start = FTDemo_Get_Time();
+
+
+                err = FTDemo_SDF_Render( size->face, &type, indices[n],
+                                         &glyph, NULL );
+                start = FTDemo_Get_Time() - start;
+
+                free( glyph.buffer );
+
+                if ( run < 0 )
+                  continue;
+
+                if ( err )
+                  num_errors++;
+                else
+                {
+                  samples[num_samples++] = start;
+                  total                 += start;
+                }
+              }
+
+            qsort( samples, (size_t)num_samples, sizeof ( double ),
+                   compare_times );
+
+            if ( bench.json )
+              fprintf( out, "%s\n"
+                            "  { \"font\": \"%s\", \"face\": %d,"
+                            " \"size\": %d, \"spread\": %d,"
+                            " \"source\": \"%s\", \"overlaps\": %s,\n"
+                            "    \"glyphs\": %d, \"samples\": %d,"
+                            " \"errors\": %d,\n"
+                            "    \"min_ns\": %.0f, \"median_ns\": %.0f,"
+                            " \"p95_ns\": %.0f, \"p99_ns\": %.0f,"
+                            " \"mean_ns\": %.0f }",
+                       num_rows ? "," : "",
+                       ft_basename( font->filepathname ), font->face_index,
+                       bench.sizes[i], bench.spreads[j],
+                       type.use_bitmap ? "bitmap" : "outline",
+                       type.overlaps ? "true" : "false",
+                       count, num_samples, num_errors,
+                       num_samples ? samples[0] : 0.0,
+                       num_samples ? percentile( samples, num_samples, 50 ) : 0.0,
+                       num_samples ? percentile( samples, num_samples, 95 ) : 0.0,
+                       num_samples ? percentile( samples, num_samples, 99 ) : 0.0,
+                       num_samples ? total / num_samples : 0.0 );
+            else
+              fprintf( out, "%s,%d,%d,%d,%s,%d,%d,%d,%d,"
+                            "%.0f,%.0f,%.0f,%.0f,%.0f\n",
+                       ft_basename( font->filepathname ), font->face_index,
+                       bench.sizes[i], bench.spreads[j],
+                       type.use_bitmap ? "bitmap" : "outline",
+                       type.overlaps,
+                       count, num_samples, num_errors,
+                       num_samples ? samples[0] : 0.0,
+                       num_samples ? percentile( samples, num_samples, 50 ) : 0.0,
+                       num_samples ? percentile( samples, num_samples, 95 ) : 0.0,
+                       num_samples ? percentile( samples, num_samples, 99 ) : 0.0,
+                       num_samples ? total / num_samples : 0.0 );
+
+            fflush( out );
+            num_rows++;
+          }
+    }
+
+    if ( bench.json )
+      fprintf( out, "\n]\n" );
+
+  Exit:
+    if ( out != stdout )
+      fclose( out );
+
+    free( samples );
+    free( indices );
+
+    return error;
+  }
+
+
+  /* Look for a default benchmark font next to the executable or, */
+  /* for libtool's `.libs' subdirectory, one level above it.       */
+  static char*
+  bench_font_path( const char*  exepath,
+                   const char*  font,
+                   char*        path )
+  {
+    size_t  dirlen = (size_t)( ft_basename( exepath ) - exepath );
+    FILE*   file;
+    int     i;
+
+    static const char*  subdirs[2] = { "", "../" };
+
+
+    if ( dirlen + 3 + strlen( font ) >= sizeof ( bench_paths[0] ) )
+      return NULL;
+
+    for ( i = 0; i < 2; i++ )
+    {
+      sprintf( path, "%.*s%s%s", (int)dirlen, exepath, subdirs[i], font );
+
+      file = fopen( path, "rb" );
+      if ( file )
+      {
+        fclose( file );
+        return path;
       }
     }
 
-    return FT_Err_Ok;
+    return NULL;
+  }
+
+
+  static void
+  usage( char*  execname )
+  {
+    fprintf( stderr,
+      "\n"
+      "ftsdf: signed distance field viewer -- part of the FreeType project\n"
+      "-------------------------------------------------------------------\n"
+      "\n" );
+    fprintf( stderr,
+      "Usage: %s [options] ptsize font\n"
+      "       %s -B [options] [font ...]\n"
+      "\n",
+             execname, execname );
+    fprintf( stderr,
+      "  ptsize    The pixel size of the generated glyphs.\n"
+      "  font      The font file to use.\n"
+      "\n"
+      "  -s spread Set the spread of the distance field (default: 4).\n"
+      "  -b        Generate from a rendered bitmap instead of the outline.\n"
+      "  -m        Enable overlapping contour support.\n"
+      "  -q        Store the fields with 8-bit distances (key `e' toggles).\n"
+      "  -M size   Keep at most `size' kByte of generated fields in memory\n"
+      "            (default: 32768).\n"
+#ifdef UNIX
+      "  -C file   Keep generated fields in the cache file `file' and\n"
+      "            reuse them in later runs.\n"
+#endif
+      "  -p depth  Pregenerate the glyphs up to `depth' key presses away\n"
+      "            (default: 1; 0 disables).\n"
+      "  -P size   Keep at most `size' kByte of pregenerated fields that\n"
+      "            haven't been looked at yet (default: 8192).\n"
+      "  -D count  Draw with `count' threads (default: one per processor).\n"
+      "  -d depth  Use a display surface of this depth: 32 (xrgb), 24 (rgb),\n"
+      "            or 8 (gray) (default: the first of 32, 8, 24 that the\n"
+      "            device supports).\n"
+      "  -Z zoom   Set the initial zoom factor, 0.125 to 64 (default: 1).\n"
+      "  -R angle  Set the initial rotation in degrees (default: 0).\n"
+      "  -T file   Write the timings of the drawing phases to `file'\n"
+      "            at exit.\n"
+      "  -t text   Show the UTF-8 string `text' instead of a single glyph\n"
+      "            (key `n' toggles).\n"
+      "\n"
+      "  -a file   Don't open a window; render all glyphs into the pages of\n"
+      "            an SDF atlas, `file' or `file-N' (binary PGM), and write\n"
+      "            their metrics to `file.txt'.\n"
+      "  -r N-M    Restrict the atlas to glyph indices N to M.\n"
+      "  -c chars  Build the atlas from the glyphs of the given UTF-8\n"
+      "            characters instead of glyph indices.\n"
+      "  -w WxH    Set the size of the atlas pages; a single number\n"
+      "            makes square pages (default: 1024).\n"
+      "  -j count  Use `count' threads for the atlas or for pregenerating\n"
+      "            glyphs (default: one per processor).\n"
+      "\n"
+      "  -B        Don't open a window; benchmark the generation of the\n"
+      "            glyphs selected with `-r' or `-c' (default: 0-99) and\n"
+      "            report min/median/p95/p99 times per configuration.\n"
+      "            The default fonts are `Roboto-Regular.ttf' and\n"
+      "            `CascadiaCode.ttf' from the executable's directory;\n"
+      "            name the fonts explicitly if they are not found.\n"
+      "  -S list   Benchmark these comma-separated pixel sizes\n"
+      "            (default: 16,32,64).\n"
+      "  -E list   Benchmark these comma-separated spreads (default: 2,8).\n"
+      "  -O chars  Benchmark these sources: `o' (outline), `O' (outline\n"
+      "            with overlap support), `b' (bitmap) (default: oOb).\n"
+      "  -W count  Do `count' unmeasured warmup runs (default: 1).\n"
+      "  -n count  Do `count' measured runs (default: 5).\n"
+      "  -f format Write `csv' (default) or `json'.\n"
+      "  -o file   Write the benchmark results to `file'.\n"
+      "\n" );
+
+    exit( 1 );
   }
 
+
   int
   main( int     argc,
         char**  argv )
   {
     FT_Error  error = FT_Err_Ok;
+    char*     exepath = argv[0];
+    char*     execname;
+    int       option;
+    FT_ULong  max_bytes = MAX_SDF_BYTES;
+#ifdef UNIX
+    char*     cache_file = NULL;
+#endif
+
+    /* surface depths to try, in order: xrgb32 is what most X servers */
+    /* use, gray8 is a third of the rgb24 stores and conversion      */
+    int       depths[4] = { 32, 8, 24, 0 };
+    int       i;
+
+
+    execname = ft_basename( argv[0] );
+
+    while ( ( option = getopt( argc, argv, "a:BbC:c:D:d:E:f:j:KmM:n:O:o:p:P:qR:r:S:s:T:t:W:w:Z:" ) ) != -1 )
+    {
+      switch ( option )
+      {
+      case 'a':
+        atlas.filename = optarg;
+        break;
+      case 'B':
+        bench.enabled = 1;
+        break;
+      case 'b':
+        status.use_bitmap = 1;
+        break;
+#ifdef UNIX
+      case 'C':
+        cache_file = optarg;
+        break;
+#endif
+      case 'c':
+        atlas.charset = optarg;
+        break;
+      case 'D':
+        draw_threads = atoi( optarg );
+        if ( draw_threads < 0 )
+          usage( execname );
+        break;
+      case 'd':
+        depths[0] = atoi( optarg );
+        depths[1] = 0;
+        if ( depths[0] != 8 && depths[0] != 24 && depths[0] != 32 )
+          usage( execname );
+        break;
+      case 'K':
+        /* not in the usage: check the drawing kernels and quit */
+        exit( draw_self_test( 20000 ) ? 1 : 0 );
+      case 'E':
+        bench.num_spreads = parse_list( optarg, bench.spreads, 2, 32 );
+        if ( !bench.num_spreads )
+          usage( execname );
+        break;
+      case 'f':
+        if ( !strcmp( optarg, "json" ) )
+          bench.json = 1;
+        else if ( strcmp( optarg, "csv" ) )
+          usage( execname );
+        break;
+      case 'j':
+        atlas.num_threads = atoi( optarg );
+        if ( atlas.num_threads < 0 )
+          usage( execname );
+        break;
+      case 'm':
+        status.overlaps = 1;
+        break;
+      case 'q':
+        status.quantized = 1;
+        break;
+      case 'M':
+        max_bytes = (FT_ULong)atol( optarg ) << 10;
+        break;
+      case 'n':
+        bench.runs = atoi( optarg );
+        if ( bench.runs < 1 )
+          usage( execname );
+        break;
+      case 'O':
+        if ( !*optarg || strspn( optarg, "oOb" ) != strlen( optarg ) )
+          usage( execname );
+        bench.sources = optarg;
+        break;
+      case 'o':
+        bench.output = optarg;
+        break;
+      case 'p':
+        prefetch.depth = atoi( optarg );
+        if ( prefetch.depth < 0 || prefetch.depth > 16 )
+          usage( execname );
+        break;
+      case 'P':
+        prefetch.max_bytes = (FT_ULong)atol( optarg ) << 10;
+        break;
+      case 'R':
+        status.angle = (FT_Angle)( atof( optarg ) * 65536.0 ) % FT_ANGLE_2PI;
+        event_rotate( 0 );
+        break;
+      case 'r':
+        {
+          int  n = sscanf( optarg, "%d-%d", &atlas.first, &atlas.last );
+
+
+          if ( n < 1 || atlas.first < 0                  ||
+               ( n == 2 && atlas.last < atlas.first )    )
+            usage( execname );
+        }
+        break;
+      case 'S':
+        bench.num_sizes = parse_list( optarg, bench.sizes, 1, 0xFFFF );
+        if ( !bench.num_sizes )
+          usage( execname );
+        break;
+      case 's':
+        status.spread = atoi( optarg );
+        if ( status.spread < 2 || status.spread > 32 )
+          usage( execname );
+        break;
+      case 'T':
+        timing_file = optarg;
+        break;
+      case 't':
+        sdf_text           = optarg;
+        status.show_string = 1;
+        break;
+      case 'W':
+        bench.warmup = atoi( optarg );
+        if ( bench.warmup < 0 )
+          usage( execname );
+        break;
+      case 'w':
+        switch ( sscanf( optarg, "%dx%d",
+                         &atlas.page_width, &atlas.page_height ) )
+        {
+        case 1:
+          atlas.page_height = atlas.page_width;
+          break;
+        case 2:
+          break;
+        default:
+          usage( execname );
+        }
+        if ( atlas.page_width < 16 || atlas.page_height < 16 )
+          usage( execname );
+        break;
+      case 'Z':
+        status.zoom = (FT_Fixed)( atof( optarg ) * 65536.0 );
+        if ( status.zoom < zoom_level( ZOOM_LEVEL_MIN ) ||
+             status.zoom > zoom_level( ZOOM_LEVEL_MAX ) )
+          usage( execname );
+        break;
+      default:
+        usage( execname );
+        break;
+      }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if ( bench.enabled )
+    {
+      /* without `-r' or `-c', time a fixed and manageable range */
+      if ( !atlas.charset && atlas.first == 0 && atlas.last < 0 )
+        atlas.last = 99;
 
+      if ( argc == 0 )
+      {
+        for ( i = 0; i < (int)N_BENCH_FONTS; i++ )
+        {
+          bench_args[i] = bench_font_path( exepath, bench_fonts[i],
+                                           bench_paths[i] );
+          if ( !bench_args[i] )
+          {
+            fprintf( stderr, "could not find default font `%s'"
+                             " next to `%s'; name the fonts to benchmark\n",
+                             bench_fonts[i], exepath );
+            exit( 1 );
+          }
+        }
 
-    if ( argc != 3 )
+        argc = (int)N_BENCH_FONTS;
+        argv = bench_args;
+      }
+    }
+    else
     {
-      printf( "Usage: [ptsize] [font file]\n" );
-      exit( -1 );
+      if ( argc != 2 )
+        usage( execname );
+
+      status.ptsize = atoi( argv[0] );
+      argc--;
+      argv++;
     }
 
-    status.ptsize = atoi( argv[1] );
     handle = FTDemo_New();
 
     if ( !handle )
@@ -503,7 +4134,67 @@
       goto Exit;
     }
 
-    display = FTDemo_Display_New( NULL, "800x600" );
+    /* keep the font bytes in memory so that worker threads can */
+    /* open their own faces cheaply                              */
+    FTDemo_Set_Preload( handle, 1 );
+
+    /* the string maps characters with the Unicode charmap; */
+    /* single glyphs are still chosen by index              */
+    handle->encoding = FT_ENCODING_UNICODE;
+
+    for ( ; argc > 0; argc--, argv++ )
+    {
+      int  num_fonts = handle->num_fonts;
+
+
+      FT_CALL( FTDemo_Install_Font( handle, argv[0], 0, 1 ) );
+      if ( handle->num_fonts == num_fonts )
+      {
+        fprintf( stderr, "could not open font `%s'\n", argv[0] );
+        error = FT_Err_Unknown_File_Format;
+        goto Exit;
+      }
+    }
+
+    FTDemo_Set_Current_Font( handle, handle->fonts[0] );
+    FTDemo_SDF_Cache_Set_Max_Bytes( handle, max_bytes );
+
+#ifdef UNIX
+    /* a broken cache file only costs speed */
+    if ( cache_file )
+    {
+      error = FTDemo_SDF_Cache_Open_File( handle, cache_file );
+      if ( error )
+        fprintf( stderr, "could not use cache file `%s': %s\n",
+                 cache_file, FT_Error_String( error ) );
+      error = FT_Err_Ok;
+    }
+#endif
+
+    if ( bench.enabled )
+    {
+      error = bench_run();
+      goto Exit;
+    }
+
+    if ( atlas.filename )
+    {
+      error = atlas_build();
+      goto Exit;
+    }
+
+    for ( i = 0; !display && depths[i]; i++ )
+    {
+      char  dims[32];
+
+
+      sprintf( dims, "800x600x%d", depths[i] );
+      display = FTDemo_Display_New( NULL, dims );
+
+      /* the devices are initialized again for the next depth */
+      if ( !display )
+        grDoneDevices();
+    }
 
     if ( !display )
     {
@@ -512,31 +4203,56 @@
     }
 
 #ifdef __linux__
-    int flip_y = 1;
-	FT_CALL( FT_Property_Set( handle->library, "sdf", "flip_y", &flip_y ) );
-	FT_CALL( FT_Property_Set( handle->library, "bsdf", "flip_y", &flip_y ) );
+    status.flip_y = 1;
 #endif
 
+    /* without a generator thread, render in the event loop */
+    if ( !sdf_worker_init( &async_worker, handle->fonts[0] ) )
+      async_task = FTWorker_Task_New( sizeof ( SDF_Request ),
+                                      sdf_async_generate,
+                                      sdf_async_free,
+                                      &async_worker );
+
+    /* prefetching needs the generator to yield to */
+    if ( async_task && prefetch.depth > 0 )
+      prefetch_init( atlas.num_threads );
+
+    draw_init();
+
+    if ( draw_threads != 1 )
+      draw_pool = FTWorker_Pool_New( draw_threads );
+
     grSetTitle( display->surface, "Signed Distance Field Viewer" );
     event_color_change();
 
-    FT_CALL( FT_New_Face( handle->library, argv[2], 0, &status.face ) );
     FT_CALL( event_font_update() );
 
     do 
     {
-      FTDemo_Display_Clear( display );
+      display_update();
+    } while ( !Process_Event() );
 
-      draw();
+  Exit:
+    if ( handle && prefetch.num_tasks )
+      printf( "Prefetch: %lu fields generated, %lu used\n",
+              handle->sdf_cache->prefetches,
+              handle->sdf_cache->prefetch_hits );
 
-      write_header();
+    if ( timing_file )
+      phase_dump( timing_file );
 
-      grRefreshSurface( display->surface );
-    } while ( !Process_Event() );
+    if ( handle )
+    {
+      sdf_next_done();
+      FTDemo_SDF_String_Done( handle, &sdf_string );
+      sdf_set_current( NULL );
+    }
+
+    prefetch_done();
+    FTWorker_Pool_Done( draw_pool );
+    FTWorker_Task_Done( async_task );
+    sdf_worker_done( &async_worker );
 
-  Exit:
-    if ( status.face )
-      FT_Done_Face( status.face );
     if ( display )
       FTDemo_Display_Done( display );
     if ( handle )
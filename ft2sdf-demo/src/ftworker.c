@@ -0,0 +1,704 @@
+/****************************************************************************/
+/*                                                                          */
+/*  The FreeType project -- a free and portable quality TrueType renderer.  */
+/*                                                                          */
+/*  Copyright (C) 2020 by                                                   */
+/*  D. Turner, R.Wilhelm, and W. Lemberg                                    */
+/*                                                                          */
+/*                                                                          */
+/*  ftworker.c - a small worker thread pool for the FreeType demo programs. */
+/*                                                                          */
+/****************************************************************************/
+
+
+#include "ftworker.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+  /*************************************************************************/
+  /*                                                                       */
+  /* Minimal threading primitives: POSIX threads everywhere except on      */
+  /* Windows.                                                              */
+  /*                                                                       */
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+  typedef HANDLE              ft_thread;
+  typedef CRITICAL_SECTION    ft_mutex;
+  typedef CONDITION_VARIABLE  ft_cond;
+
+#define ft_mutex_init( m )     InitializeCriticalSection( m )
+#define ft_mutex_done( m )     DeleteCriticalSection( m )
+#define ft_mutex_lock( m )     EnterCriticalSection( m )
+#define ft_mutex_unlock( m )   LeaveCriticalSection( m )
+
+#define ft_cond_init( c )      InitializeConditionVariable( c )
+#define ft_cond_done( c )      /* nothing */
+#define ft_cond_wait( c, m )   SleepConditionVariableCS( c, m, INFINITE )
+#define ft_cond_timedwait( c, m, ms )                    \
+          SleepConditionVariableCS( c, m, (DWORD)( ms ) )
+#define ft_cond_signal( c )    WakeConditionVariable( c )
+#define ft_cond_broadcast( c ) WakeAllConditionVariable( c )
+
+#define FT_THREAD_FUNC( name, arg )  static DWORD WINAPI name( LPVOID  arg )
+#define FT_THREAD_RETURN             return 0
+
+#else /* !_WIN32 */
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+  typedef pthread_t        ft_thread;
+  typedef pthread_mutex_t  ft_mutex;
+  typedef pthread_cond_t   ft_cond;
+
+#define ft_mutex_init( m )     pthread_mutex_init( m, NULL )
+#define ft_mutex_done( m )     pthread_mutex_destroy( m )
+#define ft_mutex_lock( m )     pthread_mutex_lock( m )
+#define ft_mutex_unlock( m )   pthread_mutex_unlock( m )
+
+#define ft_cond_init( c )      pthread_cond_init( c, NULL )
+#define ft_cond_done( c )      pthread_cond_destroy( c )
+#define ft_cond_wait( c, m )   pthread_cond_wait( c, m )
+#define ft_cond_signal( c )    pthread_cond_signal( c )
+#define ft_cond_broadcast( c ) pthread_cond_broadcast( c )
+
+#define FT_THREAD_FUNC( name, arg )  static void* name( void*  arg )
+#define FT_THREAD_RETURN             return NULL
+
+
+  static void
+  ft_cond_timedwait( ft_cond*   cond,
+                     ft_mutex*  mutex,
+                     int        ms )
+  {
+    struct timespec  ts;
+
+
+    clock_gettime( CLOCK_REALTIME, &ts );
+
+    ts.tv_sec  += ms / 1000;
+    ts.tv_nsec += ( ms % 1000 ) * 1000000L;
+    if ( ts.tv_nsec >= 1000000000L )
+    {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+
+    pthread_cond_timedwait( cond, mutex, &ts );
+  }
+
+#endif /* !_WIN32 */
+
+
+  /* the chunks [head,tail) still to be processed by a thread */
+  typedef struct  FTWorker_QueueRec_
+  {
+    ft_mutex  lock;
+    int       head;
+    int       tail;
+
+  } FTWorker_QueueRec, *FTWorker_Queue;
+
+
+  typedef struct  FTWorker_ThreadRec_
+  {
+    FTWorker_Pool  pool;
+    int            index;
+    ft_thread      thread;
+
+  } FTWorker_ThreadRec, *FTWorker_Thread;
+
+
+  typedef struct  FTWorker_PoolRec_
+  {
+    int                 num_threads;
+    FTWorker_Thread     threads;
+    FTWorker_Queue      queues;
+
+    ft_mutex            lock;
+    ft_cond             start_cond;  /* a new job or shutdown */
+    ft_cond             done_cond;   /* last thread finished the job */
+
+    unsigned long       generation;  /* incremented for each job */
+    int                 running;     /* threads busy with current job */
+    int                 quit;
+
+    /* the current job */
+    int                 count;
+    int                 chunk;
+    FTWorker_RangeFunc  func;
+    void*               user;
+
+  } FTWorker_PoolRec;
+
+
+  int
+  FTWorker_Num_CPUs( void )
+  {
+    long  n;
+
+
+#ifdef _WIN32
+    SYSTEM_INFO  info;
+
+
+    GetSystemInfo( &info );
+    n = (long)info.dwNumberOfProcessors;
+#elif defined( _SC_NPROCESSORS_ONLN )
+    n = sysconf( _SC_NPROCESSORS_ONLN );
+#else
+    n = 1;
+#endif
+
+    return n < 1 ? 1 : (int)n;
+  }
+
+
+  /* take the next chunk of our own queue */
+  static int
+  queue_pop( FTWorker_Queue  queue,
+             int*            achunk )
+  {
+    int  found = 0;
+
+
+    ft_mutex_lock( &queue->lock );
+    if ( queue->head < queue->tail )
+    {
+      *achunk = queue->head++;
+      found   = 1;
+    }
+    ft_mutex_unlock( &queue->lock );
+
+    return found;
+  }
+
+
+  /* move the upper half of the fullest other queue into ours */
+  static int
+  queue_steal( FTWorker_Pool  pool,
+               int            index,
+               int*           achunk )
+  {
+    FTWorker_Queue  own = pool->queues + index;
+    int             n;
+
+
+    for ( n = 1; n < pool->num_threads; n++ )
+    {
+      FTWorker_Queue  victim = pool->queues +
+                                 ( index + n ) % pool->num_threads;
+      int             first  = 0;
+      int             last   = 0;
+
+
+      ft_mutex_lock( &victim->lock );
+      if ( victim->head < victim->tail )
+      {
+        last         = victim->tail;
+        first        = last - ( last - victim->head + 1 ) / 2;
+        victim->tail = first;
+      }
+      ft_mutex_unlock( &victim->lock );
+
+      if ( first < last )
+      {
+        ft_mutex_lock( &own->lock );
+        own->head = first + 1;
+        own->tail = last;
+        ft_mutex_unlock( &own->lock );
+
+        *achunk = first;
+        return 1;
+      }
+    }
+
+    return 0;
+  }
+
+
+  static void
+  pool_work( FTWorker_Pool  pool,
+             int            index )
+  {
+    int  chunk;
+
+
+    while ( queue_pop( pool->queues + index, &chunk ) ||
+            queue_steal( pool, index, &chunk )        )
+    {
+      int  first = chunk * pool->chunk;
+      int  last  = first + pool->chunk;
+
+
+      if ( last > pool->count )
+        last = pool->count;
+
+      pool->func( index, first, last, pool->user );
+    }
+  }
+
+
+  FT_THREAD_FUNC( pool_thread, arg )
+  {
+    FTWorker_Thread  self = (FTWorker_Thread)arg;
+    FTWorker_Pool    pool = self->pool;
+    unsigned long    seen = 0;
+
+
+    ft_mutex_lock( &pool->lock );
+
+    for (;;)
+    {
+      while ( !pool->quit && pool->generation == seen )
+        ft_cond_wait( &pool->start_cond, &pool->lock );
+
+      if ( pool->quit )
+        break;
+
+      seen = pool->generation;
+      ft_mutex_unlock( &pool->lock );
+
+      pool_work( pool, self->index );
+
+      ft_mutex_lock( &pool->lock );
+      if ( --pool->running == 0 )
+        ft_cond_signal( &pool->done_cond );
+    }
+
+    ft_mutex_unlock( &pool->lock );
+
+    FT_THREAD_RETURN;
+  }
+
+
+  FTWorker_Pool
+  FTWorker_Pool_New( int  num_threads )
+  {
+    FTWorker_Pool  pool;
+    int            n;
+
+
+    if ( num_threads <= 0 )
+      num_threads = FTWorker_Num_CPUs();
+
+    pool = (FTWorker_Pool)calloc( 1, sizeof ( FTWorker_PoolRec ) );
+    if ( !pool )
+      return NULL;
+
+    pool->threads = (FTWorker_Thread)calloc( (size_t)num_threads,
+                                             sizeof ( FTWorker_ThreadRec ) );
+    pool->queues  = (FTWorker_Queue)calloc( (size_t)num_threads,
+                                            sizeof ( FTWorker_QueueRec ) );
+    if ( !pool->threads || !pool->queues )
+    {
+      free( pool->threads );
+      free( pool->queues );
+      free( pool );
+      return NULL;
+    }
+
+    ft_mutex_init( &pool->lock );
+    ft_cond_init( &pool->start_cond );
+    ft_cond_init( &pool->done_cond );
+
+    for ( n = 0; n < num_threads; n++ )
+    {
+      FTWorker_Thread  thread = pool->threads + n;
+
+
+      ft_mutex_init( &pool->queues[n].lock );
+
+      thread->pool  = pool;
+      thread->index = n;
+
+#ifdef _WIN32
+      thread->thread = CreateThread( NULL, 0, pool_thread, thread, 0, NULL );
+      if ( !thread->thread )
+#else
+      if ( pthread_create( &thread->thread, NULL, pool_thread, thread ) )
+#endif
+      {
+        /* `FTWorker_Pool_Done' only tears down the started threads */
+        ft_mutex_done( &pool->queues[n].lock );
+        break;
+      }
+
+      pool->num_threads++;
+    }
+
+    if ( !pool->num_threads )
+    {
+      FTWorker_Pool_Done( pool );
+      return NULL;
+    }
+
+    return pool;
+  }
+
+
+  void
+  FTWorker_Pool_Done( FTWorker_Pool  pool )
+  {
+    int  n;
+
+
+    if ( !pool )
+      return;
+
+    ft_mutex_lock( &pool->lock );
+    pool->quit = 1;
+    ft_cond_broadcast( &pool->start_cond );
+    ft_mutex_unlock( &pool->lock );
+
+    for ( n = 0; n < pool->num_threads; n++ )
+    {
+#ifdef _WIN32
+      WaitForSingleObject( pool->threads[n].thread, INFINITE );
+      CloseHandle( pool->threads[n].thread );
+#else
+      pthread_join( pool->threads[n].thread, NULL );
+#endif
+      ft_mutex_done( &pool->queues[n].lock );
+    }
+
+    ft_cond_done( &pool->done_cond );
+    ft_cond_done( &pool->start_cond );
+    ft_mutex_done( &pool->lock );
+
+    free( pool->queues );
+    free( pool->threads );
+    free( pool );
+  }
+
+
+  int
+  FTWorker_Pool_Size( FTWorker_Pool  pool )
+  {
+    return pool ? pool->num_threads : 0;
+  }
+
+
+  void
+  FTWorker_Pool_Run( FTWorker_Pool       pool,
+                     int                 count,
+                     int                 chunk,
+                     FTWorker_RangeFunc  func,
+                     void*               user )
+  {
+    int  num_chunks;
+    int  n;
+
+
+    if ( count <= 0 )
+      return;
+
+    if ( chunk < 1 )
+      chunk = 1;
+
+    num_chunks = ( count + chunk - 1 ) / chunk;
+
+    /* without threads, do it ourselves */
+    if ( !pool )
+    {
+      for ( n = 0; n < num_chunks; n++ )
+        func( 0, n * chunk,
+              n * chunk + chunk < count ? n * chunk + chunk : count, user );
+      return;
+    }
+
+    /* the queues are idle between jobs, no need to lock them */
+    for ( n = 0; n < pool->num_threads; n++ )
+    {
+      pool->queues[n].head = num_chunks * n       / pool->num_threads;
+      pool->queues[n].tail = num_chunks * ( n + 1 ) / pool->num_threads;
+    }
+
+    ft_mutex_lock( &pool->lock );
+
+    pool->count   = count;
+    pool->chunk   = chunk;
+    pool->func    = func;
+    pool->user    = user;
+    pool->running = pool->num_threads;
+    pool->generation++;
+
+    ft_cond_broadcast( &pool->start_cond );
+
+    while ( pool->running > 0 )
+      ft_cond_wait( &pool->done_cond, &pool->lock );
+
+    ft_mutex_unlock( &pool->lock );
+  }
+
+
+  typedef struct  FTWorker_TaskRec_
+  {
+    ft_thread          thread;
+    ft_mutex           lock;
+    ft_cond            cond;       /* any change of state */
+
+    FTWorker_TaskFunc  func;
+    FTWorker_FreeFunc  free_result;
+    void*              user;
+
+    size_t             request_size;
+    void*              request;    /* the latest request */
+    void*              working;    /* the task thread's copy */
+
+    unsigned long      posted;     /* serial of the latest request */
+    unsigned long      started;    /* serial of the last started one */
+    int                running;
+    int                quit;
+
+    void*              result;     /* of the latest request */
+
+  } FTWorker_TaskRec;
+
+
+  FT_THREAD_FUNC( task_thread, arg )
+  {
+    FTWorker_Task  task = (FTWorker_Task)arg;
+
+
+    ft_mutex_lock( &task->lock );
+
+    for (;;)
+    {
+      unsigned long  serial;
+      void*          result;
+
+
+      while ( !task->quit && task->started == task->posted )
+        ft_cond_wait( &task->cond, &task->lock );
+
+      if ( task->quit )
+        break;
+
+      serial        = task->posted;
+      task->started = serial;
+      task->running = 1;
+      memcpy( task->working, task->request, task->request_size );
+
+      ft_mutex_unlock( &task->lock );
+
+      result = task->func( task, serial, task->working, task->user );
+
+      ft_mutex_lock( &task->lock );
+
+      task->running = 0;
+
+      if ( result )
+      {
+        if ( serial != task->posted )
+          task->free_result( result, task->user );   /* superseded */
+        else
+        {
+          if ( task->result )
+            task->free_result( task->result, task->user );
+          task->result = result;
+        }
+      }
+
+      ft_cond_broadcast( &task->cond );
+    }
+
+    ft_mutex_unlock( &task->lock );
+
+    FT_THREAD_RETURN;
+  }
+
+
+  FTWorker_Task
+  FTWorker_Task_New( size_t             request_size,
+                     FTWorker_TaskFunc  func,
+                     FTWorker_FreeFunc  free_result,
+                     void*              user )
+  {
+    FTWorker_Task  task;
+
+
+    task = (FTWorker_Task)calloc( 1, sizeof ( FTWorker_TaskRec ) );
+    if ( !task )
+      return NULL;
+
+    task->func         = func;
+    task->free_result  = free_result;
+    task->user         = user;
+    task->request_size = request_size;
+    task->request      = calloc( 2, request_size );
+    task->working      = (char*)task->request + request_size;
+    if ( !task->request )
+    {
+      free( task );
+      return NULL;
+    }
+
+    ft_mutex_init( &task->lock );
+    ft_cond_init( &task->cond );
+
+#ifdef _WIN32
+    task->thread = CreateThread( NULL, 0, task_thread, task, 0, NULL );
+    if ( !task->thread )
+#else
+    if ( pthread_create( &task->thread, NULL, task_thread, task ) )
+#endif
+    {
+      ft_cond_done( &task->cond );
+      ft_mutex_done( &task->lock );
+      free( task->request );
+      free( task );
+      return NULL;
+    }
+
+    return task;
+  }
+
+
+  void
+  FTWorker_Task_Done( FTWorker_Task  task )
+  {
+    if ( !task )
+      return;
+
+    ft_mutex_lock( &task->lock );
+    task->quit = 1;
+    ft_cond_broadcast( &task->cond );
+    ft_mutex_unlock( &task->lock );
+
+#ifdef _WIN32
+    WaitForSingleObject( task->thread, INFINITE );
+    CloseHandle( task->thread );
+#else
+    pthread_join( task->thread, NULL );
+#endif
+
+    if ( task->result )
+      task->free_result( task->result, task->user );
+
+    ft_cond_done( &task->cond );
+    ft_mutex_done( &task->lock );
+
+    free( task->request );
+    free( task );
+  }
+
+
+  unsigned long
+  FTWorker_Task_Post( FTWorker_Task  task,
+                      const void*    request )
+  {
+    unsigned long  serial;
+
+
+    ft_mutex_lock( &task->lock );
+
+    memcpy( task->request, request, task->request_size );
+    serial = ++task->posted;
+
+    /* the previous result is outdated now */
+    if ( task->result )
+    {
+      task->free_result( task->result, task->user );
+      task->result = NULL;
+    }
+
+    ft_cond_broadcast( &task->cond );
+    ft_mutex_unlock( &task->lock );
+
+    return serial;
+  }
+
+
+  void
+  FTWorker_Task_Cancel( FTWorker_Task  task )
+  {
+    ft_mutex_lock( &task->lock );
+
+    /* a serial that is never started */
+    task->started = ++task->posted;
+
+    if ( task->result )
+    {
+      task->free_result( task->result, task->user );
+      task->result = NULL;
+    }
+
+    ft_mutex_unlock( &task->lock );
+  }
+
+
+  int
+  FTWorker_Task_Is_Current( FTWorker_Task  task,
+                            unsigned long  serial )
+  {
+    int  current;
+
+
+    ft_mutex_lock( &task->lock );
+    current = serial == task->posted;
+    ft_mutex_unlock( &task->lock );
+
+    return current;
+  }
+
+
+  int
+  FTWorker_Task_Busy( FTWorker_Task  task )
+  {
+    int  busy;
+
+
+    ft_mutex_lock( &task->lock );
+    busy = task->running                    ||
+           task->started != task->posted    ||
+           task->result  != NULL;
+    ft_mutex_unlock( &task->lock );
+
+    return busy;
+  }
+
+
+  int
+  FTWorker_Task_Wait( FTWorker_Task  task,
+                      int            timeout )
+  {
+    int  ready;
+
+
+    ft_mutex_lock( &task->lock );
+
+    if ( !task->result                                      &&
+         ( task->running || task->started != task->posted ) )
+      ft_cond_timedwait( &task->cond, &task->lock, timeout );
+
+    ready = task->result != NULL;
+
+    ft_mutex_unlock( &task->lock );
+
+    return ready;
+  }
+
+
+  void*
+  FTWorker_Task_Take_Result( FTWorker_Task  task )
+  {
+    void*  result;
+
+
+    ft_mutex_lock( &task->lock );
+    result       = task->result;
+    task->result = NULL;
+    ft_mutex_unlock( &task->lock );
+
+    return result;
+  }
+
+
+/* End */
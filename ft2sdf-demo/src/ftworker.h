@@ -0,0 +1,149 @@
+/****************************************************************************/
+/*                                                                          */
+/*  The FreeType project -- a free and portable quality TrueType renderer.  */
+/*                                                                          */
+/*  Copyright (C) 2020 by                                                   */
+/*  D. Turner, R.Wilhelm, and W. Lemberg                                    */
+/*                                                                          */
+/*                                                                          */
+/*  ftworker.h - a small worker thread pool for the FreeType demo programs. */
+/*                                                                          */
+/****************************************************************************/
+
+
+#ifndef FTWORKER_H_
+#define FTWORKER_H_
+
+
+#include <stddef.h>
+
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+
+  typedef struct FTWorker_PoolRec_*  FTWorker_Pool;
+
+
+  /* called by worker `thread' for each chunk of indices [first,last) */
+  typedef void
+  (*FTWorker_RangeFunc)( int    thread,
+                         int    first,
+                         int    last,
+                         void*  user );
+
+
+  /* number of online processors, at least 1 */
+  int
+  FTWorker_Num_CPUs( void );
+
+
+  /* create a pool of `num_threads' persistent threads; if zero, */
+  /* use one thread per processor                                */
+  FTWorker_Pool
+  FTWorker_Pool_New( int  num_threads );
+
+
+  void
+  FTWorker_Pool_Done( FTWorker_Pool  pool );
+
+
+  int
+  FTWorker_Pool_Size( FTWorker_Pool  pool );
+
+
+  /* Call `func' on all indices in [0,count), split in chunks of */
+  /* `chunk' indices.  Each thread starts with an equal share of */
+  /* the chunks and steals from the others once it runs out, so  */
+  /* that uneven chunk costs still keep all threads busy.  The   */
+  /* call returns when all chunks are done.                      */
+  void
+  FTWorker_Pool_Run( FTWorker_Pool       pool,
+                     int                 count,
+                     int                 chunk,
+                     FTWorker_RangeFunc  func,
+                     void*               user );
+
+
+  /*************************************************************************/
+  /*                                                                       */
+  /* A background task that always works on the latest request.  Posting  */
+  /* a request supersedes any request that hasn't been started yet; a     */
+  /* request being worked on runs to completion (unless `func' gives up   */
+  /* early), but its result is dropped if a newer request was posted in   */
+  /* the meantime.                                                         */
+  /*                                                                       */
+
+  typedef struct FTWorker_TaskRec_*  FTWorker_Task;
+
+
+  /* called on the task thread with a copy of the request `serial'; */
+  /* the returned result, if any, is handed to the owner            */
+  typedef void*
+  (*FTWorker_TaskFunc)( FTWorker_Task  task,
+                        unsigned long  serial,
+                        const void*    request,
+                        void*          user );
+
+  typedef void
+  (*FTWorker_FreeFunc)( void*  result,
+                        void*  user );
+
+
+  FTWorker_Task
+  FTWorker_Task_New( size_t             request_size,
+                     FTWorker_TaskFunc  func,
+                     FTWorker_FreeFunc  free_result,
+                     void*              user );
+
+
+  /* wait for the request being worked on, drop everything else */
+  void
+  FTWorker_Task_Done( FTWorker_Task  task );
+
+
+  /* copy and queue a request, returning its serial number */
+  unsigned long
+  FTWorker_Task_Post( FTWorker_Task  task,
+                      const void*    request );
+
+
+  /* drop the queued request and any result; a running request */
+  /* finishes, but its result is discarded                       */
+  void
+  FTWorker_Task_Cancel( FTWorker_Task  task );
+
+
+  /* whether `serial' is still the latest request; long-running */
+  /* task functions should check this now and then               */
+  int
+  FTWorker_Task_Is_Current( FTWorker_Task  task,
+                            unsigned long  serial );
+
+
+  /* whether a request is queued or running, or a result is ready */
+  int
+  FTWorker_Task_Busy( FTWorker_Task  task );
+
+
+  /* wait at most `timeout' milliseconds for a result; */
+  /* return 1 if one is ready                          */
+  int
+  FTWorker_Task_Wait( FTWorker_Task  task,
+                      int            timeout );
+
+
+  /* take the result of the latest request, if ready, or NULL */
+  void*
+  FTWorker_Task_Take_Result( FTWorker_Task  task );
+
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* FTWORKER_H_ */
+
+
+/* End */
@@ -0,0 +1,299 @@
+/****************************************************************************/
+/*                                                                          */
+/*  The FreeType project -- a free and portable quality TrueType renderer.  */
+/*                                                                          */
+/*  Copyright (C) 2020 by                                                   */
+/*  D. Turner, R.Wilhelm, and W. Lemberg                                    */
+/*                                                                          */
+/*                                                                          */
+/*  grbench.c - time the pixel conversions of the graphics sub-system.     */
+/*                                                                          */
+/****************************************************************************/
+
+
+#include "common.h"
+#include "mlgetopt.h"
+#include "grswizzle.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef UNIX
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+
+  typedef void
+  (*Convert_Func)( unsigned char*  read_buff,
+                   int             read_pitch,
+                   unsigned char*  write_buff,
+                   int             write_pitch,
+                   int             buff_width,
+                   int             buff_height,
+                   int             x,
+                   int             y,
+                   int             width,
+                   int             height );
+
+
+  typedef struct  Conversion_
+  {
+    const char*   name;
+    int           pix_bytes;
+    Convert_Func  func;
+
+  } Conversion;
+
+
+  static const Conversion  conversions[] =
+  {
+    { "rgb24",  3, gr_swizzle_rect_rgb24  },
+    { "rgb565", 2, gr_swizzle_rect_rgb565 },
+    { "xrgb32", 4, gr_swizzle_rect_xrgb32 }
+  };
+
+#define N_CONVERSIONS  (int)( sizeof ( conversions ) / sizeof ( conversions[0] ) )
+
+
+  /* the usual frame sizes */
+  static const int  frames[][2] =
+  {
+    {  640,  480 },
+    { 1024,  768 },
+    { 1280,  720 },
+    { 1920, 1080 },
+    { 2560, 1440 }
+  };
+
+#define N_FRAMES  (int)( sizeof ( frames ) / sizeof ( frames[0] ) )
+
+
+  static const char*  kernels[] = { "generic", "SSE2", "AVX2" };
+
+#define N_KERNELS  (int)( sizeof ( kernels ) / sizeof ( kernels[0] ) )
+
+
+  /* the same clock as `FTDemo_Get_Time', in nanoseconds, */
+  /* without pulling in FreeType                           */
+  static double
+  get_time( void )
+  {
+#if defined _POSIX_TIMERS && _POSIX_TIMERS > 0
+    struct timespec  tv;
+
+
+#ifdef _POSIX_MONOTONIC_CLOCK
+    clock_gettime( CLOCK_MONOTONIC, &tv );
+#else
+    clock_gettime( CLOCK_REALTIME, &tv );
+#endif
+
+    return 1E9 * (double)tv.tv_sec + (double)tv.tv_nsec;
+#elif defined _WIN32
+    LARGE_INTEGER  ticks, frequency;
+
+
+    QueryPerformanceCounter( &ticks );
+    QueryPerformanceFrequency( &frequency );
+
+    return 1E9 * (double)ticks.QuadPart / (double)frequency.QuadPart;
+#else
+    return 1E9 * (double)clock() / (double)CLOCKS_PER_SEC;
+#endif
+  }
+
+
+  /* a text-like frame: a light background with darker strokes */
+  static void
+  fill_frame( unsigned char*  buffer,
+              int             size )
+  {
+    unsigned long  seed = 1;
+    int            n;
+
+
+    for ( n = 0; n < size; n++ )
+    {
+      seed = seed * 1103515245UL + 12345UL;
+      buffer[n] = ( seed >> 16 ) & 3 ? 0xF0 : (unsigned char)( seed >> 8 );
+    }
+  }
+
+
+  static unsigned long
+  checksum( const unsigned char*  buffer,
+            int                   size )
+  {
+    unsigned long  a = 1, b = 0;
+    int            n;
+
+
+    for ( n = 0; n < size; n++ )
+    {
+      a = ( a + buffer[n] ) % 65521UL;
+      b = ( b + a ) % 65521UL;
+    }
+
+    return ( b << 16 ) | a;
+  }
+
+
+  static void
+  usage( char*  execname )
+  {
+    fprintf( stderr,
+      "\n"
+      "grbench: time pixel conversions -- part of the FreeType project\n"
+      "---------------------------------------------------------------\n"
+      "\n" );
+    fprintf( stderr,
+      "Usage: %s [options]\n"
+      "\n",
+             execname );
+    fprintf( stderr,
+      "  -n count  Convert each frame `count' times (default: 50).\n"
+      "  -k name   Only time the `generic', `SSE2' or `AVX2' kernels\n"
+      "            (default: all that the processor supports).\n"
+      "\n"
+      "  Each conversion runs over whole frames of the usual sizes; the\n"
+      "  checksums of the results must agree between the kernels, and\n"
+      "  the program fails if they don't.\n"
+      "\n" );
+
+    exit( 1 );
+  }
+
+
+  int
+  main( int     argc,
+        char**  argv )
+  {
+    char*           execname;
+    int             option;
+    int             count  = 50;
+    const char*     kernel = NULL;
+    unsigned char*  source;
+    unsigned char*  target;
+    int             max_size = 0;
+    int             k, c, f, n;
+
+    /* the checksums of the first kernel run, to compare the others */
+    unsigned long   sums[N_CONVERSIONS][N_FRAMES];
+    int             reference  = -1;
+    int             mismatches = 0;
+
+
+    execname = ft_basename( argv[0] );
+
+    while ( ( option = getopt( argc, argv, "k:n:" ) ) != -1 )
+    {
+      switch ( option )
+      {
+      case 'k':
+        kernel = optarg;
+        break;
+      case 'n':
+        count = atoi( optarg );
+        if ( count < 1 )
+          usage( execname );
+        break;
+      default:
+        usage( execname );
+        break;
+      }
+    }
+
+    if ( optind != argc )
+      usage( execname );
+
+    for ( f = 0; f < N_FRAMES; f++ )
+      if ( frames[f][0] * frames[f][1] * 4 > max_size )
+        max_size = frames[f][0] * frames[f][1] * 4;
+
+    source = (unsigned char*)malloc( (size_t)max_size );
+    target = (unsigned char*)malloc( (size_t)max_size );
+    if ( !source || !target )
+      Panic( "not enough memory\n" );
+
+    fill_frame( source, max_size );
+
+    printf( "%-8s %-7s %-10s %10s %10s %10s\n",
+            "kernel", "format", "frame", "ms/frame", "Mpixel/s", "checksum" );
+
+    for ( k = 0; k < N_KERNELS; k++ )
+    {
+      if ( kernel && strcmp( kernel, kernels[k] ) )
+        continue;
+
+      if ( !gr_swizzle_select( kernels[k] ) )
+      {
+        if ( kernel )
+          Panic( "kernel `%s' is not available\n", kernel );
+        continue;
+      }
+
+      for ( c = 0; c < N_CONVERSIONS; c++ )
+      {
+        for ( f = 0; f < N_FRAMES; f++ )
+        {
+          int            width  = frames[f][0];
+          int            height = frames[f][1];
+          int            pitch  = width * conversions[c].pix_bytes;
+          double         start, time;
+          unsigned long  sum;
+          char           frame[32];
+
+
+          /* warm up the caches */
+          conversions[c].func( source, pitch, target, pitch,
+                               width, height, 0, 0, width, height );
+
+          start = get_time();
+          for ( n = 0; n < count; n++ )
+            conversions[c].func( source, pitch, target, pitch,
+                                 width, height, 0, 0, width, height );
+          time = ( get_time() - start ) / count;
+
+          sum = checksum( target, pitch * height );
+          if ( reference < 0 )
+            sums[c][f] = sum;
+          else if ( sum != sums[c][f] )
+            mismatches++;
+
+          sprintf( frame, "%dx%d", width, height );
+          printf( "%-8s %-7s %-10s %10.3f %10.1f   %08lx%s\n",
+                  kernels[k],
+                  conversions[c].name,
+                  frame,
+                  time / 1E6,
+                  1E3 * width * height / time,
+                  sum,
+                  reference >= 0 && sum != sums[c][f] ? "  MISMATCH" : "" );
+        }
+      }
+
+      if ( reference < 0 )
+        reference = k;
+    }
+
+    free( source );
+    free( target );
+
+    if ( mismatches )
+    {
+      fprintf( stderr, "%d conversion%s differ from the `%s' kernel\n",
+               mismatches, mismatches == 1 ? "" : "s", kernels[reference] );
+      return 1;
+    }
+
+    return 0;
+  }
+
+
+/* End */